@@ -9,6 +9,7 @@ import argparse
 parser = argparse.ArgumentParser()
 parser.add_argument('-i', dest='input', nargs=1, required=True ,help='input bitcode')
 parser.add_argument('-f', dest='func', nargs=1, help='target function')
+parser.add_argument('-l', dest='libfuzzer', action='store_true', help='emit LLVMFuzzerTestOneInput instead of main')
 parser.add_argument('-c', dest="compile_args", nargs=argparse.REMAINDER, help='compile args')
 args = parser.parse_args()
 
@@ -32,6 +33,9 @@ so_path = source_dir + "/lib/fuzz_driver_pass.so"
 
 env=os.environ.copy()
 
+if args.libfuzzer:
+  env["FUZZ_DRIVER_LIBFUZZER"] = "1"
+
 if func_name != None:
   func_name = func_name[0]
   env["TARGET_NAME"] = func_name
@@ -86,13 +86,14 @@ class CarverFAPass : public llvm::ModulePass {
   llvm::FunctionCallee carv_file;
   llvm::FunctionCallee carv_open;
   llvm::FunctionCallee carv_close;
+  llvm::FunctionCallee carv_post_state;
 
   vector<llvm::AllocaInst *> tracking_allocas;
 
   llvm::FunctionCallee mem_allocated_probe;
   llvm::FunctionCallee remove_probe;
 
-  llvm::FunctionCallee record_func_ptr;
+  llvm::FunctionCallee bind_meta;
 
   llvm::FunctionCallee argv_modifier;
   llvm::FunctionCallee __carv_fini;
@@ -104,9 +105,10 @@ class CarverFAPass : public llvm::ModulePass {
   llvm::FunctionCallee carv_float_func;
   llvm::FunctionCallee carv_double_func;
   llvm::FunctionCallee carv_ptr_func;
+  llvm::FunctionCallee carv_next_elem_idx;
+  llvm::FunctionCallee carv_ptr_end;
   llvm::FunctionCallee carv_func_ptr;
   llvm::FunctionCallee update_carved_ptr_idx;
-  llvm::FunctionCallee keep_class_info;
   llvm::FunctionCallee class_carver;
   llvm::FunctionCallee record_func_ptr_index;
 
@@ -98,7 +98,7 @@ class CarverMPass : public llvm::ModulePass {
 
   llvm::FunctionCallee fetch_mem_alloc;
 
-  llvm::FunctionCallee record_func_ptr;
+  llvm::FunctionCallee bind_meta;
 
   llvm::FunctionCallee argv_modifier;
   llvm::FunctionCallee __carv_fini;
@@ -112,7 +112,6 @@ class CarverMPass : public llvm::ModulePass {
   llvm::FunctionCallee carv_ptr_func;
   llvm::FunctionCallee carv_func_ptr;
   llvm::FunctionCallee update_carved_ptr_idx;
-  llvm::FunctionCallee keep_class_info;
   llvm::FunctionCallee class_carver;
   llvm::FunctionCallee record_func_ptr_index;
 
@@ -122,6 +121,7 @@ class CarverMPass : public llvm::ModulePass {
   llvm::FunctionCallee insert_struct_end;
 
   llvm::FunctionCallee mark_addr_probe;
+  llvm::FunctionCallee protect_inputs;
 
   llvm::Constant *global_carve_ready;
   llvm::Constant *global_cur_class_idx;
@@ -22,10 +22,6 @@ class ClementinePass : public ModulePass {
 
   std::vector<Function *> func_list;
 
-  // To measure coverage
-  std::map<std::string, std::map<std::string, std::set<std::string>>>
-      file_bb_map;
-
   void instrument_main_func(Function *main_func);
   void instrument_load_class_func(Function *);
   void instrument_load_default_func(Function *);
@@ -14,6 +14,7 @@ extern FunctionCallee replay_float_func;
 extern FunctionCallee replay_double_func;
 
 extern FunctionCallee replay_ptr_func;
+extern FunctionCallee replay_next_elem_idx;
 
 extern FunctionCallee replay_func_ptr;
 extern FunctionCallee record_func_ptr;
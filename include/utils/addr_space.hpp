@@ -0,0 +1,79 @@
+#ifndef __ADDR_SPACE_HPP
+#define __ADDR_SPACE_HPP
+
+// Sorted table of the mappings in `/proc/self/maps`, so a pointer that is
+// not a tracked allocation can be classified with one binary search instead
+// of failed searches in every other table. Reloaded when a lookup misses and
+// shared objects were loaded or unloaded since (dlopen, dlclose).
+
+class addr_space {
+ public:
+  enum kind {
+    UNMAPPED,
+    // Executable, file backed
+    TEXT,
+    // Read only, file backed (.rodata, string literals, relro)
+    RODATA,
+    // Writable, file backed (.data, .bss)
+    DATA,
+    HEAP,
+    STACK,
+    // Anonymous mappings, mmap-ed heap chunks, thread stacks, TLS
+    ANON,
+    // vdso, vvar, vsyscall, ...
+    SPECIAL,
+  };
+
+  class range {
+   public:
+    unsigned long begin_;
+    unsigned long end_;
+    kind kind_;
+    // Mapped from a shared object rather than the executable
+    bool is_lib_;
+  };
+
+  addr_space();
+
+  ~addr_space();
+
+  addr_space(addr_space &other) = delete;
+  addr_space(addr_space &&other) = delete;
+
+  addr_space &operator=(addr_space &other) = delete;
+  addr_space &operator=(addr_space &&other) = delete;
+
+  // (Re)reads `/proc/self/maps`, false if it could not be read.
+  bool load();
+
+  // The mapping containing `addr`, or nullptr.
+  const range *find(const void *addr);
+
+  kind classify(const void *addr) {
+    const range *found = find(addr);
+    return found == nullptr ? UNMAPPED : found->kind_;
+  }
+
+  // Size in bytes of the read only object at `addr` to carve by value: the
+  // C string up to its NUL if `is_str`, else one `elem_size` element, both
+  // clipped to the end of the mapping. 0 if `addr` is not read only data.
+  int rodata_size(const void *addr, int elem_size, bool is_str);
+
+  unsigned int num_loads() const { return num_loads_; }
+
+ private:
+  const range *search(unsigned long addr) const;
+
+  bool dl_changed();
+
+  range *ranges_ = nullptr;
+  int num_ranges_ = 0;
+  int capacity_ = 0;
+
+  unsigned long long dl_adds_ = 0;
+  unsigned long long dl_subs_ = 0;
+
+  unsigned int num_loads_ = 0;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __CARV_BUDGET_HPP
+#define __CARV_BUDGET_HPP
+
+#include <stdlib.h>
+
+// Per-activation carving budget, read once from the environment.
+//   CARV_MAX_BYTES      bytes of pointees carved in one context
+//   CARV_MAX_RECORDS    records carved in one context
+//   CARV_MAX_PTR_DEPTH  nesting depth of carved pointees
+// Unset or 0 means no limit. Carv_pointer asks `charge` before descending
+// into a new pointee, and records a TRUNCATED input instead once the budget
+// of the current context is spent. Replay drivers give such a pointer a
+// zeroed default object.
+
+#define CARV_MAX_BYTES_ENV "CARV_MAX_BYTES"
+#define CARV_MAX_RECORDS_ENV "CARV_MAX_RECORDS"
+#define CARV_MAX_PTR_DEPTH_ENV "CARV_MAX_PTR_DEPTH"
+
+class carv_budget {
+ public:
+  carv_budget() {}
+
+  carv_budget(carv_budget &other) = delete;
+  carv_budget(carv_budget &&other) = delete;
+
+  carv_budget &operator=(carv_budget &other) = delete;
+  carv_budget &operator=(carv_budget &&other) = delete;
+
+  void load_env() {
+    max_bytes_ = read_env(CARV_MAX_BYTES_ENV);
+    max_records_ = read_env(CARV_MAX_RECORDS_ENV);
+    max_depth_ = read_env(CARV_MAX_PTR_DEPTH_ENV);
+  }
+
+  bool enabled() const {
+    return (max_bytes_ != 0) || (max_records_ != 0) || (max_depth_ != 0);
+  }
+
+  // At the start of each context.
+  void reset() { num_bytes_ = 0; }
+
+  // True if a pointee of `alloc_size` bytes at pointer depth `depth` may be
+  // carved when `num_records` records are already carved, and charges it.
+  bool charge(unsigned long num_records, unsigned long depth,
+              int alloc_size) {
+    if ((max_records_ != 0) && (num_records >= max_records_)) {
+      return false;
+    }
+    if ((max_depth_ != 0) && (depth >= max_depth_)) {
+      return false;
+    }
+    if ((max_bytes_ != 0) && (num_bytes_ + alloc_size > max_bytes_)) {
+      return false;
+    }
+    num_bytes_ += alloc_size;
+    return true;
+  }
+
+ private:
+  static unsigned long read_env(const char *name) {
+    const char *val = getenv(name);
+    if (val == NULL) {
+      return 0;
+    }
+    return strtoul(val, NULL, 0);
+  }
+
+  unsigned long max_bytes_ = 0;
+  unsigned long max_records_ = 0;
+  unsigned long max_depth_ = 0;
+
+  unsigned long num_bytes_ = 0;
+};
+
+#endif
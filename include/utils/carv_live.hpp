@@ -0,0 +1,65 @@
+#ifndef __CARV_LIVE_HPP
+#define __CARV_LIVE_HPP
+
+// Layout of `<outdir>/carving_stats.live`, the live counters of a running
+// carver. The carver maps the file shared and updates it with relaxed
+// atomics, `carv-top` maps it read only. Values may be slightly stale or
+// torn across fields, never within one.
+
+#define CARV_LIVE_FILE_NAME "carving_stats.live"
+
+#define CARV_LIVE_MAGIC 0x43564c56  // "VLVC"
+#define CARV_LIVE_VERSION 1
+
+// Units with a larger id are only counted in the totals.
+#define CARV_LIVE_MAX_UNITS 4096
+#define CARV_LIVE_NAME_LEN 64
+
+#define CARV_LIVE_ADD(field, val) \
+  __atomic_fetch_add(&(field), (val), __ATOMIC_RELAXED)
+#define CARV_LIVE_STORE(field, val) \
+  __atomic_store_n(&(field), (val), __ATOMIC_RELAXED)
+#define CARV_LIVE_LOAD(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+typedef struct carv_live_unit_ {
+  unsigned long calls;
+  unsigned long carved;
+  unsigned long bytes;
+  char name[CARV_LIVE_NAME_LEN];
+} carv_live_unit;
+
+typedef struct carv_live_header_ {
+  unsigned int magic;
+  unsigned int version;
+  int pid;
+  // Set at __carv_FINI
+  int finished;
+  // CLOCK_MONOTONIC
+  unsigned long start_ns;
+  char carver[32];
+
+  unsigned long calls;
+  unsigned long carved;
+  unsigned long skipped;
+  unsigned long deduped;
+  unsigned long records;
+  unsigned long bytes;
+
+  // # of open contexts on the carving stack
+  unsigned long ctx_depth;
+  // malloc/free events waiting in the Pin tool shared map (model carver)
+  unsigned long shm_pending;
+  unsigned long dropped_shm_events;
+  unsigned long ptr_map_nodes;
+
+  // Max used unit id + 1, published after the unit name
+  int num_units;
+  int pad;
+} carv_live_header;
+
+typedef struct carv_live_segment_ {
+  carv_live_header header;
+  carv_live_unit units[CARV_LIVE_MAX_UNITS];
+} carv_live_segment;
+
+#endif
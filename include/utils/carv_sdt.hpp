@@ -0,0 +1,59 @@
+#ifndef __CARV_SDT_HPP
+#define __CARV_SDT_HPP
+
+// USDT (SystemTap SDT) probe points of the carver runtimes, provider `carv`.
+// Each probe is a single nop plus an ELF note, so it costs nothing until a
+// tracer attaches, e.g.
+//   bpftrace -e 'usdt:./target.carv:carv:close { @[str(arg0)] = count(); }'
+//   perf probe -x ./target.carv sdt_carv:dump
+// Emitted with inline asm, following the note layout of <sys/sdt.h>, so no
+// systemtap headers are needed. Arguments are passed as signed 8 bytes.
+
+#if defined(__x86_64__) || defined(__aarch64__)
+
+#define _CARV_SDT_PROBE(name, argfmt, ...)                                   \
+  __asm__ __volatile__(                                                      \
+      "990: nop\n"                                                           \
+      ".pushsection .note.stapsdt,\"?\",\"note\"\n"                          \
+      ".balign 4\n"                                                          \
+      ".4byte 992f-991f, 994f-993f, 3\n"                                     \
+      "991: .asciz \"stapsdt\"\n"                                            \
+      "992: .balign 4\n"                                                     \
+      "993: .8byte 990b\n"                                                   \
+      ".8byte _.stapsdt.base\n"                                              \
+      ".8byte 0\n"                                                           \
+      ".asciz \"carv\"\n"                                                    \
+      ".asciz \"" #name "\"\n"                                               \
+      ".asciz \"" argfmt "\"\n"                                              \
+      "994: .balign 4\n"                                                     \
+      ".popsection\n"                                                        \
+      ".ifndef _.stapsdt.base\n"                                             \
+      ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+      ".weak _.stapsdt.base\n"                                               \
+      ".hidden _.stapsdt.base\n"                                             \
+      "_.stapsdt.base: .space 1\n"                                           \
+      ".size _.stapsdt.base, 1\n"                                            \
+      ".popsection\n"                                                        \
+      ".endif\n" ::__VA_ARGS__)
+
+#define _CARV_SDT_ARG(arg) "nor"((long)(arg))
+
+#define CARV_PROBE0(name) _CARV_SDT_PROBE(name, "")
+#define CARV_PROBE1(name, a1) \
+  _CARV_SDT_PROBE(name, "-8@%0", _CARV_SDT_ARG(a1))
+#define CARV_PROBE2(name, a1, a2) \
+  _CARV_SDT_PROBE(name, "-8@%0 -8@%1", _CARV_SDT_ARG(a1), _CARV_SDT_ARG(a2))
+#define CARV_PROBE3(name, a1, a2, a3)                                 \
+  _CARV_SDT_PROBE(name, "-8@%0 -8@%1 -8@%2", _CARV_SDT_ARG(a1), \
+                  _CARV_SDT_ARG(a2), _CARV_SDT_ARG(a3))
+
+#else
+
+#define CARV_PROBE0(name)
+#define CARV_PROBE1(name, a1)
+#define CARV_PROBE2(name, a1, a2)
+#define CARV_PROBE3(name, a1, a2, a3)
+
+#endif
+
+#endif
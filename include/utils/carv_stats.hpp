@@ -0,0 +1,123 @@
+#ifndef __CARV_STATS_HPP
+#define __CARV_STATS_HPP
+
+#include "utils/carv_live.hpp"
+
+class ptr_map;
+
+// Per-run carving telemetry, written as `<outdir>/carving_stats.json` at
+// `__carv_FINI`. Counters are kept per unit, a dense id given by the pass
+// (function id, or type id for the type based carver).
+//
+// Traversal time is measured from `begin_traversal` to `end_traversal`, the
+// walk over the inputs right after a context is opened. Serialization time
+// is the time spent writing the carved file of a context.
+//
+// With `open_live`, the counters are also mirrored into a shared mapped file
+// (see carv_live.hpp) that `carv-top` can watch while the carver runs.
+
+class carv_stats {
+ public:
+  carv_stats();
+
+  ~carv_stats();
+
+  carv_stats(carv_stats &other) = delete;
+  carv_stats(carv_stats &&other) = delete;
+
+  carv_stats &operator=(carv_stats &other) = delete;
+  carv_stats &operator=(carv_stats &&other) = delete;
+
+  // Keeps the first name given for `unit_id`, must be a static string.
+  void set_name(int unit_id, const char *name);
+
+  void on_call(int unit_id);
+  void on_carved(int unit_id, unsigned long num_records,
+                 unsigned long num_bytes);
+  void on_skipped(int unit_id);
+  void on_deduped(int unit_id);
+  // A pointee left out because the context ran out of budget.
+  void on_truncated(int unit_id);
+
+  // At most one traversal is pending, contexts are only walked on entry.
+  void begin_traversal(int unit_id);
+  void end_traversal() {
+    if (traversal_unit_ >= 0) {
+      finish_traversal();
+    }
+  }
+
+  // For carvers that time the walk themselves.
+  void add_traversal_ns(int unit_id, unsigned long elapsed_ns);
+  void add_serialize_ns(int unit_id, unsigned long elapsed_ns);
+
+  // Memory tracking map of the carver, reported at write_json if set.
+  void track_ptr_map(const ptr_map *map) { ptr_map_ = map; }
+
+  void set_dropped_events(unsigned long num_dropped) {
+    num_dropped_ = num_dropped;
+    if (live_ != nullptr) {
+      CARV_LIVE_STORE(live_->header.dropped_shm_events, num_dropped);
+    }
+  }
+
+  // Live only gauges
+  void set_depth(unsigned long depth) {
+    if (live_ != nullptr) {
+      CARV_LIVE_STORE(live_->header.ctx_depth, depth);
+    }
+  }
+
+  void set_shm_pending(unsigned long num_pending) {
+    if (live_ != nullptr) {
+      CARV_LIVE_STORE(live_->header.shm_pending, num_pending);
+    }
+  }
+
+  // Creates `<outdir>/carving_stats.live`, false if it can not be mapped.
+  bool open_live(const char *outdir_name, const char *carver_name);
+  void close_live();
+
+  bool write_json(const char *outdir_name, const char *carver_name,
+                  const char *unit_kind);
+
+  static unsigned long now_ns();
+
+ private:
+  class unit {
+   public:
+    const char *name_;
+    unsigned long num_calls_;
+    unsigned long num_carved_;
+    unsigned long num_skipped_;
+    unsigned long num_deduped_;
+    unsigned long num_truncated_;
+    unsigned long num_records_;
+    unsigned long max_records_;
+    unsigned long num_bytes_;
+    unsigned long max_bytes_;
+    unsigned long traversal_ns_;
+    unsigned long serialize_ns_;
+  };
+
+  unit *get_unit(int unit_id);
+
+  carv_live_unit *get_live_unit(int unit_id);
+
+  void finish_traversal();
+
+  unit *units_ = nullptr;
+  int num_units_ = 0;
+
+  int traversal_unit_ = -1;
+  unsigned long traversal_begin_ns_ = 0;
+
+  const ptr_map *ptr_map_ = nullptr;
+  unsigned long num_dropped_ = 0;
+
+  unsigned long start_ns_ = 0;
+
+  carv_live_segment *live_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef __CARVED_READER_HPP
+#define __CARVED_READER_HPP
+
+#include <stddef.h>
+
+// Reads a carved file in place for the replay drivers. The file is mapped
+// privately and records are decoded one at a time when the driver asks for
+// them, nothing is parsed ahead. Strings handed out (pointee type and
+// function names) are terminated inside the mapping and stay valid until
+// close. GLOBAL_REF and OBJ_REF records are followed into the referenced
+// file, relative to the directory of the carved file.
+
+// Input records, the references are followed and never returned.
+enum class RECORD_TYPE {
+  CHAR,
+  SHORT,
+  INT,
+  LONG,
+  LONGLONG,
+  FLOAT,
+  DOUBLE,
+  PTR,
+  NULLPTR,
+  FUNCPTR,
+  UNKNOWN_PTR,
+  TRUNCATED,
+  SKIPPED,
+  GLOBAL_REF,
+  OBJ_REF,
+};
+
+// One decoded input record
+class carved_record {
+ public:
+  RECORD_TYPE type;
+
+  // CHAR to LONGLONG values, PTR index and SKIPPED count
+  long long value;
+
+  // FLOAT and DOUBLE values
+  double fvalue;
+
+  // PTR offset
+  int offset;
+
+  // FUNCPTR name
+  const char *name;
+};
+
+class carved_reader {
+ public:
+  carved_reader();
+
+  ~carved_reader();
+
+  carved_reader(carved_reader &other) = delete;
+  carved_reader(carved_reader &&other) = delete;
+
+  carved_reader &operator=(carved_reader &other) = delete;
+  carved_reader &operator=(carved_reader &&other) = delete;
+
+  // Maps `file_name` in place of the current file. Records start
+  // `prefix_len` chars into their line. False if it could not be read.
+  bool open(const char *file_name, int prefix_len);
+
+  void close();
+
+  // Next entry of the pointer table, false past its end. `addr` is the
+  // address the pointee had in the carved process.
+  bool next_ptr(int *alloc_size, const char **type_name,
+                unsigned long *addr);
+
+  // Next input record, NULL past the last one. The record is overwritten by
+  // the next call.
+  const carved_record *next();
+
+  // Next input record, left to be returned by next().
+  const carved_record *peek();
+
+ private:
+  class mapping {
+   public:
+    char *base_;
+    size_t size_;
+    bool is_mapped_;
+    char *cur_;
+    char *end_;
+    int prefix_len_;
+  };
+
+  bool push(const char *file_name, int prefix_len);
+
+  void pop();
+
+  bool fill();
+
+  void push_ref(const char *ref, size_t ref_len);
+
+  // Snapshots and stored objects refer to no other file.
+  static const int MAX_DEPTH = 4;
+
+  mapping mappings_[MAX_DEPTH];
+  int depth_ = 0;
+
+  // Directory of the carved file, with the trailing '/'
+  char *dir_name_ = nullptr;
+
+  bool in_ptr_table_ = false;
+
+  carved_record cur_;
+  bool has_cur_ = false;
+};
+
+#endif
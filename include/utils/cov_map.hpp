@@ -0,0 +1,63 @@
+#ifndef __COV_MAP_HPP
+#define __COV_MAP_HPP
+
+#include <stddef.h>
+
+#include "utils/fnv_hash.hpp"
+
+// Replay coverage of a driven module, kept as a bitmap file shared by all
+// replays of its drivers. The driver pass numbers the blocks it gives
+// counters to and lists them in `<module>.cov_layout`, one line each in
+// block order:
+//
+//   S <source file>    F <function>    B <block>
+//
+// with an S and F line before the blocks of each function. At exit a
+// driver ORs the blocks it ran into `<module>.covmap` under an exclusive
+// flock, so replays running in parallel never lose each other's blocks.
+// `cov-export` writes the text `<source file>.cov` reports from both.
+
+#define COV_LAYOUT_SUFFIX ".cov_layout"
+#define COV_MAP_SUFFIX ".covmap"
+
+#define COV_MAP_MAGIC 0x504d5643  // "CVMP"
+#define COV_MAP_VERSION 1
+
+typedef struct cov_map_header_ {
+  unsigned int magic;
+  unsigned int version;
+  // FNV-1a hash of the layout file, a map of another build is reset.
+  unsigned long layout_hash;
+  unsigned long num_bbs;
+} cov_map_header;
+
+// Hash of the layout file content, written by the pass and checked by
+// cov-export. Every `B` line is a block, whether or not a function is open.
+static inline unsigned long hash_cov_layout(const char *layout, size_t size) {
+  return fnv_hash(layout, size);
+}
+
+// Size of the map file, header and one bit per block
+#define COV_MAP_SIZE(num_bbs) (sizeof(cov_map_header) + ((num_bbs) + 7) / 8)
+
+// Counters of one instrumented function, entries of `__cov_func_table`
+typedef struct cov_func_meta_ {
+  unsigned char *counters;
+  int num_bbs;
+} cov_func_meta;
+
+extern "C" {
+// Called by main with the table and the map path baked in by the pass.
+void __cov_bind(cov_func_meta *funcs, int num_funcs, const char *map_path,
+                unsigned long layout_hash);
+
+// Merges the blocks run so far into the map.
+void __cov_fini();
+}
+
+// ORs the `num_bbs` bits of `bits` into the map at `map_path`, creating or
+// resetting it when it does not match `layout_hash`. False on I/O errors.
+bool cov_map_merge(const char *map_path, unsigned long layout_hash,
+                   const unsigned char *bits, unsigned long num_bbs);
+
+#endif
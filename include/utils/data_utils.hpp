@@ -24,6 +24,10 @@ enum INPUT_TYPE {
   INPUTFILE,
   OSTREAM,
   OFSTREAM,
+  TRUNCATED,
+  SKIPPED,
+  GLOBAL_REF,
+  OBJ_REF,
 };
 
 class POINTER {
@@ -202,6 +206,9 @@ class FUNC_CONTEXT {
   unsigned int func_call_idx = 0;
   unsigned int func_id = 0;
   bool is_carved = false;
+
+  // Append-only journal of the dumped context file (crash mode), -1 if none
+  int journal_fd = -1;
 };
 
 class typeinfo {
@@ -243,4 +250,34 @@ class classinfo {
 
   classinfo &operator=(classinfo &&other);
 };
+
+// Entries of the static metadata tables that the passes emit into the
+// `carv_meta` section. The runtime binds them once at startup, sorts them
+// by address and queries them by binary search.
+typedef struct func_meta_ {
+  void *addr;
+  char *name;
+} func_meta;
+
+typedef struct global_meta_ {
+  void *addr;
+  char *type_name;
+  int size;
+} global_meta;
+
+typedef struct class_meta_ {
+  char *class_name;
+  int size;
+  int index;
+} class_meta;
+
+void sort_func_meta(func_meta *table, int num_entries);
+void sort_global_meta(global_meta *table, int num_entries);
+void sort_class_meta(class_meta *table, int num_entries);
+
+func_meta *find_func_meta(func_meta *table, int num_entries, void *addr);
+// Returns the global whose memory contains `addr`.
+global_meta *find_global_meta(global_meta *table, int num_entries, void *addr);
+class_meta *find_class_meta(class_meta *table, int num_entries,
+                            char *class_name);
 #endif
\ No newline at end of file
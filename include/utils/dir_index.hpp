@@ -0,0 +1,49 @@
+#ifndef __DIR_INDEX_HPP
+#define __DIR_INDEX_HPP
+
+#include "utils/name_index.hpp"
+
+// Sorted listings of the directories the replay drivers pick carved files
+// from. Each directory is read once per process, replays that select a file
+// for every class object only look it up.
+
+class dir_index {
+ public:
+  dir_index();
+
+  ~dir_index();
+
+  dir_index(dir_index &other) = delete;
+  dir_index(dir_index &&other) = delete;
+
+  dir_index &operator=(dir_index &other) = delete;
+  dir_index &operator=(dir_index &&other) = delete;
+
+  // Sets `names` to the names of the entries of `d_type` (DT_REG or DT_DIR)
+  // in `dir_name` in strcmp order, "." and ".." left out. Returns their
+  // number, -1 if the directory could not be read or indexed. The names
+  // are owned by the index.
+  int get(const char *dir_name, unsigned char d_type, char ***names);
+
+ private:
+  class listing {
+   public:
+    // d_type followed by the directory name, the key in `keys_`
+    char *key_;
+    char **names_;
+    int num_names_;
+  };
+
+  static int read_dir(const char *dir_name, unsigned char d_type,
+                      char ***names);
+
+  static void free_names(char **names, int num_names);
+
+  // Positions in `listings_` by key
+  name_index keys_;
+  listing *listings_ = nullptr;
+  int num_listings_ = 0;
+  int capacity_ = 0;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef __FILE_STORE_HPP
+#define __FILE_STORE_HPP
+
+#include <sys/types.h>
+#include <time.h>
+
+// Deduplicated store of the input files captured by `__carv_file`.
+// Each distinct content of a file is saved once as
+// `<outdir>/carved_file_<name>_<idx>`, the carved contexts only keep `idx`.
+// Files that are not modified since their last capture (same inode, size and
+// mtime) are not even read again.
+
+class file_store {
+ public:
+  file_store();
+
+  ~file_store();
+
+  file_store(file_store &other) = delete;
+  file_store(file_store &&other) = delete;
+
+  file_store &operator=(file_store &other) = delete;
+  file_store &operator=(file_store &&other) = delete;
+
+  // Returns the index of the current content of `file_name`, or -1 if the
+  // file could not be read or saved.
+  int save(const char *outdir_name, const char *file_name);
+
+  unsigned int num_saved() const { return num_saved_; }
+  unsigned int num_reused() const { return num_reused_; }
+
+  // Copies `size` bytes, as a reflink when the file system allows it.
+  static bool copy_file(int from_fd, int to_fd, off_t size);
+
+ private:
+  class entry {
+   public:
+    char *file_name_;
+    dev_t dev_;
+    ino_t ino_;
+    off_t size_;
+    struct timespec mtime_;
+    unsigned long hash_;
+    int file_idx_;
+  };
+
+  entry *find_by_stat(const char *file_name, dev_t dev, ino_t ino, off_t size,
+                      const struct timespec &mtime);
+
+  entry *find_by_hash(const char *file_name, off_t size, unsigned long hash);
+
+  int next_file_idx(const char *file_name);
+
+  entry *push_entry();
+
+  static bool hash_file(int fd, unsigned long *hash);
+
+  entry *entries_ = nullptr;
+  int num_entries_ = 0;
+  int capacity_ = 0;
+
+  unsigned int num_saved_ = 0;
+  unsigned int num_reused_ = 0;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef __FNV_HASH_HPP
+#define __FNV_HASH_HPP
+
+#include <stddef.h>
+
+// 64-bit FNV-1a, the hash of the stores, the coverage layout and the
+// replay indexes. Fast on short keys but not collision resistant, users
+// compare keys or contents on a match.
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325UL
+#define FNV_PRIME 0x100000001b3UL
+
+// Hash of `size` bytes of `data`. Pass the hash of the previous part as
+// `hash` to hash data given in parts.
+static inline unsigned long fnv_hash(const void *data, size_t size,
+                                     unsigned long hash = FNV_OFFSET_BASIS) {
+  const unsigned char *bytes = (const unsigned char *)data;
+  size_t idx;
+  for (idx = 0; idx < size; idx++) {
+    hash ^= bytes[idx];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+// Hash of the nul terminated `str`, without the nul.
+static inline unsigned long fnv_hash_str(const char *str,
+                                         unsigned long hash = FNV_OFFSET_BASIS) {
+  for (; *str != 0; str++) {
+    hash ^= (unsigned char)*str;
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef __FORK_SERVER_HPP
+#define __FORK_SERVER_HPP
+
+// AFL style fork server of the replay drivers. With REPLAY_FORK_SERVER=1
+// the driver finishes its setup once and then serves requests read from
+// FORKSRV_CTL_FD, forking a child to replay each of them.
+//
+// All words are 4 bytes in host order. The server first writes one word to
+// FORKSRV_ST_FD when it is ready. A request is a word with the length of a
+// path followed by the path, a context for driver.a and a carved object
+// directory for cl_driver.a. For each request the server writes
+// the pid of the child and, once the child is gone, its wait status. The
+// controller kills children that take too long. The server exits when
+// FORKSRV_CTL_FD is closed.
+
+#define FORK_SERVER_ENV "REPLAY_FORK_SERVER"
+
+#define FORKSRV_CTL_FD 198
+#define FORKSRV_ST_FD 199
+
+// Serves requests if REPLAY_FORK_SERVER is set. Returns the requested path
+// in each child, NULL if not serving. The server itself never returns.
+char *fork_server_run();
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef __GLOBAL_EPOCHS_HPP
+#define __GLOBAL_EPOCHS_HPP
+
+#include <stddef.h>
+
+// Last carved records of each epoch tracked global. The pass numbers the
+// pointer free globals whose address never leaves the module code and bumps
+// their generation at every write (see instrument_global_epochs), so records
+// carved at the same generation are the same. They are kept in memory and
+// written once to a snapshot file under `<outdir>/globals/` when a later
+// context reuses them, that context only gets a reference to the file.
+
+class global_epochs {
+ public:
+  global_epochs();
+
+  ~global_epochs();
+
+  global_epochs(global_epochs &other) = delete;
+  global_epochs(global_epochs &&other) = delete;
+
+  global_epochs &operator=(global_epochs &other) = delete;
+  global_epochs &operator=(global_epochs &&other) = delete;
+
+  // True if the kept records of `id` were carved at generation `gen`.
+  bool is_current(int id, unsigned int gen);
+
+  // Keeps the records of `id` carved at generation `gen`, serialized in the
+  // malloc-ed `records`, in place of older ones.
+  void set(int id, unsigned int gen, char *records, size_t size);
+
+  // Writes the snapshot file of the kept records of `id` in `outdir` if it
+  // was not yet, false if it could not be.
+  bool save(const char *outdir, int id);
+
+  // Snapshot file name of `id` at `gen`, relative to the output directory
+  void ref_name(char *buf, size_t size, int id, unsigned int gen) const;
+
+ private:
+  class entry {
+   public:
+    unsigned int gen_;
+    bool valid_;
+    bool saved_;
+    char *records_;
+    size_t size_;
+  };
+
+  bool reserve(int id);
+
+  void reset();
+
+  entry *entries_ = nullptr;
+  int capacity_ = 0;
+
+  // Process the entries belong to, a forked child starts over.
+  int pid_ = 0;
+};
+
+#endif
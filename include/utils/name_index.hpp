@@ -0,0 +1,42 @@
+#ifndef __NAME_INDEX_HPP
+#define __NAME_INDEX_HPP
+
+// Hash index from names to positions in a table owned by the caller, for
+// the function and class names replay drivers resolve carved names with,
+// and the directories of dir_index. Names are not copied and must outlive
+// the index.
+
+class name_index {
+ public:
+  name_index();
+
+  ~name_index();
+
+  name_index(name_index &other) = delete;
+  name_index(name_index &&other) = delete;
+
+  name_index &operator=(name_index &other) = delete;
+  name_index &operator=(name_index &&other) = delete;
+
+  // Adds `name` at `idx`, a name already in keeps its first index. False
+  // if the index could not grow.
+  bool insert(const char *name, int idx);
+
+  // Index of `name`, -1 if it is not in.
+  int find(const char *name) const;
+
+ private:
+  class entry {
+   public:
+    const char *name_;
+    unsigned long hash_;
+    int idx_;
+  };
+
+  // Open addressing table
+  entry *entries_ = nullptr;
+  unsigned long capacity_ = 0;
+  unsigned long num_entries_ = 0;
+};
+
+#endif
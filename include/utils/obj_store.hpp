@@ -0,0 +1,57 @@
+#ifndef __OBJ_STORE_HPP
+#define __OBJ_STORE_HPP
+
+#include <stddef.h>
+
+// Content addressed store of carved objects shared by all contexts and
+// processes writing to the same output directory. The serialized records
+// of an object are saved once as `<outdir>/objects/<hash>`, 16 hex digits
+// of their FNV-1a hash, and contexts only keep the hash. Objects are
+// written to a temp file and renamed, so a stored object is always whole.
+// A stored object is only reused if its bytes match, an object whose hash
+// collides with another one is not stored.
+
+class obj_store {
+ public:
+  obj_store();
+
+  ~obj_store();
+
+  obj_store(obj_store &other) = delete;
+  obj_store(obj_store &&other) = delete;
+
+  obj_store &operator=(obj_store &other) = delete;
+  obj_store &operator=(obj_store &&other) = delete;
+
+  // Creates `<outdir>/objects`, false if it could not be.
+  bool init(const char *outdir);
+
+  // Stores `size` bytes of `data` unless they are already, sets `hash`.
+  // False if they could not be stored, or another object has their hash.
+  bool save(const char *data, size_t size, unsigned long *hash);
+
+  unsigned long num_saved() const { return num_saved_; }
+  unsigned long num_reused() const { return num_reused_; }
+  unsigned long num_collisions() const { return num_collisions_; }
+
+ private:
+  bool contains(unsigned long hash) const;
+
+  bool insert(unsigned long hash);
+
+  // True if the object stored as `obj_name` is `size` bytes of `data`
+  bool matches(const char *obj_name, const char *data, size_t size) const;
+
+  char *dir_name_ = nullptr;
+
+  // Open addressing set of the hashes known to be stored, 0 is empty.
+  unsigned long *hashes_ = nullptr;
+  unsigned long capacity_ = 0;
+  unsigned long num_hashes_ = 0;
+
+  unsigned long num_saved_ = 0;
+  unsigned long num_reused_ = 0;
+  unsigned long num_collisions_ = 0;
+};
+
+#endif
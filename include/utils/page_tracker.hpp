@@ -0,0 +1,122 @@
+#ifndef __PAGE_TRACKER_HPP
+#define __PAGE_TRACKER_HPP
+
+// Page granular lazy carving. The pages of the inputs of a context are
+// protected once its inputs are walked, and a SIGSEGV handler snapshots a
+// page on its first touch and gives it back its permissions, so only the
+// pages the callee actually reads or writes are carved, one fault each.
+//
+// Contexts nest. A snapshot belongs to every open context that had the page
+// protected since it was opened, as its contents are unchanged since then.
+// Snapshots live in a log that is reset when the next outermost context
+// opens, so the ones of a closed context stay readable until it is dumped.
+//
+// The handler only touches memory mapped by the tracker itself, so it is
+// safe to fault inside malloc. Pages touched by the carver runtime are
+// snapshotted too, which only over-approximates the touched set.
+
+class page_tracker {
+ public:
+  // Log entries [begin_, end_) that are valid for the context at depth_.
+  class snapshot_range {
+   public:
+    unsigned long begin_ = 0;
+    unsigned long end_ = 0;
+    int depth_ = 0;
+  };
+
+  page_tracker();
+
+  ~page_tracker();
+
+  page_tracker(page_tracker &other) = delete;
+  page_tracker(page_tracker &&other) = delete;
+
+  page_tracker &operator=(page_tracker &other) = delete;
+  page_tracker &operator=(page_tracker &&other) = delete;
+
+  // Installs the SIGSEGV handler, false if it could not be.
+  bool init();
+
+  bool enabled() const { return enabled_; }
+
+  void open_context();
+
+  // Protects the pages overlapping [addr, addr + size) for the innermost
+  // context, unless they are already protected or snapshotted for it.
+  void protect(const void *addr, unsigned long size);
+
+  // Ends the innermost context, unprotecting the pages only it protected.
+  snapshot_range close_context();
+
+  // Contents of log entry `idx` of `snaps` and its page address, nullptr if
+  // it is not valid for the context of `snaps`.
+  const char *get_snapshot(const snapshot_range &snaps, unsigned long idx,
+                           unsigned long *page) const;
+
+  unsigned long page_size() const { return page_size_; }
+
+  unsigned long num_faults() const { return num_faults_; }
+
+  // Faults whose snapshot could not be stored
+  unsigned long num_dropped() const { return num_dropped_; }
+
+  // Called from the SIGSEGV handler, false if `addr` is not ours.
+  bool on_fault(unsigned long addr);
+
+ private:
+  class entry {
+   public:
+    unsigned long page_;
+    // Log index of the last snapshot of this page, -1 if none
+    long snap_idx_;
+    // Context depth that protected the page
+    int depth_;
+    bool is_protected_;
+  };
+
+  // Followed by the page contents
+  class snapshot {
+   public:
+    unsigned long page_;
+    long depth_;
+  };
+
+  entry *lookup(unsigned long page) const;
+
+  entry *insert(unsigned long page);
+
+  bool grow_table();
+
+  bool reserve_log();
+
+  snapshot *get_log(unsigned long idx) const {
+    return (snapshot *)(log_ + idx * snapshot_size_);
+  }
+
+  void unprotect_all(int min_depth);
+
+  bool enabled_ = false;
+  unsigned long page_size_ = 0;
+
+  // Open addressing hash table of tracked pages, mmap-ed
+  entry *table_ = nullptr;
+  unsigned long table_capacity_ = 0;
+  unsigned long table_size_ = 0;
+
+  // Snapshot log, mmap-ed so the handler can grow it
+  char *log_ = nullptr;
+  unsigned long snapshot_size_ = 0;
+  unsigned long log_capacity_ = 0;
+  unsigned long log_len_ = 0;
+
+  // Log length at the open of each nested context
+  unsigned long *ctx_log_begin_ = nullptr;
+  int ctx_capacity_ = 0;
+  int depth_ = 0;
+
+  unsigned long num_faults_ = 0;
+  unsigned long num_dropped_ = 0;
+};
+
+#endif
@@ -63,6 +63,34 @@ void get_class_type_info();
 extern std::map<Function *, std::vector<GlobalVariable *>> global_var_uses;
 void find_global_var_uses();
 
+// Global-state epochs, ids of the tracked globals in `__carv_global_gens`
+extern std::map<GlobalVariable *, int> global_epoch_ids;
+void instrument_global_epochs();
+
+// Emits the generation check of tracked `global` at the insert point and
+// moves it to the block carving the global. Returns the block to continue
+// at, to pass to insert_global_epoch_end, or NULL if `global` is untracked.
+BasicBlock *insert_global_epoch_begin(GlobalVariable *global);
+void insert_global_epoch_end(GlobalVariable *global, BasicBlock *tail_block);
+
+// Static metadata tables, emitted into the `carv_meta` section in place of
+// per-item registration calls in main. Each returns the table as i8*
+// (null if empty), see func_meta, global_meta and class_meta of data_utils.
+Constant *gen_func_ptr_table(
+    const std::vector<std::pair<Function *, std::string>> &funcs);
+Constant *gen_global_var_table(const std::vector<GlobalVariable *> &globals);
+Constant *gen_class_info_table();
+
+// Replay coverage. Gives a function an array of 8 bit counters, one per
+// block in `blocks` (first instruction, block name), bumped inline when the
+// block runs. insert_bb_cov_bind then writes the layout file of all such
+// blocks (see utils/cov_map.hpp) and binds their counters in main, see
+// cov_func_meta of data_utils.
+void insert_bb_cov_counters(
+    const std::string &filename, const std::string &func_name,
+    const std::vector<std::pair<Instruction *, std::string>> &blocks);
+void insert_bb_cov_bind(Function *main_func);
+
 extern Type *VoidTy;
 extern IntegerType *Int1Ty;
 extern IntegerType *Int8Ty;
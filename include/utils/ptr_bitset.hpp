@@ -0,0 +1,30 @@
+#ifndef __PTR_BITSET_HPP
+#define __PTR_BITSET_HPP
+
+// Set of pointer table indexes, one bit each. Replay drivers mark the
+// carved pointers whose pointee is already replayed.
+
+class ptr_bitset {
+ public:
+  ptr_bitset();
+
+  ~ptr_bitset();
+
+  ptr_bitset(ptr_bitset &other) = delete;
+  ptr_bitset(ptr_bitset &&other) = delete;
+
+  ptr_bitset &operator=(ptr_bitset &other) = delete;
+  ptr_bitset &operator=(ptr_bitset &&other) = delete;
+
+  // Empties the set, sized for indexes below `size`.
+  void clear(int size);
+
+  // Adds `idx`, growing the set if needed. Returns whether it was in.
+  bool test_and_set(int idx);
+
+ private:
+  unsigned long *words_ = nullptr;
+  int num_words_ = 0;
+};
+
+#endif
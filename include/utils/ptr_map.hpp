@@ -64,7 +64,19 @@ class ptr_map {
 
   void print_tree(rbtree_node *n, unsigned int);
 
+  // Telemetry, see carv_stats
+  unsigned long num_nodes() const { return num_nodes_; }
+  unsigned long num_finds() const { return num_finds_; }
+  unsigned long num_cache_hits() const { return num_cache_hits_; }
+  unsigned int max_depth() const { return max_depth_; }
+
  private:
+  unsigned long num_nodes_ = 0;
+  unsigned long num_finds_ = 0;
+  unsigned long num_cache_hits_ = 0;
+  // Deepest tree walk seen by insert or find
+  unsigned int max_depth_ = 0;
+
   void insert_case1(rbtree_node *n);
   void insert_case2(rbtree_node *n);
   void insert_case3(rbtree_node *n);
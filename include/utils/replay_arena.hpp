@@ -0,0 +1,49 @@
+#ifndef __REPLAY_ARENA_HPP
+#define __REPLAY_ARENA_HPP
+
+#include <stddef.h>
+
+// Bump allocator for the objects a replay driver rebuilds from a carved
+// file. Objects are zeroed, keep the offset from a 16 byte boundary they
+// had in the carved process, and an object that directly followed the
+// previous one there follows it again at the same distance. reset() frees
+// every object at once by rewinding to the first chunk, chunks are kept
+// for the next replay.
+
+class replay_arena {
+ public:
+  replay_arena();
+
+  ~replay_arena();
+
+  replay_arena(replay_arena &other) = delete;
+  replay_arena(replay_arena &&other) = delete;
+
+  replay_arena &operator=(replay_arena &other) = delete;
+  replay_arena &operator=(replay_arena &&other) = delete;
+
+  // `size` zeroed bytes for an object that was at `orig_addr`, 0 if the
+  // address is not known. NULL if out of memory.
+  void *alloc(size_t size, unsigned long orig_addr);
+
+  void reset();
+
+ private:
+  class chunk {
+   public:
+    chunk *next_;
+    size_t size_;
+  };
+
+  // Start of the usable bytes of `cur`, 16 byte aligned
+  static char *chunk_base(chunk *cur);
+
+  chunk *first_ = nullptr;
+  chunk *cur_ = nullptr;
+  size_t top_ = 0;
+
+  // End of the previous object in the carved process, 0 after a reset
+  unsigned long last_orig_end_ = 0;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef __SOFT_DIRTY_HPP
+#define __SOFT_DIRTY_HPP
+
+// Pages written since the last `clear`, from the soft-dirty bits of the
+// kernel: writing "4" to `/proc/self/clear_refs` clears them for the whole
+// process, and bit 55 of a `/proc/self/pagemap` entry is set again by the
+// first write to the page. Kernels built without CONFIG_MEM_SOFT_DIRTY
+// accept the clear but never set the bit, `init` checks for that and every
+// page is then reported dirty.
+
+class soft_dirty {
+ public:
+  soft_dirty();
+
+  ~soft_dirty();
+
+  soft_dirty(soft_dirty &other) = delete;
+  soft_dirty(soft_dirty &&other) = delete;
+
+  soft_dirty &operator=(soft_dirty &other) = delete;
+  soft_dirty &operator=(soft_dirty &&other) = delete;
+
+  // False if soft-dirty bits are not available.
+  bool init();
+
+  bool enabled() const { return enabled_; }
+
+  bool clear();
+
+  // Sets `dirty[i]` for the i-th page overlapping [addr, addr + size),
+  // returns the number of pages.
+  int get_dirty(const void *addr, unsigned long size, char *dirty);
+
+  // Number of pages overlapping [addr, addr + size)
+  int num_pages(const void *addr, unsigned long size) const;
+
+  unsigned long page_size() const { return page_size_; }
+
+ private:
+  bool is_dirty(unsigned long page);
+
+  bool enabled_ = false;
+  int clear_refs_fd_ = -1;
+  int pagemap_fd_ = -1;
+  unsigned long page_size_ = 4096;
+};
+
+#endif
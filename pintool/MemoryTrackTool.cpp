@@ -46,6 +46,7 @@ int shm_id = 0;
 // first 16 bytes (sizeof shm_entry) is used to store
 // 1. number of entries (first 4 bytes)
 // 2. charater writing lock (5th byte)
+// 3. number of dropped entries, the map was full (9th ~ 12th bytes)
 char* shm_map = nullptr;
 
 /* ===================================================================== */
@@ -94,6 +95,7 @@ VOID* MallocWrapperInTool(size_t size) {
 
   if (cur_num_entry >= (NUM_SHM_ENTRY - 1)) {
     // cerr << "Warn: Too many malloc/free calls" << endl;
+    ((int*)shm_map)[2] += 1;
     return res;
   }
 
@@ -125,6 +127,7 @@ VOID FreeWrapperInTool(void* p) {
   int cur_num_entry = ((int*)shm_map)[0];
   if (cur_num_entry >= (NUM_SHM_ENTRY - 1)) {
     cerr << "Warn: Too many malloc/free calls" << endl;
+    ((int*)shm_map)[2] += 1;
     return;
   }
 
@@ -179,6 +182,7 @@ VOID MainRtnCallback() {
   shm_id_file.close();
 
   ((int*)shm_map)[0] = 0;
+  ((int*)shm_map)[2] = 0;
   ((char*)shm_map)[4] = 0;
 
   enable_record = true;
@@ -42,8 +42,9 @@ bool CarverFAPass::runOnModule(llvm::Module &M) {
   remove_probe = Mod->getOrInsertFunction("__remove_mem_allocated_probe",
                                           VoidTy, Int8PtrTy);
 
-  record_func_ptr = Mod->getOrInsertFunction("__record_func_ptr", VoidTy,
-                                             Int8PtrTy, Int8PtrTy);
+  bind_meta = Mod->getOrInsertFunction("__carv_bind_meta", VoidTy, Int8PtrTy,
+                                       Int32Ty, Int8PtrTy, Int32Ty, Int8PtrTy,
+                                       Int32Ty);
 
   argv_modifier = Mod->getOrInsertFunction("__carver_argv_modifier", VoidTy,
                                            Int32PtrTy, Int8PtrPtrPtrTy);
@@ -58,13 +59,14 @@ bool CarverFAPass::runOnModule(llvm::Module &M) {
   carv_double_func = Mod->getOrInsertFunction("Carv_double", VoidTy, DoubleTy);
   carv_ptr_func = Mod->getOrInsertFunction("Carv_pointer", Int32Ty, Int8PtrTy,
                                            Int8PtrTy, Int32Ty, Int32Ty);
+  carv_next_elem_idx = Mod->getOrInsertFunction("__carv_next_elem_idx",
+                                                Int32Ty, Int32Ty, Int32Ty);
+  carv_ptr_end =
+      Mod->getOrInsertFunction("__carv_ptr_end", VoidTy, Int32Ty);
 
   carv_func_ptr =
       Mod->getOrInsertFunction("__Carv_func_ptr_name", VoidTy, Int8PtrTy);
 
-  keep_class_info = Mod->getOrInsertFunction("__keep_class_info", VoidTy,
-                                             Int8PtrTy, Int32Ty, Int32Ty);
-
   // Constructs global variables to global symbol table.
   global_carve_ready = Mod->getOrInsertGlobal("__carv_ready", Int8Ty);
   global_cur_class_idx =
@@ -72,8 +74,12 @@ bool CarverFAPass::runOnModule(llvm::Module &M) {
   global_cur_class_size =
       Mod->getOrInsertGlobal("__carv_cur_class_size", Int32Ty);
 
-  carv_open = Mod->getOrInsertFunction("__carv_open", VoidTy, Int8PtrTy);
-  carv_close = Mod->getOrInsertFunction("__carv_close", VoidTy, Int8PtrTy);
+  carv_open =
+      Mod->getOrInsertFunction("__carv_open", VoidTy, Int8PtrTy, Int32Ty);
+  carv_close =
+      Mod->getOrInsertFunction("__carv_close", VoidTy, Int8PtrTy, Int32Ty);
+  carv_post_state =
+      Mod->getOrInsertFunction("__carv_post_state", VoidTy, Int32Ty);
 
   insert_obj_info = Mod->getOrInsertFunction("__insert_obj_info", VoidTy,
                                              Int8PtrTy, Int8PtrTy);
@@ -123,8 +129,15 @@ void CarverFAPass::insert_global_carve_probe(llvm::Function *F) {
 
       IRB->CreateCall(insert_obj_info, {name_const, type_const});
 
+      // Skipped while the global keeps the generation it was carved at
+      llvm::BasicBlock *epoch_tail = insert_global_epoch_begin(glob_iter);
+
       llvm::Value *glob_val = IRB->CreateLoad(pointee_type, glob_iter);
       insert_carve_probe_fa(glob_val);
+
+      if (epoch_tail != NULL) {
+        insert_global_epoch_end(glob_iter, epoch_tail);
+      }
     }
   }
 
@@ -144,6 +157,10 @@ bool CarverFAPass::instrument_module() {
   // for each function saved in global_var_uses
   find_global_var_uses();
 
+  // from utils/pass_utils.cc
+  // before the global table of main takes the address of every global
+  instrument_global_epochs();
+
   // from CarverFAPass class
   gen_class_carver_fa();
 
@@ -159,6 +176,12 @@ bool CarverFAPass::instrument_module() {
     instrument_func(&F);
   }
 
+  // Number of dense function ids, sizes the per-function tables of runtime.
+  new llvm::GlobalVariable(*Mod, Int32Ty, true,
+                           llvm::GlobalValue::ExternalLinkage,
+                           llvm::ConstantInt::get(Int32Ty, func_id),
+                           "__carv_num_funcs");
+
   check_and_dump_module();
 
   delete IRB;
@@ -327,7 +350,7 @@ void CarverFAPass::instrument_func(llvm::Function *func) {
     llvm::Constant *func_name_const =
         gen_new_string_constant(demangled_func_name, IRB);
 
-    IRB->CreateCall(carv_open, {func_name_const});
+    IRB->CreateCall(carv_open, {func_name_const, func_id_const});
 
     unsigned int argidx = 0;
     for (auto &arg_iter : func->args()) {
@@ -354,7 +377,7 @@ void CarverFAPass::instrument_func(llvm::Function *func) {
       IRB->CreateCall(carv_file, {input_name_const});
     }
 
-    IRB->CreateCall(carv_close, {func_name_const});
+    IRB->CreateCall(carv_close, {func_name_const, func_id_const});
   }
 
   DEBUG0("Insert memory tracking for " << demangled_func_name << "\n");
@@ -422,6 +445,7 @@ void CarverFAPass::instrument_func(llvm::Function *func) {
   // Probing at return
   for (auto ret_instr : ret_instrs) {
     IRB->SetInsertPoint(ret_instr);
+    IRB->CreateCall(carv_post_state, {func_id_const});
     insert_dealloc_probes();
   }
 
@@ -567,8 +591,10 @@ void CarverFAPass::insert_carve_probe_fa(llvm::Value *val) {
       loopblock = IRB->GetInsertBlock();
     }
 
+    // The runtime may skip elements of huge pointees, see
+    // __carv_next_elem_idx.
     llvm::Value *index_update_instr =
-        IRB->CreateAdd(index_phi, llvm::ConstantInt::get(Int32Ty, 1));
+        IRB->CreateCall(carv_next_elem_idx, {index_phi, pointer_size});
     index_phi->addIncoming(index_update_instr, loopblock);
 
     llvm::Value *cmp_instr2 =
@@ -600,6 +626,9 @@ void CarverFAPass::insert_carve_probe_fa(llvm::Value *val) {
 
     IRB->SetInsertPoint(endblock->getFirstNonPHIOrDbgOrLifetime());
 
+    // Lets the runtime move the carved elements to the object store.
+    IRB->CreateCall(carv_ptr_end, {end_size});
+
   } else {
     // Unknown llvm::Type
   }
@@ -672,63 +701,36 @@ void CarverFAPass::instrument_main(llvm::Function *main_func) {
 
   IRB->SetInsertPoint(new_argv_load_instr->getNextNonDebugInstruction());
 
-  auto globals = Mod->global_values();
-  // Global variables memory probing
-  for (auto global_iter = globals.begin(); global_iter != globals.end();
-       global_iter++) {
-    if (!llvm::isa<GlobalVariable>(*global_iter)) {
-      continue;
-    }
-
-    std::string name = global_iter->getName().str();
-    std::string demangled = llvm::demangle(name);
-
-    llvm::GlobalValue *global_v1 = &(*global_iter);
-
-    GlobalVariable *global_v = llvm::dyn_cast<GlobalVariable>(global_v1);
-    if (global_v->getName().str().find("llvm.") != std::string::npos) {
+  // Global variables, function pointers and classes are bound from static
+  // tables at once, instead of one probe call per item.
+  std::vector<llvm::GlobalVariable *> global_vars;
+  for (llvm::GlobalVariable &global_v : Mod->globals()) {
+    if (global_v.getName().str().find("llvm.") != std::string::npos) {
       continue;
     }
-
-    llvm::Value *casted_ptr = IRB->CreateCast(
-        llvm::Instruction::CastOps::BitCast, global_v, Int8PtrTy);
-    llvm::Type *gv_type = global_v->getValueType();
-    unsigned int size = DL->getTypeAllocSize(gv_type);
-
-    llvm::Constant *type_name_const = llvm::Constant::getNullValue(Int8PtrTy);
-
-    if (gv_type->isStructTy() &&
-        llvm::dyn_cast<llvm::StructType>(gv_type)->hasName()) {
-      std::string type_name = gv_type->getStructName().str();
-      type_name_const = gen_new_string_constant(type_name, IRB);
-    }
-
-    llvm::Value *size_const = llvm::ConstantInt::get(Int32Ty, size);
-    IRB->CreateCall(mem_allocated_probe,
-                    {casted_ptr, size_const, type_name_const});
+    global_vars.push_back(&global_v);
   }
 
-  // Record func ptr
+  std::vector<std::pair<llvm::Function *, std::string>> funcs;
   for (auto &Func : Mod->functions()) {
     if (Func.isIntrinsic()) {
       continue;
     }
 
-    std::string func_name = llvm::demangle(Func.getName().str());
-    llvm::Constant *func_name_const = gen_new_string_constant(func_name, IRB);
-    llvm::Value *cast_val =
-        IRB->CreateCast(llvm::Instruction::CastOps::BitCast, &Func, Int8PtrTy);
-    IRB->CreateCall(record_func_ptr, {cast_val, func_name_const});
+    funcs.push_back(
+        std::make_pair(&Func, llvm::demangle(Func.getName().str())));
   }
 
-  // Record class llvm::Type string llvm::Constants
-  for (auto iter : class_name_map) {
-    unsigned int class_size = DL->getTypeAllocSize(iter.first);
-    IRB->CreateCall(
-        keep_class_info,
-        {iter.second.second, llvm::ConstantInt::get(Int32Ty, class_size),
-         llvm::ConstantInt::get(Int32Ty, iter.second.first)});
-  }
+  llvm::Constant *global_var_table = gen_global_var_table(global_vars);
+  llvm::Constant *func_ptr_table = gen_func_ptr_table(funcs);
+  llvm::Constant *class_info_table = gen_class_info_table();
+
+  IRB->CreateCall(
+      bind_meta,
+      {func_ptr_table, llvm::ConstantInt::get(Int32Ty, funcs.size()),
+       global_var_table, llvm::ConstantInt::get(Int32Ty, global_vars.size()),
+       class_info_table,
+       llvm::ConstantInt::get(Int32Ty, class_name_map.size())});
 
   for (auto call_instr : call_instrs) {
     llvm::Function *callee = call_instr->getCalledFunction();
@@ -9,28 +9,415 @@
 
 #include <iostream>
 
+#include "utils/addr_space.hpp"
+#include "utils/carv_budget.hpp"
+#include "utils/carv_sdt.hpp"
+#include "utils/carv_stats.hpp"
 #include "utils/data_utils.hpp"
+#include "utils/file_store.hpp"
+#include "utils/global_epochs.hpp"
+#include "utils/obj_store.hpp"
 #include "utils/ptr_map.hpp"
+#include "utils/soft_dirty.hpp"
 
 #define MAX_NUM_FILE 8
 #define MINSIZE 3
 #define MAXSIZE 24
 
+#define SAMPLE_HEAD_ENV "CARV_SAMPLE_HEAD"
+#define SAMPLE_TAIL_ENV "CARV_SAMPLE_TAIL"
+#define SAMPLE_STRIDED_ENV "CARV_SAMPLE_STRIDED"
+
+#define SPILL_RECORDS_ENV "CARV_SPILL_RECORDS"
+#define DEFAULT_SPILL_RECORDS (1 << 20)
+
+#define POST_STATE_ENV "CARV_POST_STATE"
+
+#define GLOBAL_EPOCHS_ENV "CARV_GLOBAL_EPOCHS"
+
+#define OBJ_STORE_ENV "CARV_OBJ_STORE"
+#define OBJ_STORE_MIN_RECORDS_ENV "CARV_OBJ_STORE_MIN_RECORDS"
+#define DEFAULT_OBJ_STORE_MIN_RECORDS 64
+
 static char *outdir_name = NULL;
 
 static int carved_index = 0;
 
-// Function pointer names
-static map<void *, char *> func_ptrs;
+// Static metadata tables emitted by the pass, see __carv_bind_meta
+static func_meta *func_ptrs = NULL;
+static int num_func_ptrs = 0;
+static global_meta *global_vars = NULL;
+static int num_global_vars = 0;
+static class_meta *class_info = NULL;
+static int num_class_info = 0;
 
 // inputs, work as similar as function call stack
 static vector<IVAR *> carved_objs;
 static vector<POINTER> carved_ptrs;
 
+// Once the opened context holds `spill_records` records, they are written
+// out to an unlinked temp file in the output directory and freed. At
+// __carv_close the temp file is copied after the pointer table, so the
+// carved file is the same and memory per context stays bounded.
+static unsigned int spill_records = DEFAULT_SPILL_RECORDS;
+static FILE *spill_file = NULL;
+static unsigned int num_spilled = 0;
+
+// Global-state epochs, a global carved again at an unchanged generation is
+// recorded as GLOBAL_REF:<snapshot file>, see global_epochs.hpp
+static bool use_global_epochs = false;
+static global_epochs global_snaps;
+
+// An unknown pointer might be the end point of a carved pointer. Resolved
+// against the whole pointer table when the carved file is written, a
+// pointee registered later in the walk can still match.
+static void write_unknown_ptr(FILE *outfile, void *addr) {
+  const int num_carved_ptrs = carved_ptrs.size();
+  int carved_idx = 0;
+  int offset;
+  while (carved_idx < num_carved_ptrs) {
+    POINTER *carved_ptr = carved_ptrs.get(carved_idx);
+    char *end_addr = (char *)carved_ptr->addr + carved_ptr->alloc_size;
+    if (end_addr == addr) {
+      offset = carved_ptr->alloc_size;
+      break;
+    }
+    carved_idx++;
+  }
+
+  if (carved_idx == num_carved_ptrs) {
+    fprintf(outfile, "UNKNOWN_PTR:%p\n", addr);
+  } else {
+    fprintf(outfile, "PTR:%d:%d\n", carved_idx, offset);
+  }
+}
+
+// Spilled records keep UNKNOWN_PTR unresolved, the spill file is resolved
+// while it is copied at __carv_close.
+static void write_carved_obj(FILE *outfile, IVAR *elem, bool spilled) {
+  if (elem->type == INPUT_TYPE::CHAR) {
+    fprintf(outfile, "CHAR:%d\n", (int)(((VAR<char> *)elem)->input));
+  } else if (elem->type == INPUT_TYPE::SHORT) {
+    fprintf(outfile, "SHORT:%d\n", (int)(((VAR<short> *)elem)->input));
+  } else if (elem->type == INPUT_TYPE::INT) {
+    fprintf(outfile, "INT:%d\n", (int)(((VAR<int> *)elem)->input));
+  } else if (elem->type == INPUT_TYPE::LONG) {
+    fprintf(outfile, "LONG:%ld\n", ((VAR<long> *)elem)->input);
+  } else if (elem->type == INPUT_TYPE::LONGLONG) {
+    fprintf(outfile, "LONGLONG:%lld\n", ((VAR<long long> *)elem)->input);
+  } else if (elem->type == INPUT_TYPE::FLOAT) {
+    fprintf(outfile, "FLOAT:%f\n", ((VAR<float> *)elem)->input);
+  } else if (elem->type == INPUT_TYPE::DOUBLE) {
+    fprintf(outfile, "DOUBLE:%lf\n", ((VAR<double> *)elem)->input);
+  } else if (elem->type == INPUT_TYPE::NULLPTR) {
+    fprintf(outfile, "NULLPTR:0\n");
+  } else if (elem->type == INPUT_TYPE::PTR) {
+    VAR<int> *input = (VAR<int> *)elem;
+    fprintf(outfile, "PTR:%d:%d\n", input->input, input->pointer_offset);
+  } else if (elem->type == INPUT_TYPE::FUNCPTR) {
+    VAR<char *> *input = (VAR<char *> *)elem;
+    fprintf(outfile, "FUNCPTR:%s\n", input->input);
+  } else if (elem->type == INPUT_TYPE::UNKNOWN_PTR) {
+    void *addr = ((VAR<void *> *)elem)->input;
+    if (spilled) {
+      fprintf(outfile, "UNKNOWN_PTR:%p\n", addr);
+    } else {
+      write_unknown_ptr(outfile, addr);
+    }
+  } else if (elem->type == INPUT_TYPE::OBJ_INFO) {
+    VAR<char *> *input = (VAR<char *> *)elem;
+    fprintf(outfile, "OBJ_INFO:%s:%s\n", elem->name, input->input);
+  } else if (elem->type == INPUT_TYPE::INPUTFILE) {
+    VAR<int> *input = (VAR<int> *)elem;
+    fprintf(outfile, "INPUTFILE:%d:%s\n", input->input, elem->name);
+  } else if (elem->type == INPUT_TYPE::TRUNCATED) {
+    fprintf(outfile, "TRUNCATED:0\n");
+  } else if (elem->type == INPUT_TYPE::SKIPPED) {
+    fprintf(outfile, "SKIPPED:%d\n", ((VAR<int> *)elem)->input);
+  } else if (elem->type == INPUT_TYPE::GLOBAL_REF) {
+    VAR<int> *input = (VAR<int> *)elem;
+    char ref[256];
+    global_snaps.ref_name(ref, 256, input->input, input->pointer_offset);
+    fprintf(outfile, "GLOBAL_REF:%s\n", ref);
+  } else if (elem->type == INPUT_TYPE::OBJ_REF) {
+    fprintf(outfile, "OBJ_REF:%016lx\n", ((VAR<long> *)elem)->input);
+  } else {
+    std::cerr << "Warning : unknown element type : " << elem->type << ", "
+              << elem->name << "\n";
+  }
+}
+
+static void delete_carved_objs() {
+  const int num_objs = carved_objs.size();
+  int idx = 0;
+  while (idx < num_objs) {
+    delete *(carved_objs.get(idx));
+    idx++;
+  }
+  carved_objs.clear();
+}
+
+static void close_spill_file() {
+  if (spill_file != NULL) {
+    fclose(spill_file);
+    spill_file = NULL;
+  }
+  num_spilled = 0;
+}
+
+static void spill_carved_objs() {
+  if (spill_file == NULL) {
+    char spill_file_name[512];
+    snprintf(spill_file_name, 512, "%s/.carv_spill_XXXXXX", outdir_name);
+    int fd = mkstemp(spill_file_name);
+    if (fd < 0) {
+      // Keep the records in memory.
+      return;
+    }
+    unlink(spill_file_name);
+    spill_file = fdopen(fd, "w+");
+    if (spill_file == NULL) {
+      close(fd);
+      return;
+    }
+  }
+
+  const int num_objs = carved_objs.size();
+  int idx = 0;
+  while (idx < num_objs) {
+    write_carved_obj(spill_file, *(carved_objs.get(idx)), true);
+    idx++;
+  }
+  num_spilled += num_objs;
+  delete_carved_objs();
+  CARV_PROBE2(spill, num_objs, num_spilled);
+}
+
+static inline void push_carved_obj(IVAR *obj) {
+  carved_objs.push_back(obj);
+  if ((spill_records != 0) && (carved_objs.size() >= spill_records)) {
+    spill_carved_objs();
+  }
+}
+
+// Object store. The element records of a pointee that refer to no other
+// pointee, at least `obj_store_min_records` of them, are saved in the
+// shared store and replaced by one OBJ_REF:<hash> record, see obj_store.hpp
+static bool use_obj_store = false;
+static obj_store objects;
+static int obj_store_min_records = DEFAULT_OBJ_STORE_MIN_RECORDS;
+
+// Pointees whose elements are being carved, innermost last
+typedef struct obj_frame_ {
+  // Index of the first element record in `carved_objs`
+  int begin_idx;
+  unsigned int num_spilled;
+} obj_frame;
+
+static obj_frame *obj_frames = NULL;
+static int num_obj_frames = 0;
+static int obj_frames_capacity = 0;
+
+static void push_obj_frame() {
+  if (num_obj_frames == obj_frames_capacity) {
+    int new_capacity = obj_frames_capacity == 0 ? 64 : obj_frames_capacity * 2;
+    obj_frame *new_frames =
+        (obj_frame *)realloc(obj_frames, sizeof(obj_frame) * new_capacity);
+    if (new_frames == NULL) {
+      return;
+    }
+    obj_frames = new_frames;
+    obj_frames_capacity = new_capacity;
+  }
+
+  obj_frame *frame = &obj_frames[num_obj_frames++];
+  frame->begin_idx = carved_objs.size();
+  frame->num_spilled = num_spilled;
+}
+
+// Records that mean the same in any context
+static bool is_context_free_obj(IVAR *elem) {
+  switch (elem->type) {
+    case INPUT_TYPE::CHAR:
+    case INPUT_TYPE::SHORT:
+    case INPUT_TYPE::INT:
+    case INPUT_TYPE::LONG:
+    case INPUT_TYPE::LONGLONG:
+    case INPUT_TYPE::FLOAT:
+    case INPUT_TYPE::DOUBLE:
+    case INPUT_TYPE::NULLPTR:
+    case INPUT_TYPE::FUNCPTR:
+    case INPUT_TYPE::SKIPPED:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Post-state carving. When the body of a carved function starts, the
+// contents of its carved pointees are copied, and when it returns the bytes
+// that changed since are appended to its file as records
+//   POST:<ptr_idx>:<offset>:<hex bytes>
+// Only pages with their soft-dirty bit set are compared. The bits are
+// cleared when no other carved function is running, so nested contexts
+// see a superset of their writes, which the byte comparison filters out.
+static bool post_state = false;
+static soft_dirty dirty_pages;
+
+typedef struct post_ctx_ {
+  int func_id;
+  // NULL if the context was not written
+  char *outfile_name;
+  int num_ptrs;
+  char **addrs;
+  int *sizes;
+  char **copies;
+} post_ctx;
+
+// Contexts whose function has not returned yet, innermost last
+static post_ctx *post_ctxs = NULL;
+static int num_post_ctxs = 0;
+static int post_ctxs_capacity = 0;
+
+static void free_post_ctx(post_ctx *ctx) {
+  int idx;
+  for (idx = 0; idx < ctx->num_ptrs; idx++) {
+    free(ctx->copies[idx]);
+  }
+  free(ctx->copies);
+  free(ctx->sizes);
+  free(ctx->addrs);
+  free(ctx->outfile_name);
+}
+
+static void push_post_ctx(int func_id, const char *outfile_name) {
+  if (num_post_ctxs == post_ctxs_capacity) {
+    int new_capacity = (post_ctxs_capacity == 0) ? 16 : post_ctxs_capacity * 2;
+    post_ctx *new_ctxs =
+        (post_ctx *)realloc(post_ctxs, sizeof(post_ctx) * new_capacity);
+    if (new_ctxs == NULL) {
+      return;
+    }
+    post_ctxs = new_ctxs;
+    post_ctxs_capacity = new_capacity;
+  }
+
+  if (num_post_ctxs == 0) {
+    dirty_pages.clear();
+  }
+
+  post_ctx *ctx = &post_ctxs[num_post_ctxs++];
+  memset(ctx, 0, sizeof(post_ctx));
+  ctx->func_id = func_id;
+  if (outfile_name == NULL) {
+    return;
+  }
+
+  const int num_carved_ptrs = carved_ptrs.size();
+  ctx->outfile_name = strdup(outfile_name);
+  ctx->addrs = (char **)calloc(num_carved_ptrs, sizeof(char *));
+  ctx->sizes = (int *)calloc(num_carved_ptrs, sizeof(int));
+  ctx->copies = (char **)calloc(num_carved_ptrs, sizeof(char *));
+  ctx->num_ptrs = num_carved_ptrs;
+
+  int idx;
+  for (idx = 0; idx < num_carved_ptrs; idx++) {
+    POINTER *carved_ptr = carved_ptrs.get(idx);
+    if (carved_ptr->alloc_size <= 0) {
+      continue;
+    }
+    char *copy = (char *)malloc(carved_ptr->alloc_size);
+    if (copy == NULL) {
+      continue;
+    }
+    memcpy(copy, carved_ptr->addr, carved_ptr->alloc_size);
+    ctx->addrs[idx] = (char *)carved_ptr->addr;
+    ctx->sizes[idx] = carved_ptr->alloc_size;
+    ctx->copies[idx] = copy;
+  }
+}
+
+static void write_post_state(post_ctx *ctx) {
+  FILE *outfile = fopen(ctx->outfile_name, "a");
+  if (outfile == NULL) {
+    return;
+  }
+
+  const unsigned long page_size = dirty_pages.page_size();
+  char *dirty = NULL;
+  int dirty_capacity = 0;
+
+  int ptr_idx;
+  for (ptr_idx = 0; ptr_idx < ctx->num_ptrs; ptr_idx++) {
+    char *addr = ctx->addrs[ptr_idx];
+    char *copy = ctx->copies[ptr_idx];
+    int size = ctx->sizes[ptr_idx];
+    if (copy == NULL) {
+      continue;
+    }
+
+    int num_pages = dirty_pages.num_pages(addr, size);
+    if (num_pages > dirty_capacity) {
+      free(dirty);
+      dirty = (char *)malloc(num_pages);
+      dirty_capacity = dirty == NULL ? 0 : num_pages;
+      if (dirty == NULL) {
+        break;
+      }
+    }
+    dirty_pages.get_dirty(addr, size, dirty);
+
+    unsigned long first_page = (unsigned long)addr / page_size;
+    int offset = 0;
+    while (offset < size) {
+      unsigned long page_idx = ((unsigned long)addr + offset) / page_size;
+      unsigned long page_end = (page_idx + 1) * page_size;
+      int chunk_end = page_end - (unsigned long)addr;
+      if (chunk_end > size) {
+        chunk_end = size;
+      }
+
+      if (!dirty[page_idx - first_page]) {
+        offset = chunk_end;
+        continue;
+      }
+
+      // Runs of changed bytes in the dirty page
+      while (offset < chunk_end) {
+        if (addr[offset] == copy[offset]) {
+          offset++;
+          continue;
+        }
+        int run_end = offset + 1;
+        while ((run_end < chunk_end) && (addr[run_end] != copy[run_end])) {
+          run_end++;
+        }
+        fprintf(outfile, "POST:%d:%d:", ptr_idx, offset);
+        for (; offset < run_end; offset++) {
+          fprintf(outfile, "%02x", (unsigned char)addr[offset]);
+        }
+        fprintf(outfile, "\n");
+      }
+    }
+  }
+
+  free(dirty);
+  fclose(outfile);
+}
+
 // memory info
 ptr_map alloced_ptrs;
+// Classifies pointers that are not tracked allocations
+static addr_space addr_ranges;
 // map<void *, struct typeinfo> alloced_ptrs;
 
+// Telemetry, written at __carv_FINI
+static carv_stats stats;
+
+// Carving budget of the opened context, see carv_budget.hpp
+static carv_budget budget;
+static int cur_func_id = -1;
+
 int __carv_cur_class_index = -1;
 int __carv_cur_class_size = -1;
 
@@ -38,8 +425,6 @@ bool __carv_opened = false;
 bool __carv_ready = false;
 char __carv_depth = 0;
 
-static map<char *, classinfo> class_info;
-
 extern "C" {
 
 void __insert_obj_info(char *name, char *type_name) {
@@ -47,7 +432,7 @@ void __insert_obj_info(char *name, char *type_name) {
     return;
   }
   VAR<char *> *inputv = new VAR<char *>(type_name, name, INPUT_TYPE::OBJ_INFO);
-  carved_objs.push_back((IVAR *)inputv);
+  push_carved_obj((IVAR *)inputv);
 }
 
 void Carv_char(char input) {
@@ -55,7 +440,7 @@ void Carv_char(char input) {
     return;
   }
   VAR<char> *inputv = new VAR<char>(input, 0, INPUT_TYPE::CHAR);
-  carved_objs.push_back((IVAR *)inputv);
+  push_carved_obj((IVAR *)inputv);
 }
 
 void Carv_short(short input) {
@@ -63,7 +448,7 @@ void Carv_short(short input) {
     return;
   }
   VAR<short> *inputv = new VAR<short>(input, 0, INPUT_TYPE::SHORT);
-  carved_objs.push_back((IVAR *)inputv);
+  push_carved_obj((IVAR *)inputv);
 }
 
 void Carv_int(int input) {
@@ -71,7 +456,7 @@ void Carv_int(int input) {
     return;
   }
   VAR<int> *inputv = new VAR<int>(input, 0, INPUT_TYPE::INT);
-  carved_objs.push_back((IVAR *)inputv);
+  push_carved_obj((IVAR *)inputv);
 }
 
 void Carv_longtype(long input) {
@@ -79,7 +464,7 @@ void Carv_longtype(long input) {
     return;
   }
   VAR<long> *inputv = new VAR<long>(input, 0, INPUT_TYPE::LONG);
-  carved_objs.push_back((IVAR *)inputv);
+  push_carved_obj((IVAR *)inputv);
 }
 
 void Carv_longlong(long long input) {
@@ -87,7 +472,7 @@ void Carv_longlong(long long input) {
     return;
   }
   VAR<long long> *inputv = new VAR<long long>(input, 0, INPUT_TYPE::LONGLONG);
-  carved_objs.push_back((IVAR *)inputv);
+  push_carved_obj((IVAR *)inputv);
 }
 
 void Carv_float(float input) {
@@ -95,7 +480,7 @@ void Carv_float(float input) {
     return;
   }
   VAR<float> *inputv = new VAR<float>(input, 0, INPUT_TYPE::FLOAT);
-  carved_objs.push_back((IVAR *)inputv);
+  push_carved_obj((IVAR *)inputv);
 }
 
 void Carv_double(double input) {
@@ -103,7 +488,7 @@ void Carv_double(double input) {
     return;
   }
   VAR<double> *inputv = new VAR<double>(input, 0, INPUT_TYPE::DOUBLE);
-  carved_objs.push_back((IVAR *)inputv);
+  push_carved_obj((IVAR *)inputv);
 }
 
 int Carv_pointer(void *ptr, char *type_name, int default_idx,
@@ -114,7 +499,7 @@ int Carv_pointer(void *ptr, char *type_name, int default_idx,
 
   if (ptr == NULL) {
     VAR<void *> *inputv = new VAR<void *>(NULL, 0, INPUT_TYPE::NULLPTR);
-    carved_objs.push_back((IVAR *)inputv);
+    push_carved_obj((IVAR *)inputv);
     return 0;
   }
 
@@ -132,7 +517,7 @@ int Carv_pointer(void *ptr, char *type_name, int default_idx,
     if ((carved_addr <= ptr) && (ptr < carved_addr_end)) {
       int offset = ((char *)ptr) - carved_addr;
       VAR<int> *inputv = new VAR<int>(index, 0, offset, INPUT_TYPE::PTR);
-      carved_objs.push_back((IVAR *)inputv);
+      push_carved_obj((IVAR *)inputv);
       // Won't carve again.
       return 0;
     } else if (ptr == carved_addr_end) {
@@ -144,38 +529,86 @@ int Carv_pointer(void *ptr, char *type_name, int default_idx,
 
   if (end_index != -1) {
     VAR<int> *inputv = new VAR<int>(end_index, 0, end_offset, INPUT_TYPE::PTR);
-    carved_objs.push_back((IVAR *)inputv);
+    push_carved_obj((IVAR *)inputv);
     return 0;
   }
 
+  char *alloc_ptr = NULL;
+  int ptr_alloc_size = 0;
+  char *name_ptr = NULL;
+
   ptr_map::rbtree_node *ptr_node = alloced_ptrs.find(ptr);
+  global_meta *global_var = NULL;
+  const addr_space::range *ptr_range = nullptr;
+  addr_space::kind ptr_kind = addr_space::UNMAPPED;
   if (ptr_node == NULL) {
-    auto search = func_ptrs.find(ptr);
-    if (search != NULL) {
-      VAR<char *> *inputv = new VAR<char *>(*search, 0, INPUT_TYPE::FUNCPTR);
-      carved_objs.push_back((IVAR *)inputv);
-      return 0;
+    ptr_range = addr_ranges.find(ptr);
+    if (ptr_range != nullptr) {
+      ptr_kind = ptr_range->kind_;
+    }
+  }
+
+  // Globals are never in the heap or stack mappings nor in the code of a
+  // shared object, and functions only in the text ones. The executable's
+  // own text mapping also holds .rodata when it is linked with
+  // -z noseparate-code.
+  bool maybe_global = (ptr_kind != addr_space::HEAP) &&
+                      (ptr_kind != addr_space::STACK) &&
+                      (ptr_kind != addr_space::SPECIAL) &&
+                      !((ptr_kind == addr_space::TEXT) && ptr_range->is_lib_);
+  if (ptr_node != NULL) {
+    alloc_ptr = (char *)ptr_node->key_;
+    ptr_alloc_size = ptr_node->alloc_size_;
+    name_ptr = ptr_node->type_name_;
+  } else if (maybe_global &&
+             ((global_var = find_global_meta(global_vars, num_global_vars,
+                                             ptr)) != NULL)) {
+    alloc_ptr = (char *)global_var->addr;
+    ptr_alloc_size = global_var->size;
+    name_ptr = global_var->type_name;
+  } else if ((ptr_kind == addr_space::RODATA) &&
+             ((ptr_alloc_size = addr_ranges.rodata_size(
+                   ptr, default_size, !strcmp(type_name, "i8"))) > 0)) {
+    // String literals and other read only data, carved by value.
+    alloc_ptr = (char *)ptr;
+  } else {
+    if ((ptr_kind == addr_space::TEXT) || (ptr_kind == addr_space::UNMAPPED)) {
+      func_meta *search = find_func_meta(func_ptrs, num_func_ptrs, ptr);
+      if (search != NULL) {
+        VAR<char *> *inputv =
+            new VAR<char *>(search->name, 0, INPUT_TYPE::FUNCPTR);
+        push_carved_obj((IVAR *)inputv);
+        return 0;
+      }
     }
 
     VAR<void *> *inputv =
         new VAR<void *>(ptr, type_name, INPUT_TYPE::UNKNOWN_PTR);
-    carved_objs.push_back((IVAR *)inputv);
+    push_carved_obj((IVAR *)inputv);
     return 0;
   }
 
-  char *alloc_ptr = (char *)ptr_node->key_;
-  int ptr_alloc_size = ptr_node->alloc_size_;
+  // Pointees are only nested in structs here, so struct depth is used as
+  // the pointer depth.
+  if (!budget.charge(carved_objs.size() + num_spilled, __carv_depth,
+                     ptr_alloc_size)) {
+    VAR<void *> *inputv =
+        new VAR<void *>(ptr, type_name, INPUT_TYPE::TRUNCATED);
+    push_carved_obj((IVAR *)inputv);
+    CARV_PROBE2(truncated, ptr, ptr_alloc_size);
+    stats.on_truncated(cur_func_id);
+    return 0;
+  }
 
   int new_carved_ptr_index = carved_ptrs.size();
 
   __carv_cur_class_index = default_idx;
   __carv_cur_class_size = default_size;
 
-  char *name_ptr = ptr_node->type_name_;
   if (name_ptr != NULL) {
-    auto search = class_info.find(name_ptr);
+    class_meta *search = find_class_meta(class_info, num_class_info, name_ptr);
     if ((search != NULL) && ((ptr_alloc_size % search->size) == 0)) {
-      __carv_cur_class_index = search->class_index;
+      __carv_cur_class_index = search->index;
       __carv_cur_class_size = search->size;
       type_name = name_ptr;
     }
@@ -184,36 +617,156 @@ int Carv_pointer(void *ptr, char *type_name, int default_idx,
   carved_ptrs.push_back(POINTER(ptr, type_name, ptr_alloc_size, default_size));
 
   VAR<int> *inputv = new VAR<int>(new_carved_ptr_index, 0, 0, INPUT_TYPE::PTR);
-  carved_objs.push_back((IVAR *)inputv);
+  push_carved_obj((IVAR *)inputv);
+
+  if (use_obj_store) {
+    push_obj_frame();
+  }
 
   return ptr_alloc_size;
 }
 
+// Called once the elements of a pointee are carved, `end_size` is what
+// Carv_pointer returned for it.
+void __carv_ptr_end(int end_size) {
+  if (!use_obj_store || (end_size == 0) || (num_obj_frames == 0)) {
+    return;
+  }
+
+  obj_frame *frame = &obj_frames[--num_obj_frames];
+  if (!__carv_opened || (num_spilled != frame->num_spilled)) {
+    return;
+  }
+
+  const int num_objs = carved_objs.size();
+  if (num_objs - frame->begin_idx < obj_store_min_records) {
+    return;
+  }
+
+  int idx;
+  for (idx = frame->begin_idx; idx < num_objs; idx++) {
+    if (!is_context_free_obj(*(carved_objs.get(idx)))) {
+      return;
+    }
+  }
+
+  char *records = NULL;
+  size_t size = 0;
+  FILE *records_file = open_memstream(&records, &size);
+  if (records_file == NULL) {
+    return;
+  }
+  for (idx = frame->begin_idx; idx < num_objs; idx++) {
+    write_carved_obj(records_file, *(carved_objs.get(idx)), false);
+  }
+  fclose(records_file);
+
+  unsigned long hash;
+  bool is_saved = objects.save(records, size, &hash);
+  free(records);
+  if (!is_saved) {
+    return;
+  }
+
+  for (idx = frame->begin_idx; idx < num_objs; idx++) {
+    delete *(carved_objs.back());
+    carved_objs.pop_back();
+  }
+
+  VAR<long> *inputv = new VAR<long>((long)hash, 0, INPUT_TYPE::OBJ_REF);
+  push_carved_obj((IVAR *)inputv);
+}
+
+// Sampling of huge pointees. A pointee with more than head + tail + strided
+// elements only has its first `head`, last `tail` and `strided` evenly
+// strided elements in between carved. Off while all are 0.
+static int sample_head = 0;
+static int sample_tail = 0;
+static int sample_strided = 0;
+
+static int get_sample_env(const char *name) {
+  const char *val = getenv(name);
+  if (val == NULL) {
+    return 0;
+  }
+  int num = atoi(val);
+  return num < 0 ? 0 : num;
+}
+
+// Index of the element to carve after `idx` in a pointee of `num_elems`
+// elements, called by the element loop of the pass. Elements skipped over
+// are recorded as one SKIPPED input, replay drivers leave them zeroed.
+int __carv_next_elem_idx(int idx, int num_elems) {
+  int next_idx = idx + 1;
+  if ((!__carv_opened) ||
+      (num_elems <= sample_head + sample_tail + sample_strided)) {
+    return next_idx;
+  }
+
+  if ((sample_head == 0) && (sample_tail == 0) && (sample_strided == 0)) {
+    return next_idx;
+  }
+
+  const int tail_begin = num_elems - sample_tail;
+  if ((next_idx < sample_head) || (next_idx >= tail_begin)) {
+    return next_idx;
+  }
+
+  if (idx >= sample_head) {
+    if (sample_strided == 0) {
+      next_idx = tail_begin;
+    } else {
+      const int stride =
+          (tail_begin - sample_head + sample_strided - 1) / sample_strided;
+      next_idx = idx + stride;
+      if (next_idx > tail_begin) {
+        next_idx = tail_begin;
+      }
+    }
+  } else if (sample_strided == 0) {
+    next_idx = tail_begin;
+  }
+
+  if (next_idx > idx + 1) {
+    VAR<int> *inputv =
+        new VAR<int>(next_idx - idx - 1, 0, INPUT_TYPE::SKIPPED);
+    push_carved_obj((IVAR *)inputv);
+  }
+  return next_idx;
+}
+
 void __Carv_func_ptr_name(void *ptr) {
   if (!__carv_opened) {
     return;
   }
 
-  auto search = func_ptrs.find(ptr);
+  func_meta *search = find_func_meta(func_ptrs, num_func_ptrs, ptr);
   if ((ptr == NULL) || (search == NULL)) {
     VAR<void *> *inputv = new VAR<void *>(NULL, NULL, INPUT_TYPE::NULLPTR);
-    carved_objs.push_back((IVAR *)inputv);
+    push_carved_obj((IVAR *)inputv);
     return;
   }
 
-  VAR<char *> *inputv = new VAR<char *>(*search, NULL, INPUT_TYPE::FUNCPTR);
-  carved_objs.push_back((IVAR *)inputv);
+  VAR<char *> *inputv =
+      new VAR<char *>(search->name, NULL, INPUT_TYPE::FUNCPTR);
+  push_carved_obj((IVAR *)inputv);
   return;
 }
 
-void __record_func_ptr(void *ptr, char *name) {
-  std::cerr << "Recording func ptr : " << ptr << ", " << name << "\n";
-  func_ptrs.insert(ptr, name);
-}
-
-void __keep_class_info(char *class_name, int size, int index) {
-  classinfo tmp(index, size);
-  class_info.insert(class_name, tmp);
+// Bind the static tables of function pointers, global variables and
+// classes emitted by the pass. Sorted once here, then binary searched.
+void __carv_bind_meta(func_meta *funcs, int num_funcs, global_meta *globals,
+                      int num_globals, class_meta *classes, int num_classes) {
+  sort_func_meta(funcs, num_funcs);
+  sort_global_meta(globals, num_globals);
+  sort_class_meta(classes, num_classes);
+
+  func_ptrs = funcs;
+  num_func_ptrs = num_funcs;
+  global_vars = globals;
+  num_global_vars = num_globals;
+  class_info = classes;
+  num_class_info = num_classes;
 }
 
 int __get_class_idx() { return __carv_cur_class_index; }
@@ -342,99 +895,89 @@ static void carved_ptr_postprocessing(int begin_idx, int end_idx) {
   return;
 }
 
-static map<char *, char *> file_save_hash_map;
-static map<char *, unsigned int> file_save_idx_map;
+// Captured input files, each distinct content is saved once.
+static file_store carved_files;
 
 void __carv_file(char *file_name) {
   if (!__carv_opened) {
     return;
   }
 
-  unsigned int file_idx = 0;
-  FILE *target_file = fopen(file_name, "rb");
-  if (target_file == NULL) {
+  int file_idx = carved_files.save(outdir_name, file_name);
+  if (file_idx < 0) {
     return;
   }
 
-  if (file_save_hash_map.find(file_name) == NULL) {
-    char *hash_vec = (char *)malloc(sizeof(char) * 256);
-    memset(hash_vec, 0, sizeof(char) * 256);
-    file_save_hash_map.insert(file_name, hash_vec);
-  }
-
-  // char *hash_vec = *(file_save_hash_map.find(file_name));
-
-  // char file_outdir_name[256];
-  // snprintf(file_outdir_name, 256, "%s/carved_file_%s", outdir_name,
-  // file_name);
-
-  // mkdir(file_outdir_name, 0777);
+  VAR<int> *inputv = new VAR<int>(file_idx, file_name, INPUT_TYPE::INPUTFILE);
+  push_carved_obj((IVAR *)inputv);
+  return;
+}
 
-  // char outfile_name[256];
-  // snprintf(outfile_name, 256, "%s/carved_file_%s/%d", outdir_name, file_name,
-  //          file_idx++);
+// Context records at the __carv_global_begin of the global being carved
+static int global_begin_idx = 0;
+static unsigned int global_begin_spilled = 0;
+static unsigned int global_begin_gen = 0;
 
-  // FILE *outfile = fopen(outfile_name, "wb");
-  // if (outfile == NULL) {
-  //   fclose(target_file);
-  //   return;
-  // }
+// Called before carving epoch tracked global `global_id` at generation
+// `gen`, 0 if it does not have to be carved.
+int __carv_global_begin(int global_id, unsigned int gen) {
+  if (!__carv_opened) {
+    return 0;
+  }
 
-  // char buf[4096];
-  // int read_size;
-  // int hash_val = 0;
-  // while ((read_size = fread(buf, 1, 4096, target_file)) > 0) {
-  //   fwrite(buf, 1, read_size, outfile);
-  //   int idx = 0;
-  //   while (idx < read_size) {
-  //     hash_val += buf[idx++];
-  //     hash_val = hash_val % 256;
-  //   }
-  // }
+  if (!use_global_epochs) {
+    return 1;
+  }
 
-  // fclose(target_file);
-  // fclose(outfile);
+  if (global_snaps.is_current(global_id, gen) &&
+      global_snaps.save(outdir_name, global_id)) {
+    VAR<int> *inputv =
+        new VAR<int>(global_id, 0, (int)gen, INPUT_TYPE::GLOBAL_REF);
+    push_carved_obj((IVAR *)inputv);
+    return 0;
+  }
 
-  // if (hash_vec[hash_val] == 0) {
-  //   hash_vec[hash_val] = 1;
-  // } else {
-  //   unlink(outfile_name);
-  // }
+  global_begin_idx = carved_objs.size();
+  global_begin_spilled = num_spilled;
+  global_begin_gen = gen;
+  return 1;
+}
 
-  unsigned int *file_idx_ptr = file_save_idx_map.find(file_name);
-  if (file_idx_ptr == NULL) {
-    file_save_idx_map.insert(file_name, 0);
-  } else {
-    (*file_idx_ptr)++;
-    file_idx = *file_idx_ptr;
+void __carv_global_end(int global_id) {
+  if (!__carv_opened || !use_global_epochs) {
+    return;
   }
 
-  char outfile_name[256];
-  snprintf(outfile_name, 256, "%s/carved_file_%s_%d", outdir_name, file_name,
-           file_idx);
-
-  FILE *outfile = fopen(outfile_name, "wb");
-  if (outfile == NULL) {
-    fclose(target_file);
+  // Some of its records were spilled already.
+  if (num_spilled != global_begin_spilled) {
     return;
   }
 
-  char buf[4096];
-  int read_size;
-  while ((read_size = fread(buf, 1, 4096, target_file)) > 0) {
-    fwrite(buf, 1, read_size, outfile);
+  char *records = NULL;
+  size_t size = 0;
+  FILE *records_file = open_memstream(&records, &size);
+  if (records_file == NULL) {
+    return;
   }
 
-  fclose(target_file);
-  fclose(outfile);
+  const int num_objs = carved_objs.size();
+  int idx;
+  for (idx = global_begin_idx; idx < num_objs; idx++) {
+    write_carved_obj(records_file, *(carved_objs.get(idx)), false);
+  }
+  fclose(records_file);
 
-  VAR<int> *inputv = new VAR<int>(file_idx, file_name, INPUT_TYPE::INPUTFILE);
-  carved_objs.push_back((IVAR *)inputv);
-  return;
+  global_snaps.set(global_id, global_begin_gen, records, size);
 }
 
 static int num_excluded = 0;
 
+// Number of dense function ids, emitted by the pass.
+extern const int __carv_num_funcs;
+
+// # of carved files of each function, indexed by func_id
+static unsigned int *func_file_counter = NULL;
+
 void __carver_argv_modifier(int *argcptr, char ***argvptr) {
   int argc = (*argcptr) - 1;
   *argcptr = argc;
@@ -466,54 +1009,119 @@ void __carver_argv_modifier(int *argcptr, char ***argvptr) {
 
   // Write argc, argv values, TODO
 
+  func_file_counter = (unsigned int *)calloc(__carv_num_funcs,
+                                             sizeof(unsigned int));
+
+  budget.load_env();
+
+  sample_head = get_sample_env(SAMPLE_HEAD_ENV);
+  sample_tail = get_sample_env(SAMPLE_TAIL_ENV);
+  sample_strided = get_sample_env(SAMPLE_STRIDED_ENV);
+
+  const char *spill_records_str = getenv(SPILL_RECORDS_ENV);
+  if (spill_records_str != NULL) {
+    spill_records = strtoul(spill_records_str, NULL, 0);
+  }
+
+  const char *post_state_str = getenv(POST_STATE_ENV);
+  if ((post_state_str != NULL) && (atoi(post_state_str) != 0)) {
+    post_state = true;
+    if (!dirty_pages.init()) {
+      std::cerr << "Warning: Soft-dirty bits are not available, post-states "
+                   "compare every carved byte\n";
+    }
+  }
+
+  const char *global_epochs_str = getenv(GLOBAL_EPOCHS_ENV);
+  if ((global_epochs_str != NULL) && (atoi(global_epochs_str) != 0)) {
+    use_global_epochs = true;
+  }
+
+  const char *obj_store_str = getenv(OBJ_STORE_ENV);
+  if ((obj_store_str != NULL) && (atoi(obj_store_str) != 0)) {
+    use_obj_store = objects.init(outdir_name);
+    if (!use_obj_store) {
+      std::cerr << "Warning: Failed to create the object store, errno : "
+                << strerror(errno) << "\n";
+    }
+
+    const char *min_records_str = getenv(OBJ_STORE_MIN_RECORDS_ENV);
+    if (min_records_str != NULL) {
+      obj_store_min_records = atoi(min_records_str);
+    }
+  }
+
+  stats.track_ptr_map(&alloced_ptrs);
+  if (!stats.open_live(outdir_name, "func_args")) {
+    std::cerr << "Warning: Failed to open live carving stats, errno : "
+              << strerror(errno) << "\n";
+  }
+
   __carv_ready = true;
   return;
 }
 
 void __carv_FINI() {
   char buffer[256];
+  if (!stats.write_json(outdir_name, "func_args", "function")) {
+    std::cerr << "Warning: Failed to write carving stats, errno : "
+              << strerror(errno) << "\n";
+  }
+  stats.close_live();
+
   free(outdir_name);
+  free(func_file_counter);
+  func_file_counter = NULL;
 
   __carv_ready = false;
 }
 
-static map<const char *, unsigned int> func_file_counter;
-
-void __carv_open(const char *func_name) {
-  fprintf(stderr, "__carv_open called , func_name : %s\n", func_name);
+void __carv_open(const char *func_name, int func_id) {
   if (!__carv_ready) {
     return;
   }
 
-  unsigned int *func_count = func_file_counter.find(func_name);
-  if (func_count != NULL) {
-    if (*func_count > 100) {
-      return;
-    }
+  CARV_PROBE2(open, func_name, func_id);
+
+  stats.set_name(func_id, func_name);
+  stats.on_call(func_id);
+
+  if (func_file_counter[func_id] > 100) {
+    stats.on_skipped(func_id);
+    return;
   }
 
   assert(carved_objs.size() == 0);
   assert(carved_ptrs.size() == 0);
+  budget.reset();
+  num_obj_frames = 0;
+  cur_func_id = func_id;
   __carv_opened = true;
+  stats.begin_traversal(func_id);
   return;
 }
 
 // Count # of objs of each type
-void __carv_close(const char *func_name) {
-  fprintf(stderr, "carv close called , func_name : %s\n", func_name);
+void __carv_close(const char *func_name, int func_id) {
   if (!__carv_ready) {
     return;
   }
 
+  CARV_PROBE2(close, func_name, func_id);
+
   __carv_opened = false;
+  stats.end_traversal();
 
-  if (carved_objs.size() == 0) {
+  if ((carved_objs.size() == 0) && (num_spilled == 0)) {
+    if (post_state) {
+      push_post_ctx(func_id, NULL);
+    }
     return;
   }
 
   int idx = 0;
 
-  const int num_objs = carved_objs.size();
+  const int num_objs = carved_objs.size() + num_spilled;
   const int num_carved_ptrs = carved_ptrs.size();
 
   bool skip_write = false;
@@ -534,40 +1142,33 @@ void __carv_close(const char *func_name) {
   // }
 
   if (skip_write) {
-    idx = 0;
-    while (idx < num_objs) {
-      delete *(carved_objs.get(idx));
-      idx++;
-    }
+    delete_carved_objs();
+    close_spill_file();
 
     num_excluded += 1;
+    stats.on_skipped(func_id);
 
-    carved_objs.clear();
+    if (post_state) {
+      push_post_ctx(func_id, NULL);
+    }
     carved_ptrs.clear();
     return;
   }
 
-  unsigned int cur_cnt = 0;
-  unsigned int *func_count = func_file_counter.find(func_name);
-  if (func_count == NULL) {
-    func_file_counter.insert(func_name, 1);
-    cur_cnt = 1;
-  } else {
-    cur_cnt = *func_count;
-    (*func_count)++;
-  }
+  unsigned long serialize_begin_ns = carv_stats::now_ns();
+
+  unsigned int cur_cnt = ++func_file_counter[func_id];
 
   char outfile_name[256];
   snprintf(outfile_name, 256, "%s/%s_%d", outdir_name, func_name, cur_cnt);
   FILE *outfile = fopen(outfile_name, "w");
 
   if (outfile == NULL) {
-    idx = 0;
-    while (idx < num_objs) {
-      delete *(carved_objs.get(idx));
-      idx++;
+    delete_carved_objs();
+    close_spill_file();
+    if (post_state) {
+      push_post_ctx(func_id, NULL);
     }
-    carved_objs.clear();
     carved_ptrs.clear();
     return;
   }
@@ -582,70 +1183,69 @@ void __carv_close(const char *func_name) {
 
   fprintf(outfile, "####\n");
 
-  idx = 0;
-  while (idx < num_objs) {
-    IVAR *elem = *(carved_objs.get(idx));
-    if (elem->type == INPUT_TYPE::CHAR) {
-      fprintf(outfile, "CHAR:%d\n", (int)(((VAR<char> *)elem)->input));
-    } else if (elem->type == INPUT_TYPE::SHORT) {
-      fprintf(outfile, "SHORT:%d\n", (int)(((VAR<short> *)elem)->input));
-    } else if (elem->type == INPUT_TYPE::INT) {
-      fprintf(outfile, "INT:%d\n", (int)(((VAR<int> *)elem)->input));
-    } else if (elem->type == INPUT_TYPE::LONG) {
-      fprintf(outfile, "LONG:%ld\n", ((VAR<long> *)elem)->input);
-    } else if (elem->type == INPUT_TYPE::LONGLONG) {
-      fprintf(outfile, "LONGLONG:%lld\n", ((VAR<long long> *)elem)->input);
-    } else if (elem->type == INPUT_TYPE::FLOAT) {
-      fprintf(outfile, "FLOAT:%f\n", ((VAR<float> *)elem)->input);
-    } else if (elem->type == INPUT_TYPE::DOUBLE) {
-      fprintf(outfile, "DOUBLE:%lf\n", ((VAR<double> *)elem)->input);
-    } else if (elem->type == INPUT_TYPE::NULLPTR) {
-      fprintf(outfile, "NULLPTR:0\n");
-    } else if (elem->type == INPUT_TYPE::PTR) {
-      VAR<int> *input = (VAR<int> *)elem;
-      fprintf(outfile, "PTR:%d:%d\n", input->input, input->pointer_offset);
-    } else if (elem->type == INPUT_TYPE::FUNCPTR) {
-      VAR<char *> *input = (VAR<char *> *)elem;
-      fprintf(outfile, "FUNCPTR:%s\n", input->input);
-    } else if (elem->type == INPUT_TYPE::UNKNOWN_PTR) {
-      void *addr = ((VAR<void *> *)elem)->input;
-
-      // address might be the end point of carved pointers
-      int carved_idx = 0;
-      int offset;
-      while (carved_idx < num_carved_ptrs) {
-        POINTER *carved_ptr = carved_ptrs.get(carved_idx);
-        char *end_addr = (char *)carved_ptr->addr + carved_ptr->alloc_size;
-        if (end_addr == addr) {
-          offset = carved_ptr->alloc_size;
-          break;
-        }
-        carved_idx++;
-      }
-
-      if (carved_idx == num_carved_ptrs) {
-        fprintf(outfile, "UNKNOWN_PTR:%p\n", ((VAR<void *> *)elem)->input);
+  // Records spilled while the context was walked come first.
+  if (spill_file != NULL) {
+    char *line = NULL;
+    size_t len = 0;
+    rewind(spill_file);
+    while (getline(&line, &len, spill_file) != -1) {
+      if (!strncmp(line, "UNKNOWN_PTR:", 12)) {
+        write_unknown_ptr(outfile, (void *)strtoul(line + 12, NULL, 16));
       } else {
-        fprintf(outfile, "PTR:%d:%d\n", carved_idx, offset);
+        fputs(line, outfile);
       }
-    } else if (elem->type == INPUT_TYPE::OBJ_INFO) {
-      VAR<char *> *input = (VAR<char *> *)elem;
-      fprintf(outfile, "OBJ_INFO:%s:%s\n", elem->name, input->input);
-    } else if (elem->type == INPUT_TYPE::INPUTFILE) {
-      VAR<int> *input = (VAR<int> *)elem;
-      fprintf(outfile, "INPUTFILE:%d:%s\n", input->input, elem->name);
-    } else {
-      std::cerr << "Warning : unknown element type : " << elem->type << ", "
-                << elem->name << "\n";
     }
+    free(line);
+  }
+  close_spill_file();
 
-    delete elem;
+  const int num_mem_objs = carved_objs.size();
+  idx = 0;
+  while (idx < num_mem_objs) {
+    write_carved_obj(outfile, *(carved_objs.get(idx)), false);
     idx++;
   }
 
+  long num_bytes = ftell(outfile);
   fclose(outfile);
-  carved_objs.clear();
+  delete_carved_objs();
+
+  // The body starts right after, take the pre-state of the pointees.
+  if (post_state) {
+    push_post_ctx(func_id, outfile_name);
+  }
   carved_ptrs.clear();
+
+  CARV_PROBE3(dump, func_name, num_objs, num_bytes);
+  stats.on_carved(func_id, num_objs, num_bytes < 0 ? 0 : num_bytes);
+  stats.add_serialize_ns(func_id, carv_stats::now_ns() - serialize_begin_ns);
   return;
 }
+
+// At each return of a carved function, appends the post-state delta of its
+// context. Contexts above it were left by an exception and are dropped.
+void __carv_post_state(int func_id) {
+  if (!post_state) {
+    return;
+  }
+
+  int ctx_idx = num_post_ctxs - 1;
+  while ((ctx_idx >= 0) && (post_ctxs[ctx_idx].func_id != func_id)) {
+    ctx_idx--;
+  }
+  if (ctx_idx < 0) {
+    return;
+  }
+
+  post_ctx *ctx = &post_ctxs[ctx_idx];
+  if (ctx->outfile_name != NULL) {
+    write_post_state(ctx);
+  }
+
+  int idx;
+  for (idx = ctx_idx; idx < num_post_ctxs; idx++) {
+    free_post_ctx(&post_ctxs[idx]);
+  }
+  num_post_ctxs = ctx_idx;
+}
 }
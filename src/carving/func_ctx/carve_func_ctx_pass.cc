@@ -134,9 +134,17 @@ void CarverFCPass::insert_global_carve_probe(Function *F, BasicBlock *BB) {
                       {glob_name_const, gen_new_string_constant(
                                             get_type_str(pointee_type), IRB)});
 
+      // Skipped while the global keeps the generation it was carved at
+      BasicBlock *epoch_tail = insert_global_epoch_begin(glob_iter);
+
       Value *glob_val = IRB->CreateLoad(pointee_type, glob_iter);
       cur_block = insert_carve_probe(glob_val, cur_block);
 
+      if (epoch_tail != NULL) {
+        insert_global_epoch_end(glob_iter, epoch_tail);
+        cur_block = epoch_tail;
+      }
+
       carved_types_file << "**" << glob_name << " : "
                         << get_type_str(pointee_type) << "\n";
     }
@@ -152,6 +160,8 @@ bool CarverFCPass::instrument_module() {
 
   find_global_var_uses();
 
+  instrument_global_epochs();
+
   gen_class_carver();
 
   carved_types_file.open("carved_types.txt");
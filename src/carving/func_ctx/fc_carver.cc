@@ -9,12 +9,18 @@
 #include <fstream>
 #include <iostream>
 
+#include "utils/carv_budget.hpp"
+#include "utils/carv_sdt.hpp"
+#include "utils/carv_stats.hpp"
 #include "utils/data_utils.hpp"
+#include "utils/global_epochs.hpp"
 
 #define MAX_NUM_FILE 8
 #define MINSIZE 3
 #define MAXSIZE 24
 
+#define GLOBAL_EPOCHS_ENV "CARV_GLOBAL_EPOCHS"
+
 static char *outdir_name = NULL;
 
 static int *num_func_calls;
@@ -47,6 +53,12 @@ static vector<POINTER> *cur_carved_ptrs = NULL;
 // static boost::container::map<void *, struct typeinfo> alloced_ptrs;
 map<void *, struct typeinfo> alloced_ptrs;
 
+// Telemetry, written at __carv_FINI
+static carv_stats stats;
+
+// Carving budget of the context being walked, see carv_budget.hpp
+static carv_budget budget;
+
 int __carv_cur_class_index = -1;
 int __carv_cur_class_size = -1;
 
@@ -58,6 +70,37 @@ static map<char *, classinfo> class_info;
 
 static map<void *, char *> vtable_map;
 
+// Global-state epochs, a global carved again at an unchanged generation is
+// recorded as GLOBAL_REF:<snapshot file>, see global_epochs.hpp
+static bool use_global_epochs = false;
+static global_epochs global_snaps;
+
+// Context records at the __carv_global_begin of the global being carved
+static int global_begin_idx = 0;
+static unsigned int global_begin_gen = 0;
+
+// Writes `elem` if it is a plain value, false otherwise.
+static bool write_scalar_obj(FILE *outfile, IVAR *elem) {
+  if (elem->type == INPUT_TYPE::CHAR) {
+    fprintf(outfile, "CHAR:%d\n", (int)(((VAR<char> *)elem)->input));
+  } else if (elem->type == INPUT_TYPE::SHORT) {
+    fprintf(outfile, "SHORT:%d\n", (int)(((VAR<short> *)elem)->input));
+  } else if (elem->type == INPUT_TYPE::INT) {
+    fprintf(outfile, "INT:%d\n", (int)(((VAR<int> *)elem)->input));
+  } else if (elem->type == INPUT_TYPE::LONG) {
+    fprintf(outfile, "LONG:%ld\n", ((VAR<long> *)elem)->input);
+  } else if (elem->type == INPUT_TYPE::LONGLONG) {
+    fprintf(outfile, "LONGLONG:%lld\n", ((VAR<long long> *)elem)->input);
+  } else if (elem->type == INPUT_TYPE::FLOAT) {
+    fprintf(outfile, "FLOAT:%f\n", ((VAR<float> *)elem)->input);
+  } else if (elem->type == INPUT_TYPE::DOUBLE) {
+    fprintf(outfile, "DOUBLE:%lf\n", ((VAR<double> *)elem)->input);
+  } else {
+    return false;
+  }
+  return true;
+}
+
 extern "C" {
 
 void __insert_obj_info(char *name, char *type_name) {
@@ -167,6 +210,18 @@ int Carv_pointer(void *ptr, char *type_name, int default_idx,
     }
   }
 
+  // Pointees are only nested in structs here, so struct depth is used as
+  // the pointer depth.
+  if (!budget.charge(__carve_cur_inputs->size(), __carv_depth,
+                     ptr_alloc_size)) {
+    VAR<void *> *inputv =
+        new VAR<void *>(ptr, type_name, INPUT_TYPE::TRUNCATED);
+    __carve_cur_inputs->push_back((IVAR *)inputv);
+    CARV_PROBE2(truncated, ptr, ptr_alloc_size);
+    stats.on_truncated(inputs.back()->func_id);
+    return 0;
+  }
+
   cur_carved_ptrs->push_back(POINTER(ptr, type_name, ptr_alloc_size));
 
   VAR<int> *inputv = new VAR<int>(new_carved_ptr_index, 0, 0, INPUT_TYPE::PTR);
@@ -272,7 +327,16 @@ void __carv_func_call_probe(int func_id) {
       FUNC_CONTEXT(carved_index++, num_func_calls[func_id], func_id);
   num_func_calls[func_id] += 1;
 
+  // Function name is only known at the return probe
+  CARV_PROBE2(open, 0, func_id);
+
+  stats.on_call(func_id);
+  // Ends at __update_carved_ptr_idx, after the inputs are walked.
+  stats.begin_traversal(func_id);
+
   inputs.push_back(new_ctx);
+  stats.set_depth(inputs.size());
+  budget.reset();
 
   __carve_cur_inputs = &(inputs.back()->inputs);
   cur_carved_ptrs = &(inputs.back()->carved_ptrs);
@@ -280,7 +344,10 @@ void __carv_func_call_probe(int func_id) {
   return;
 }
 
-void __update_carved_ptr_idx() { inputs.back()->update_carved_ptr_begin_idx(); }
+void __update_carved_ptr_idx() {
+  stats.end_traversal();
+  inputs.back()->update_carved_ptr_begin_idx();
+}
 
 static void carved_ptr_postprocessing(int begin_idx, int end_idx) {
   int idx1, idx2, idx3, idx4, idx5;
@@ -442,6 +509,57 @@ void __carv_file(char *file_name) {
   return;
 }
 
+// Called before carving epoch tracked global `global_id` at generation
+// `gen`, 0 if it does not have to be carved.
+int __carv_global_begin(int global_id, unsigned int gen) {
+  if (__carve_cur_inputs == NULL) {
+    return 0;
+  }
+
+  if (!use_global_epochs) {
+    return 1;
+  }
+
+  if (global_snaps.is_current(global_id, gen) &&
+      global_snaps.save(outdir_name, global_id)) {
+    VAR<int> *inputv =
+        new VAR<int>(global_id, 0, (int)gen, INPUT_TYPE::GLOBAL_REF);
+    __carve_cur_inputs->push_back((IVAR *)inputv);
+    return 0;
+  }
+
+  global_begin_idx = __carve_cur_inputs->size();
+  global_begin_gen = gen;
+  return 1;
+}
+
+void __carv_global_end(int global_id) {
+  if ((__carve_cur_inputs == NULL) || !use_global_epochs) {
+    return;
+  }
+
+  char *records = NULL;
+  size_t size = 0;
+  FILE *records_file = open_memstream(&records, &size);
+  if (records_file == NULL) {
+    return;
+  }
+
+  bool is_scalar = true;
+  const int num_inputs = __carve_cur_inputs->size();
+  int idx;
+  for (idx = global_begin_idx; is_scalar && (idx < num_inputs); idx++) {
+    is_scalar = write_scalar_obj(records_file, *(__carve_cur_inputs->get(idx)));
+  }
+  fclose(records_file);
+
+  if (!is_scalar) {
+    free(records);
+    return;
+  }
+  global_snaps.set(global_id, global_begin_gen, records, size);
+}
+
 static int num_excluded = 0;
 
 void __carv_func_ret_probe(char *func_name, int func_id) {
@@ -451,6 +569,7 @@ void __carv_func_ret_probe(char *func_name, int func_id) {
 
   if (__carve_cur_inputs == NULL) {
     inputs.pop_back();
+    stats.set_depth(inputs.size());
 
     class FUNC_CONTEXT *next_ctx = inputs.back();
     if ((next_ctx == NULL) || (!next_ctx->is_carved)) {
@@ -465,10 +584,13 @@ void __carv_func_ret_probe(char *func_name, int func_id) {
     return;
   }
 
-  std::cerr << func_name << " ret_probe called\n";
+  CARV_PROBE2(close, func_name, func_id);
+
+  stats.set_name(func_id, func_name);
 
   class FUNC_CONTEXT *cur_context = inputs.back();
   inputs.pop_back();
+  stats.set_depth(inputs.size());
   int idx = 0;
   const int cur_carving_index = cur_context->carving_index;
   const int cur_func_call_idx = cur_context->func_call_idx;
@@ -536,9 +658,12 @@ void __carv_func_ret_probe(char *func_name, int func_id) {
     }
 
     num_excluded++;
+    stats.on_skipped(func_id);
     return;
   }
 
+  unsigned long serialize_begin_ns = carv_stats::now_ns();
+
   char outfile_name[256];
   snprintf(outfile_name, 256, "%s/%s_%d_%d", outdir_name, func_name,
            cur_carving_index, cur_func_call_idx);
@@ -582,20 +707,8 @@ void __carv_func_ret_probe(char *func_name, int func_id) {
   idx = 0;
   while (idx < num_inputs) {
     IVAR *elem = *(__carve_cur_inputs->get(idx));
-    if (elem->type == INPUT_TYPE::CHAR) {
-      fprintf(outfile, "CHAR:%d\n", (int)(((VAR<char> *)elem)->input));
-    } else if (elem->type == INPUT_TYPE::SHORT) {
-      fprintf(outfile, "SHORT:%d\n", (int)(((VAR<short> *)elem)->input));
-    } else if (elem->type == INPUT_TYPE::INT) {
-      fprintf(outfile, "INT:%d\n", (int)(((VAR<int> *)elem)->input));
-    } else if (elem->type == INPUT_TYPE::LONG) {
-      fprintf(outfile, "LONG:%ld\n", ((VAR<long> *)elem)->input);
-    } else if (elem->type == INPUT_TYPE::LONGLONG) {
-      fprintf(outfile, "LONGLONG:%lld\n", ((VAR<long long> *)elem)->input);
-    } else if (elem->type == INPUT_TYPE::FLOAT) {
-      fprintf(outfile, "FLOAT:%f\n", ((VAR<float> *)elem)->input);
-    } else if (elem->type == INPUT_TYPE::DOUBLE) {
-      fprintf(outfile, "DOUBLE:%lf\n", ((VAR<double> *)elem)->input);
+    if (write_scalar_obj(outfile, elem)) {
+      // Plain value
     } else if (elem->type == INPUT_TYPE::NULLPTR) {
       fprintf(outfile, "NULL:0\n");
     } else if (elem->type == INPUT_TYPE::PTR) {
@@ -631,6 +744,13 @@ void __carv_func_ret_probe(char *func_name, int func_id) {
     } else if (elem->type == INPUT_TYPE::OBJ_INFO) {
       VAR<char *> *input = (VAR<char *> *)elem;
       fprintf(outfile, "OBJ_INFO:%s:%s\n", elem->name, input->input);
+    } else if (elem->type == INPUT_TYPE::TRUNCATED) {
+      fprintf(outfile, "TRUNCATED:0\n");
+    } else if (elem->type == INPUT_TYPE::GLOBAL_REF) {
+      VAR<int> *input = (VAR<int> *)elem;
+      char ref[256];
+      global_snaps.ref_name(ref, 256, input->input, input->pointer_offset);
+      fprintf(outfile, "GLOBAL_REF:%s\n", ref);
     } else if (elem->type == INPUT_TYPE::OFSTREAM) {
       // OFSTREAM:FILENAME:BUFSIZE:CURPOS:PTRIDX
       VAR<char *> *input = (VAR<char *> *)elem;
@@ -708,8 +828,13 @@ void __carv_func_ret_probe(char *func_name, int func_id) {
     idx++;
   }
 
+  long num_bytes = ftell(outfile);
   fclose(outfile);
 
+  CARV_PROBE3(dump, func_name, num_inputs, num_bytes);
+  stats.on_carved(func_id, num_inputs, num_bytes < 0 ? 0 : num_bytes);
+  stats.add_serialize_ns(func_id, carv_stats::now_ns() - serialize_begin_ns);
+
   class FUNC_CONTEXT *next_ctx = inputs.back();
   if ((next_ctx == NULL) || (!next_ctx->is_carved)) {
     __carve_cur_inputs = NULL;
@@ -764,6 +889,18 @@ void __carver_argv_modifier(int *argcptr, char ***argvptr) {
   callseq = (int *)malloc(callseq_size * sizeof(int));
   callseq_index = 0;
 
+  budget.load_env();
+
+  const char *global_epochs_str = getenv(GLOBAL_EPOCHS_ENV);
+  if ((global_epochs_str != NULL) && (atoi(global_epochs_str) != 0)) {
+    use_global_epochs = true;
+  }
+
+  if (!stats.open_live(outdir_name, "func_ctx")) {
+    std::cerr << "Warning: Failed to open live carving stats, errno : "
+              << strerror(errno) << "\n";
+  }
+
   // Write argc, argv values, TODO
 
   __carv_ready0 = true;
@@ -772,6 +909,12 @@ void __carver_argv_modifier(int *argcptr, char ***argvptr) {
 
 void __carv_FINI() {
   char buffer[256];
+  if (!stats.write_json(outdir_name, "func_ctx", "function")) {
+    std::cerr << "Warning: Failed to write carving stats, errno : "
+              << strerror(errno) << "\n";
+  }
+  stats.close_live();
+
   snprintf(buffer, 256, "%s/call_seq", outdir_name);
   FILE *__call_seq_file = fopen(buffer, "w");
   if (__call_seq_file == NULL) {
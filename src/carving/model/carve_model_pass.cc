@@ -7,6 +7,11 @@ static cl::opt<bool> crash_cl("crash",
                               cl::desc("save result at each load instrunction"),
                               cl::init(false));
 
+static cl::opt<bool> lazy_pages_cl(
+    "lazy-pages",
+    cl::desc("carve heap inputs by page on first touch (experimental)"),
+    cl::init(false));
+
 static cl::opt<string> target_cl("target",
                                  cl::desc("target function list file path"));
 
@@ -45,8 +50,9 @@ bool CarverMPass::runOnModule(llvm::Module &M) {
 
   fetch_mem_alloc = Mod->getOrInsertFunction("__fetch_mem_alloc", VoidTy);
 
-  record_func_ptr = Mod->getOrInsertFunction("__record_func_ptr", VoidTy,
-                                             Int8PtrTy, Int8PtrTy);
+  bind_meta = Mod->getOrInsertFunction("__carv_bind_meta", VoidTy, Int8PtrTy,
+                                       Int32Ty, Int8PtrTy, Int32Ty, Int8PtrTy,
+                                       Int32Ty);
 
   argv_modifier = Mod->getOrInsertFunction("__carver_argv_modifier", VoidTy,
                                            Int32PtrTy, Int8PtrPtrPtrTy);
@@ -65,9 +71,6 @@ bool CarverMPass::runOnModule(llvm::Module &M) {
   carv_func_ptr =
       Mod->getOrInsertFunction("__Carv_func_ptr_name", VoidTy, Int8PtrTy);
 
-  keep_class_info = Mod->getOrInsertFunction("__keep_class_info", VoidTy,
-                                             Int8PtrTy, Int32Ty, Int32Ty);
-
   // Constructs global variables to global symbol table.
   global_carve_ready = Mod->getOrInsertGlobal("__carv_ready", Int8Ty);
   global_cur_class_idx =
@@ -75,8 +78,10 @@ bool CarverMPass::runOnModule(llvm::Module &M) {
   global_cur_class_size =
       Mod->getOrInsertGlobal("__carv_cur_class_size", Int32Ty);
 
-  carv_open = Mod->getOrInsertFunction("__carv_open", VoidTy, Int8PtrTy);
-  carv_close = Mod->getOrInsertFunction("__carv_close", VoidTy, Int8PtrTy);
+  carv_open =
+      Mod->getOrInsertFunction("__carv_open", VoidTy, Int8PtrTy, Int32Ty);
+  carv_close =
+      Mod->getOrInsertFunction("__carv_close", VoidTy, Int8PtrTy, Int32Ty);
 
   insert_obj_info = Mod->getOrInsertFunction("__insert_obj_info", VoidTy,
                                              Int8PtrTy, Int8PtrTy);
@@ -93,6 +98,8 @@ bool CarverMPass::runOnModule(llvm::Module &M) {
   mark_addr_probe = Mod->getOrInsertFunction("__carv_mark_address", VoidTy,
                                              Int8PtrTy, Int8Ty);
 
+  protect_inputs = Mod->getOrInsertFunction("__carv_protect_inputs", VoidTy);
+
   instrument_module();
 
   if (!main_instrumented_) {
@@ -146,6 +153,17 @@ bool CarverMPass::instrument_module() {
     instrument_func(&F);
   }
 
+  // Number of dense function ids, sizes the per-function tables of runtime.
+  new llvm::GlobalVariable(*Mod, Int32Ty, true,
+                           llvm::GlobalValue::ExternalLinkage,
+                           llvm::ConstantInt::get(Int32Ty, func_id),
+                           "__carv_num_funcs");
+
+  new llvm::GlobalVariable(
+      *Mod, Int8Ty, true, llvm::GlobalValue::ExternalLinkage,
+      llvm::ConstantInt::get(Int8Ty, lazy_pages_cl.getValue()),
+      "__carv_lazy_pages");
+
   check_and_dump_module();
 
   delete IRB;
@@ -347,7 +365,7 @@ void CarverMPass::instrument_func(llvm::Function *func) {
 
     insert_check_carve_ready();
 
-    IRB->CreateCall(carv_open, {func_name_const});
+    IRB->CreateCall(carv_open, {func_name_const, func_id_const});
 
     unsigned int argidx = 0;
     for (auto &arg_iter : func->args()) {
@@ -364,10 +382,14 @@ void CarverMPass::instrument_func(llvm::Function *func) {
 
     llvm::BasicBlock *insert_block = IRB->GetInsertBlock();
     insert_global_carve_probe(func);
+
+    if (lazy_pages_cl.getValue()) {
+      IRB->CreateCall(protect_inputs, {});
+    }
   }
 
-  // Gather addresses that are used
-  {
+  // Gather addresses that are used, the page faults tell it in lazy mode
+  if (!lazy_pages_cl.getValue()) {
     for (auto load_instr : load_instrs) {
       IRB->SetInsertPoint(load_instr);
       llvm::Value *casted_ptr =
@@ -417,7 +439,7 @@ void CarverMPass::instrument_func(llvm::Function *func) {
   // Probing at return
   for (auto ret_instr : ret_instrs) {
     IRB->SetInsertPoint(ret_instr);
-    IRB->CreateCall(carv_close, {func_name_const});
+    IRB->CreateCall(carv_close, {func_name_const, func_id_const});
     insert_dealloc_probes();
   }
 
@@ -676,65 +698,36 @@ void CarverMPass::instrument_main(llvm::Function *main_func) {
 
   IRB->SetInsertPoint(new_argv_load_instr->getNextNonDebugInstruction());
 
-  auto globals = Mod->global_values();
-  // Global variables memory probing
-  for (auto global_iter = globals.begin(); global_iter != globals.end();
-       global_iter++) {
-    if (!llvm::isa<GlobalVariable>(*global_iter)) {
-      continue;
-    }
-
-    std::string name = global_iter->getName().str();
-    std::string demangled = llvm::demangle(name);
-
-    llvm::GlobalValue *global_v1 = &(*global_iter);
-
-    GlobalVariable *global_v = llvm::dyn_cast<GlobalVariable>(global_v1);
-    if (global_v->getName().str().find("llvm.") != std::string::npos) {
+  // Global variables, function pointers and classes are bound from static
+  // tables at once, instead of one probe call per item.
+  std::vector<llvm::GlobalVariable *> global_vars;
+  for (llvm::GlobalVariable &global_v : Mod->globals()) {
+    if (global_v.getName().str().find("llvm.") != std::string::npos) {
       continue;
     }
-
-    llvm::Value *casted_ptr = IRB->CreateCast(
-        llvm::Instruction::CastOps::BitCast, global_v, Int8PtrTy);
-    llvm::Type *gv_type = global_v->getValueType();
-    unsigned int size = DL->getTypeAllocSize(gv_type);
-
-    llvm::Constant *type_name_const = llvm::Constant::getNullValue(Int8PtrTy);
-
-    if (gv_type->isStructTy() &&
-        llvm::dyn_cast<llvm::StructType>(gv_type)->hasName()) {
-      std::string type_name = gv_type->getStructName().str();
-      type_name_const = gen_new_string_constant(type_name, IRB);
-    }
-
-    llvm::Value *size_const = llvm::ConstantInt::get(Int32Ty, size);
-    IRB->CreateCall(mem_allocated_probe,
-                    {casted_ptr, size_const, type_name_const});
+    global_vars.push_back(&global_v);
   }
 
-  // Record func ptr
+  std::vector<std::pair<llvm::Function *, std::string>> funcs;
   for (auto &Func : Mod->functions()) {
     if (Func.isIntrinsic()) {
       continue;
     }
 
-    const std::string func_name = Func.getName().str();
-    const std::string demangled_name = llvm::demangle(func_name);
-    llvm::Constant *func_name_const =
-        gen_new_string_constant(demangled_name, IRB);
-    llvm::Value *cast_val =
-        IRB->CreateCast(llvm::Instruction::CastOps::BitCast, &Func, Int8PtrTy);
-    IRB->CreateCall(record_func_ptr, {cast_val, func_name_const});
+    funcs.push_back(
+        std::make_pair(&Func, llvm::demangle(Func.getName().str())));
   }
 
-  // Record class llvm::Type string llvm::Constants
-  for (auto iter : class_name_map) {
-    unsigned int class_size = DL->getTypeAllocSize(iter.first);
-    IRB->CreateCall(
-        keep_class_info,
-        {iter.second.second, llvm::ConstantInt::get(Int32Ty, class_size),
-         llvm::ConstantInt::get(Int32Ty, iter.second.first)});
-  }
+  llvm::Constant *global_var_table = gen_global_var_table(global_vars);
+  llvm::Constant *func_ptr_table = gen_func_ptr_table(funcs);
+  llvm::Constant *class_info_table = gen_class_info_table();
+
+  IRB->CreateCall(
+      bind_meta,
+      {func_ptr_table, llvm::ConstantInt::get(Int32Ty, funcs.size()),
+       global_var_table, llvm::ConstantInt::get(Int32Ty, global_vars.size()),
+       class_info_table,
+       llvm::ConstantInt::get(Int32Ty, class_name_map.size())});
 
   for (auto ret_instr : ret_instrs) {
     IRB->SetInsertPoint(ret_instr);
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,7 +14,13 @@
 #include <iostream>
 #include <sstream>
 
+#include "utils/addr_space.hpp"
+#include "utils/carv_budget.hpp"
+#include "utils/carv_sdt.hpp"
+#include "utils/carv_stats.hpp"
 #include "utils/data_utils.hpp"
+#include "utils/file_store.hpp"
+#include "utils/page_tracker.hpp"
 #include "utils/ptr_map.hpp"
 
 #define SHM_ID_ENV "CARVING_SHM_ID"
@@ -29,8 +36,13 @@ static char *outdir_name = NULL;
 
 static int carved_index = 0;
 
-// Function pointer names
-static map<void *, char *> func_ptrs;
+// Static metadata tables emitted by the pass, see __carv_bind_meta
+static func_meta *func_ptrs = NULL;
+static int num_func_ptrs = 0;
+static global_meta *global_vars = NULL;
+static int num_global_vars = 0;
+static class_meta *class_info = NULL;
+static int num_class_info = 0;
 
 // inputs, work as similar as function call stack
 static vector<FUNC_CONTEXT> inputs;
@@ -48,10 +60,22 @@ char *ptr_alloc_shm_map = NULL;
 #define LOCK_SHM_MAP() ((char *)ptr_alloc_shm_map)[4] = 1
 #define UNLOCK_SHM_MAP() ((char *)ptr_alloc_shm_map)[4] = 0
 
+// # of malloc/free events the Pin tool dropped because the map was full
+#define SHM_MAP_DROPPED() ((int *)ptr_alloc_shm_map)[2]
+
 // memory info
 ptr_map alloced_ptrs;
+// Classifies pointers that are not tracked allocations
+static addr_space addr_ranges;
 // map<void *, struct typeinfo> alloced_ptrs;
 
+// Telemetry, written at __carv_FINI
+static carv_stats stats;
+
+// Carving budget of the context being walked, see carv_budget.hpp.
+// Inputs are only walked right after __carv_open, so one is enough.
+static carv_budget budget;
+
 int __carv_cur_class_index = -1;
 int __carv_cur_class_size = -1;
 
@@ -59,14 +83,66 @@ bool __carv_opened = false;
 bool __carv_ready = false;
 char __carv_depth = 0;
 
-static map<char *, classinfo> class_info;
+// Number of dense function ids, emitted by the pass.
+extern "C" const int __carv_num_funcs;
 
-static map<const char *, int *> func_result_hash;
+// Set by the pass with `-lazy-pages`, see page_tracker.hpp. Heap pointees
+// are then not walked; their pages are protected by __carv_protect_inputs
+// and carved on the first touch of the callee.
+extern "C" const char __carv_lazy_pages;
+static page_tracker lazy_pages;
+// Heap pointees of the current context still to be protected
+static vector<void *> lazy_roots;
+// Snapshots of the context being dumped
+static page_tracker::snapshot_range lazy_snaps;
+
+// Per function tables, indexed by func_id
+static unsigned int *func_file_counter = NULL;
+static int **func_result_hash = NULL;
 
 extern "C" {
 
 static void dump_result(const char *func_name, char remove_dup);
 
+static void get_outfile_name(char *outfile_name, FUNC_CONTEXT *ctx) {
+  snprintf(outfile_name, 256, "%s/%s_%u_%u", outdir_name, ctx->func_name,
+           ctx->func_call_idx, ctx->carving_index);
+}
+
+// Crash mode journal. The context file is dumped once on the first read,
+// then every newly read element is appended as a delta line
+//   + p<ptr_idx>[<elem_idx>]
+// which marks `PTR_IDX <elem_idx>` under `PTR_BEGIN <ptr_idx>` as reached.
+// On a normal return __carv_close rewrites the file with the journal folded
+// in, the context of a crashed run is folded by bin/carv-fold.
+static void append_journal(FUNC_CONTEXT *ctx, const char *ptr) {
+  vector<POINTER> *ctx_ptrs = &(ctx->carved_ptrs);
+  const unsigned int num_ptrs = ctx_ptrs->size();
+  unsigned int idx;
+  for (idx = 0; idx < num_ptrs; idx++) {
+    POINTER *carved_ptr = ctx_ptrs->get(idx);
+    char *carved_addr = (char *)carved_ptr->addr;
+    if ((ptr < carved_addr) || (ptr >= carved_addr + carved_ptr->alloc_size)) {
+      continue;
+    }
+
+    // Only element starts are marked as reached, same as dump_result. The
+    // pointees of several carved pointers may overlap, mark them all.
+    int offset = ptr - carved_addr;
+    if ((carved_ptr->elem_size <= 0) || (offset % carved_ptr->elem_size)) {
+      continue;
+    }
+
+    char buf[64];
+    int len = snprintf(buf, 64, "+ p%u[%d]\n", idx,
+                       offset / carved_ptr->elem_size);
+    if (write(ctx->journal_fd, buf, len) != len) {
+      std::cerr << "Error: Failed to write journal, errno : "
+                << strerror(errno) << "\n";
+    }
+  }
+}
+
 void __insert_obj_info(char *name, char *type_name) {
   if (!__carv_opened) {
     return;
@@ -238,39 +314,72 @@ int Carv_pointer(void *ptr, char *type_name, int default_idx,
     return 0;
   }
 
+  char *alloc_ptr = NULL;
+  int ptr_alloc_size = 0;
+  char *name_ptr = NULL;
+
   ptr_map::rbtree_node *ptr_node = alloced_ptrs.find(ptr);
+  global_meta *global_var = NULL;
+  const addr_space::range *ptr_range = nullptr;
+  addr_space::kind ptr_kind = addr_space::UNMAPPED;
   if (ptr_node == NULL) {
-    // We could not found the memory info.
+    ptr_range = addr_ranges.find(ptr);
+    if (ptr_range != nullptr) {
+      ptr_kind = ptr_range->kind_;
+    }
+  }
 
-    auto search = func_ptrs.find(ptr);
-    if (search != NULL) {
-      VAR<char *> *inputv = new VAR<char *>(*search, 0, INPUT_TYPE::FUNCPTR);
-      carved_objs->push_back((IVAR *)inputv);
-      UNLOCK_SHM_MAP();
-      return 0;
+  // Globals are never in the heap or stack mappings nor in the code of a
+  // shared object, and functions only in the text ones. The executable's
+  // own text mapping also holds .rodata when it is linked with
+  // -z noseparate-code.
+  bool maybe_global = (ptr_kind != addr_space::HEAP) &&
+                      (ptr_kind != addr_space::STACK) &&
+                      (ptr_kind != addr_space::SPECIAL) &&
+                      !((ptr_kind == addr_space::TEXT) && ptr_range->is_lib_);
+  if (ptr_node != NULL) {
+    alloc_ptr = (char *)ptr_node->key_;
+    ptr_alloc_size = ptr_node->alloc_size_;
+    name_ptr = ptr_node->type_name_;
+  } else if (maybe_global &&
+             ((global_var = find_global_meta(global_vars, num_global_vars,
+                                             ptr)) != NULL)) {
+    alloc_ptr = (char *)global_var->addr;
+    ptr_alloc_size = global_var->size;
+    name_ptr = global_var->type_name;
+  } else if ((ptr_kind == addr_space::RODATA) &&
+             ((ptr_alloc_size = addr_ranges.rodata_size(
+                   ptr, default_size, !strcmp(type_name, "i8"))) > 0)) {
+    // String literals and other read only data, carved by value.
+    alloc_ptr = (char *)ptr;
+  } else {
+    if ((ptr_kind == addr_space::TEXT) || (ptr_kind == addr_space::UNMAPPED)) {
+      func_meta *search = find_func_meta(func_ptrs, num_func_ptrs, ptr);
+      if (search != NULL) {
+        VAR<char *> *inputv =
+            new VAR<char *>(search->name, 0, INPUT_TYPE::FUNCPTR);
+        carved_objs->push_back((IVAR *)inputv);
+        UNLOCK_SHM_MAP();
+        return 0;
+      }
     }
 
     VAR<void *> *inputv =
         new VAR<void *>(ptr, type_name, INPUT_TYPE::UNKNOWN_PTR);
-
     carved_objs->push_back((IVAR *)inputv);
     UNLOCK_SHM_MAP();
     return 0;
   }
 
-  char *alloc_ptr = (char *)ptr_node->key_;
-  int ptr_alloc_size = ptr_node->alloc_size_;
-
   int new_carved_ptr_index = carved_ptrs->size();
 
   __carv_cur_class_index = default_idx;
   __carv_cur_class_size = default_size;
 
-  char *name_ptr = ptr_node->type_name_;
   if (name_ptr != NULL) {
-    auto search = class_info.find(name_ptr);
+    class_meta *search = find_class_meta(class_info, num_class_info, name_ptr);
     if ((search != NULL) && ((ptr_alloc_size % search->size) == 0)) {
-      __carv_cur_class_index = search->class_index;
+      __carv_cur_class_index = search->index;
       __carv_cur_class_size = search->size;
       type_name = name_ptr;
     }
@@ -285,12 +394,31 @@ int Carv_pointer(void *ptr, char *type_name, int default_idx,
     return 0;
   }
 
+  if (!budget.charge(carved_objs->size(), carved_ptr_index_stack.size(),
+                     ptr_alloc_size)) {
+    VAR<void *> *inputv =
+        new VAR<void *>(ptr, type_name, INPUT_TYPE::TRUNCATED);
+    carved_objs->push_back((IVAR *)inputv);
+    CARV_PROBE2(truncated, ptr, ptr_alloc_size);
+    stats.on_truncated(inputs.back()->func_id);
+    UNLOCK_SHM_MAP();
+    return 0;
+  }
+
   carved_ptrs->push_back(
       POINTER(ptr, type_name, ptr_alloc_size, __carv_cur_class_size));
 
   VAR<int> *inputv = new VAR<int>(new_carved_ptr_index, 0, 0, INPUT_TYPE::PTR);
   carved_objs->push_back((IVAR *)inputv);
 
+  // Heap pointees are carved by page on their first touch instead.
+  if (lazy_pages.enabled() && (ptr_node != NULL) &&
+      (addr_ranges.classify(alloc_ptr) != addr_space::STACK)) {
+    lazy_roots.push_back(alloc_ptr);
+    UNLOCK_SHM_MAP();
+    return 0;
+  }
+
   VAR<int> *inputv2 =
       new VAR<int>(new_carved_ptr_index, 0, INPUT_TYPE::PTR_BEGIN);
   carved_objs->push_back((IVAR *)inputv2);
@@ -308,7 +436,7 @@ void __Carv_func_ptr_name(void *ptr) {
 
   LOCK_SHM_MAP();
 
-  auto search = func_ptrs.find(ptr);
+  func_meta *search = find_func_meta(func_ptrs, num_func_ptrs, ptr);
   if ((ptr == NULL) || (search == NULL)) {
     VAR<void *> *inputv = new VAR<void *>(NULL, NULL, INPUT_TYPE::NULLPTR);
     carved_objs->push_back((IVAR *)inputv);
@@ -316,22 +444,28 @@ void __Carv_func_ptr_name(void *ptr) {
     return;
   }
 
-  VAR<char *> *inputv = new VAR<char *>(*search, NULL, INPUT_TYPE::FUNCPTR);
+  VAR<char *> *inputv =
+      new VAR<char *>(search->name, NULL, INPUT_TYPE::FUNCPTR);
   carved_objs->push_back((IVAR *)inputv);
   UNLOCK_SHM_MAP();
   return;
 }
 
-void __record_func_ptr(void *ptr, char *name) {
+// Bind the static tables of function pointers, global variables and
+// classes emitted by the pass. Sorted once here, then binary searched.
+void __carv_bind_meta(func_meta *funcs, int num_funcs, global_meta *globals,
+                      int num_globals, class_meta *classes, int num_classes) {
   LOCK_SHM_MAP();
-  func_ptrs.insert(ptr, name);
-  UNLOCK_SHM_MAP();
-}
-
-void __keep_class_info(char *class_name, int size, int index) {
-  LOCK_SHM_MAP();
-  classinfo tmp(index, size);
-  class_info.insert(class_name, tmp);
+  sort_func_meta(funcs, num_funcs);
+  sort_global_meta(globals, num_globals);
+  sort_class_meta(classes, num_classes);
+
+  func_ptrs = funcs;
+  num_func_ptrs = num_funcs;
+  global_vars = globals;
+  num_global_vars = num_globals;
+  class_info = classes;
+  num_class_info = num_classes;
   UNLOCK_SHM_MAP();
 }
 
@@ -362,9 +496,22 @@ void __remove_mem_allocated_probe(void *ptr) {
 
 // Fetch memory allocation and deallocation info from Pin tool
 void __fetch_mem_alloc() {
+  static int last_dropped = 0;
+
   int cur_num_entry = ((int *)ptr_alloc_shm_map)[0];
   int idx = 0;
   LOCK_SHM_MAP();
+  stats.end_traversal();
+  stats.set_shm_pending(cur_num_entry);
+
+  CARV_PROBE1(fetch_mem_alloc, cur_num_entry);
+
+  int cur_dropped = SHM_MAP_DROPPED();
+  if (cur_dropped != last_dropped) {
+    CARV_PROBE2(shm_overflow, cur_dropped, cur_dropped - last_dropped);
+    stats.set_dropped_events(cur_dropped);
+    last_dropped = cur_dropped;
+  }
 
   for (idx = 0; idx < cur_num_entry; idx++) {
     shm_entry *entry = &((shm_entry *)ptr_alloc_shm_map)[idx + 1];
@@ -379,8 +526,8 @@ void __fetch_mem_alloc() {
   UNLOCK_SHM_MAP();
 }
 
-static map<char *, char *> file_save_hash_map;
-static map<char *, unsigned int> file_save_idx_map;
+// Captured input files, each distinct content is saved once.
+static file_store carved_files;
 
 void __carv_file(char *file_name) {
   if (!__carv_opened) {
@@ -389,47 +536,12 @@ void __carv_file(char *file_name) {
 
   LOCK_SHM_MAP();
 
-  unsigned int file_idx = 0;
-  FILE *target_file = fopen(file_name, "rb");
-  if (target_file == NULL) {
-    UNLOCK_SHM_MAP();
-    return;
-  }
-
-  if (file_save_hash_map.find(file_name) == NULL) {
-    char *hash_vec = (char *)malloc(sizeof(char) * 256);
-    memset(hash_vec, 0, sizeof(char) * 256);
-    file_save_hash_map.insert(file_name, hash_vec);
-  }
-
-  unsigned int *file_idx_ptr = file_save_idx_map.find(file_name);
-  if (file_idx_ptr == NULL) {
-    file_save_idx_map.insert(file_name, 0);
-  } else {
-    (*file_idx_ptr)++;
-    file_idx = *file_idx_ptr;
-  }
-
-  char outfile_name[256];
-  snprintf(outfile_name, 256, "%s/carved_file_%s_%d", outdir_name, file_name,
-           file_idx);
-
-  FILE *outfile = fopen(outfile_name, "wb");
-  if (outfile == NULL) {
-    fclose(target_file);
+  int file_idx = carved_files.save(outdir_name, file_name);
+  if (file_idx < 0) {
     UNLOCK_SHM_MAP();
     return;
   }
 
-  char buf[4096];
-  int read_size;
-  while ((read_size = fread(buf, 1, 4096, target_file)) > 0) {
-    fwrite(buf, 1, read_size, outfile);
-  }
-
-  fclose(target_file);
-  fclose(outfile);
-
   VAR<int> *inputv = new VAR<int>(file_idx, file_name, INPUT_TYPE::INPUTFILE);
   carved_objs->push_back((IVAR *)inputv);
   UNLOCK_SHM_MAP();
@@ -497,6 +609,23 @@ void __carver_argv_modifier(int *argcptr, char ***argvptr) {
 
   // Write argc, argv values, TODO
 
+  func_file_counter = (unsigned int *)calloc(__carv_num_funcs,
+                                             sizeof(unsigned int));
+  func_result_hash = (int **)calloc(__carv_num_funcs, sizeof(int *));
+
+  budget.load_env();
+
+  if (__carv_lazy_pages && !lazy_pages.init()) {
+    std::cerr << "Warning: Failed to install the page fault handler, inputs "
+                 "are walked eagerly\n";
+  }
+
+  stats.track_ptr_map(&alloced_ptrs);
+  if (!stats.open_live(outdir_name, "model")) {
+    std::cerr << "Warning: Failed to open live carving stats, errno : "
+              << strerror(errno) << "\n";
+  }
+
   __carv_ready = true;
   UNLOCK_SHM_MAP();
   return;
@@ -504,41 +633,49 @@ void __carver_argv_modifier(int *argcptr, char ***argvptr) {
 
 void __carv_FINI() {
   char buffer[256];
+  LOCK_SHM_MAP();
+  stats.set_dropped_events(SHM_MAP_DROPPED());
+  if (!stats.write_json(outdir_name, "model", "function")) {
+    std::cerr << "Warning: Failed to write carving stats, errno : "
+              << strerror(errno) << "\n";
+  }
+  stats.close_live();
+  UNLOCK_SHM_MAP();
+
   free(outdir_name);
 
   int idx = 0;
-  int num_hash_objs = func_result_hash.size();
-  for (idx = 0; idx < num_hash_objs; idx++) {
-    auto search = func_result_hash.get_by_idx(idx);
-    int *hash_ptr = search->elem;
-    free(hash_ptr);
+  for (idx = 0; idx < __carv_num_funcs; idx++) {
+    free(func_result_hash[idx]);
   }
+  free(func_result_hash);
+  func_result_hash = NULL;
+
+  free(func_file_counter);
+  func_file_counter = NULL;
 
   __carv_ready = false;
 }
 
-static map<const char *, unsigned int> func_file_counter;
-
-void __carv_open(const char *func_name) {
+void __carv_open(const char *func_name, int func_id) {
   if (!__carv_ready) {
     return;
   }
 
   LOCK_SHM_MAP();
 
-  unsigned int cur_cnt = 0;
-  unsigned int *func_count = func_file_counter.find(func_name);
-  if (func_count == NULL) {
-    func_file_counter.insert(func_name, 1);
-    cur_cnt = 1;
-  } else {
-    cur_cnt = *func_count;
-    (*func_count)++;
-  }
+  CARV_PROBE2(open, func_name, func_id);
+
+  stats.set_name(func_id, func_name);
+  stats.on_call(func_id);
+
+  unsigned int cur_cnt = ++func_file_counter[func_id];
 
   FUNC_CONTEXT new_ctx = FUNC_CONTEXT(carved_index++, cur_cnt, func_name);
+  new_ctx.func_id = func_id;
 
   inputs.push_back(new_ctx);
+  stats.set_depth(inputs.size());
 
   carved_objs = &(inputs.back()->inputs);
   carved_ptrs = &(inputs.back()->carved_ptrs);
@@ -546,11 +683,83 @@ void __carv_open(const char *func_name) {
 
   assert(carved_objs->size() == 0);
   assert(carved_ptrs->size() == 0);
+  budget.reset();
+
+  lazy_pages.open_context();
+  lazy_roots.clear();
+
+  // The walk over the inputs ends at the first event from the body.
+  stats.begin_traversal(func_id);
   UNLOCK_SHM_MAP();
   return;
 }
 
+// End of the input walk in lazy page mode. Protects the pages of every
+// heap object reachable from the carved pointers, found by a conservative
+// scan of their words for addresses of tracked allocations.
+void __carv_protect_inputs() {
+  if (!__carv_opened || !lazy_pages.enabled()) {
+    return;
+  }
+
+  LOCK_SHM_MAP();
+  stats.end_traversal();
+
+  // Read everything first, protected pages would fault on the scan.
+  map<void *, char> scanned;
+  vector<void *> objs;
+  unsigned int idx;
+  for (idx = 0; idx < lazy_roots.size(); idx++) {
+    void *root = *(lazy_roots.get(idx));
+    if (scanned.find(root) == NULL) {
+      scanned.insert(root, 1);
+      objs.push_back(root);
+    }
+  }
+
+  const unsigned int num_roots = objs.size();
+  for (idx = 0; idx < objs.size(); idx++) {
+    ptr_map::rbtree_node *obj_node = alloced_ptrs.find(*(objs.get(idx)));
+    if (obj_node == NULL) {
+      continue;
+    }
+
+    void **words = (void **)obj_node->key_;
+    int num_words = obj_node->alloc_size_ / sizeof(void *);
+    int word_idx;
+    for (word_idx = 0; word_idx < num_words; word_idx++) {
+      ptr_map::rbtree_node *pointee = alloced_ptrs.find(words[word_idx]);
+      if ((pointee == NULL) || (scanned.find(pointee->key_) != NULL)) {
+        continue;
+      }
+      scanned.insert(pointee->key_, 1);
+      if (addr_ranges.classify(pointee->key_) != addr_space::STACK) {
+        objs.push_back(pointee->key_);
+      }
+    }
+  }
+
+  // Objects found by the scan join the pointer table as raw bytes, so their
+  // pages can be mapped back to an object at replay.
+  for (idx = 0; idx < objs.size(); idx++) {
+    ptr_map::rbtree_node *obj_node = alloced_ptrs.find(*(objs.get(idx)));
+    if (obj_node == NULL) {
+      continue;
+    }
+    lazy_pages.protect(obj_node->key_, obj_node->alloc_size_);
+    if (idx >= num_roots) {
+      carved_ptrs->push_back(
+          POINTER(obj_node->key_, "i8", obj_node->alloc_size_, 1));
+    }
+  }
+
+  lazy_roots.clear();
+  UNLOCK_SHM_MAP();
+}
+
 void __carv_mark_address(const char *ptr, const char is_crash) {
+  stats.end_traversal();
+
   if (carved_ptrs == nullptr) {
     return;
   }
@@ -578,27 +787,56 @@ void __carv_mark_address(const char *ptr, const char is_crash) {
 
   used_ptrs->push_back((void *)ptr);
 
-  UNLOCK_SHM_MAP();
+  if (!is_crash) {
+    UNLOCK_SHM_MAP();
+    return;
+  }
 
-  if (is_crash) {
-    dump_result(inputs.back()->func_name, 0);
+  class FUNC_CONTEXT *cur_context = inputs.back();
+  if (cur_context->journal_fd >= 0) {
+    append_journal(cur_context, ptr);
+    UNLOCK_SHM_MAP();
+    return;
   }
 
+  UNLOCK_SHM_MAP();
+
+  // First read in this context, dump it once and journal the rest.
+  dump_result(cur_context->func_name, 0);
+
+  LOCK_SHM_MAP();
+  char outfile_name[256];
+  get_outfile_name(outfile_name, cur_context);
+  cur_context->journal_fd = open(outfile_name, O_WRONLY | O_APPEND);
+  UNLOCK_SHM_MAP();
   return;
 }
 
 // Count # of objs of each type
-void __carv_close(const char *func_name) {
+void __carv_close(const char *func_name, int func_id) {
   if (!__carv_ready) {
     return;
   }
 
   LOCK_SHM_MAP();
+  stats.end_traversal();
+
+  CARV_PROBE2(close, func_name, func_id);
+
+  lazy_snaps = lazy_pages.close_context();
+
+  class FUNC_CONTEXT *cur_context = inputs.back();
+  if ((cur_context != NULL) && (cur_context->journal_fd >= 0)) {
+    close(cur_context->journal_fd);
+    cur_context->journal_fd = -1;
+  }
 
   if (!(carved_objs == NULL || (carved_objs->size() == 0))) {
     UNLOCK_SHM_MAP();
     dump_result(func_name, 1);
     LOCK_SHM_MAP();
+  } else {
+    stats.on_skipped(func_id);
   }
 
   if (carved_objs != NULL) {
@@ -613,6 +851,7 @@ void __carv_close(const char *func_name) {
   }
 
   inputs.pop_back();
+  stats.set_depth(inputs.size());
 
   class FUNC_CONTEXT *next_ctx = inputs.back();
   if ((next_ctx == NULL) || (!next_ctx->is_carved)) {
@@ -631,8 +870,6 @@ static void dump_result(const char *func_name, char remove_dup) {
   LOCK_SHM_MAP();
 
   class FUNC_CONTEXT *cur_context = inputs.back();
-  const unsigned int cur_carving_index = cur_context->carving_index;
-  const unsigned int cur_func_call_idx = cur_context->func_call_idx;
 
   if (func_name != cur_context->func_name) {
     std::cerr << "Error: Returning func_name != cur_context->func_name\n";
@@ -645,17 +882,16 @@ static void dump_result(const char *func_name, char remove_dup) {
   const unsigned num_objs = carved_objs->size();
   const unsigned int num_carved_ptrs = carved_ptrs->size();
 
-  int **hash_ptr = func_result_hash.find(func_name);
+  unsigned long serialize_begin_ns = carv_stats::now_ns();
+
+  int **hash_ptr = &func_result_hash[cur_context->func_id];
 
-  if (hash_ptr == nullptr) {
-    int *res_hash = (int *)malloc(sizeof(int) * HASH_MAX_NUM_FILE);
-    memset(res_hash, 0, sizeof(int) * HASH_MAX_NUM_FILE);
-    func_result_hash.insert(func_name, res_hash);
+  if (*hash_ptr == nullptr) {
+    *hash_ptr = (int *)calloc(HASH_MAX_NUM_FILE, sizeof(int));
   }
 
   char outfile_name[256];
-  snprintf(outfile_name, 256, "%s/%s_%u_%u", outdir_name, func_name,
-           cur_func_call_idx, cur_carving_index);
+  get_outfile_name(outfile_name, cur_context);
 
   std::ofstream outfile(outfile_name);
 
@@ -746,6 +982,8 @@ static void dump_result(const char *func_name, char remove_dup) {
         ss << "func" << ' ' << input->input;
       } else if (elem->type == INPUT_TYPE::UNKNOWN_PTR) {
         ss << elem->name << ' ' << "?";
+      } else if (elem->type == INPUT_TYPE::TRUNCATED) {
+        ss << elem->name << ' ' << "truncated";
       } else if (elem->type == INPUT_TYPE::PTR_IDX) {
         VAR<int> *input = (VAR<int> *)elem;
 
@@ -771,8 +1009,44 @@ static void dump_result(const char *func_name, char remove_dup) {
     outfile.flush();
   }
 
+  // Lazy page mode, the pointer table and the pages touched by the callee
+  if (lazy_pages.enabled()) {
+    for (unsigned int idx = 0; idx < num_carved_ptrs; idx++) {
+      POINTER *carved_ptr = carved_ptrs->get(idx);
+      std::stringstream ss;
+      ss << "PTR_ADDR p" << idx << ' ' << carved_ptr->addr << ' '
+         << carved_ptr->alloc_size;
+      format_with_indent(ss.str(), false);
+    }
+
+    const unsigned long page_size = lazy_pages.page_size();
+    static const char hex_digits[] = "0123456789abcdef";
+    std::string page_hex(page_size * 2, '0');
+    for (unsigned long idx = lazy_snaps.begin_; idx < lazy_snaps.end_; idx++) {
+      unsigned long page = 0;
+      const char *data = lazy_pages.get_snapshot(lazy_snaps, idx, &page);
+      if (data == NULL) {
+        continue;
+      }
+
+      for (unsigned long byte_idx = 0; byte_idx < page_size; byte_idx++) {
+        unsigned char byte = data[byte_idx];
+        page_hex[2 * byte_idx] = hex_digits[byte >> 4];
+        page_hex[2 * byte_idx + 1] = hex_digits[byte & 0xf];
+      }
+
+      std::stringstream ss;
+      ss << "PAGE " << (void *)page << ' ' << page_hex;
+      format_with_indent(ss.str(), true);
+    }
+    outfile.flush();
+  }
+
+  long num_bytes = outfile.tellp();
   outfile.close();
 
+  CARV_PROBE3(dump, func_name, num_objs, num_bytes);
+
   /*
   fprintf(outfile, "####################\n");
 
@@ -942,7 +1216,7 @@ static void dump_result(const char *func_name, char remove_dup) {
 
   // compute hash and remove duplicates
   if (remove_dup) {
-    int *res_hash = *(func_result_hash.find(func_name));
+    int *res_hash = *hash_ptr;
     int hash_val = 0;
     FILE *hashfile = fopen(outfile_name, "rb");
     if (hashfile == NULL) {
@@ -965,11 +1239,17 @@ static void dump_result(const char *func_name, char remove_dup) {
 
     if (res_hash[hash_val] == 0) {
       res_hash[hash_val] = 1;
+      stats.on_carved(cur_context->func_id, num_objs,
+                      num_bytes < 0 ? 0 : num_bytes);
     } else {
       unlink(outfile_name);
+      stats.on_deduped(cur_context->func_id);
     }
   }
 
+  stats.add_serialize_ns(cur_context->func_id,
+                         carv_stats::now_ns() - serialize_begin_ns);
+
   UNLOCK_SHM_MAP();
   return;
 }
@@ -73,6 +73,8 @@ class type_carver_pass : public ModulePass {
 
   std::set<Type *> target_types;
   std::string target_type_name;
+  // Dense id of target_type_name, indexes the per-type tables of runtime
+  const int target_type_id = 0;
 };
 
 }  // namespace
@@ -216,7 +218,9 @@ bool type_carver_pass::instrument_module() {
         Constant *type_name_const =
             gen_new_string_constant(target_type_name, IRB);
         Constant *func_name_const = gen_new_string_constant(func_name, IRB);
-        IRB->CreateCall(carv_close, {type_name_const, func_name_const});
+        IRB->CreateCall(carv_close, {type_name_const,
+                                     ConstantInt::get(Int32Ty, target_type_id),
+                                     func_name_const});
 
         num_inserted++;
         break;
@@ -9,6 +9,8 @@
 
 #include <iostream>
 
+#include "utils/carv_sdt.hpp"
+#include "utils/carv_stats.hpp"
 #include "utils/data_utils.hpp"
 
 #define MAX_NUM_FILE 8
@@ -26,6 +28,8 @@ static int **func_carved_filesize;
 
 static int num_type_carved;
 static int **type_carved_inputssize;
+// # of carved files of each type, indexed by type_id
+static unsigned int *type_counter;
 
 static int *callseq;
 static int callseq_size;
@@ -53,6 +57,10 @@ map<void *, struct typeinfo> alloced_ptrs;
 static vector<char *> __carv_base_names;
 static vector<bool> __need_to_free_carv_base_names;
 
+// Telemetry, written at __carv_FINI. Units are carved types.
+static carv_stats stats;
+static unsigned long traversal_begin_ns = 0;
+
 int __carv_cur_class_index = -1;
 int __carv_cur_class_size = -1;
 
@@ -755,11 +763,17 @@ void __carver_argv_modifier(int *argcptr, char ***argvptr) {
 
   num_type_carved = 2048;
   type_carved_inputssize = (int **)calloc(num_type_carved, sizeof(int *));
+  type_counter = (unsigned int *)calloc(num_type_carved, sizeof(unsigned int));
 
   callseq_size = 16384;
   callseq = (int *)malloc(callseq_size * sizeof(int));
   callseq_index = 0;
 
+  if (!stats.open_live(outdir_name, "type_based")) {
+    std::cerr << "Warning: Failed to open live carving stats, errno : "
+              << strerror(errno) << "\n";
+  }
+
   // Write argc, argv values, TODO
 
   __carv_ready0 = true;
@@ -768,6 +782,12 @@ void __carver_argv_modifier(int *argcptr, char ***argvptr) {
 
 void __carv_FINI() {
   char buffer[256];
+  if (!stats.write_json(outdir_name, "type_based", "type")) {
+    std::cerr << "Warning: Failed to write carving stats, errno : "
+              << strerror(errno) << "\n";
+  }
+  stats.close_live();
+
   snprintf(buffer, 256, "%s/call_seq", outdir_name);
   FILE *__call_seq_file = fopen(buffer, "w");
   if (__call_seq_file == NULL) {
@@ -788,6 +808,7 @@ void __carv_FINI() {
     free(type_carved_inputssize[idx]);
   }
   free(type_carved_inputssize);
+  free(type_counter);
   free(outdir_name);
 
   __carv_ready = false;
@@ -799,7 +820,9 @@ void __carv_open() {
     return;
   }
 
-  std::cerr << "__carv open called\n";
+  CARV_PROBE0(open);
+
+  traversal_begin_ns = carv_stats::now_ns();
 
   FUNC_CONTEXT new_ctx = FUNC_CONTEXT(carved_index++, 0, 0);
   inputs.push_back(new_ctx);
@@ -808,15 +831,15 @@ void __carv_open() {
   return;
 }
 
-static map<const char *, unsigned int> type_counter;
-static map<const char *, unsigned int> type_idx;
-static unsigned int max_type_idx = 0;
-
-void __carv_close(const char *type_name, const char *func_name) {
+void __carv_close(const char *type_name, int type_id, const char *func_name) {
   if (__carve_cur_inputs == NULL) {
     return;
   }
 
+  unsigned long traversal_end_ns = carv_stats::now_ns();
+
+  CARV_PROBE2(close, type_name, type_id);
+
   FUNC_CONTEXT *cur_context = inputs.back();
   inputs.pop_back();
 
@@ -826,17 +849,28 @@ void __carv_close(const char *type_name, const char *func_name) {
 
   bool skip_write = false;
 
-  unsigned int cur_type_idx = 0;
+  const unsigned int cur_type_idx = type_id;
 
-  unsigned int *type_idx_ptr =
-      type_idx.find(type_name);  // type_idx[type_name];
-  if (type_idx_ptr == NULL) {
-    cur_type_idx = max_type_idx;
-    type_idx.insert(type_name, max_type_idx++);
-  } else {
-    cur_type_idx = *type_idx_ptr;
+  if (cur_type_idx >= num_type_carved) {
+    int tmp = num_type_carved;
+    while (cur_type_idx >= num_type_carved) {
+      num_type_carved *= 2;
+    }
+
+    type_carved_inputssize = (int **)realloc(type_carved_inputssize,
+                                             sizeof(int *) * num_type_carved);
+    memset(type_carved_inputssize + tmp, 0,
+           sizeof(int *) * (num_type_carved - tmp));
+    type_counter = (unsigned int *)realloc(
+        type_counter, sizeof(unsigned int) * num_type_carved);
+    memset(type_counter + tmp, 0,
+           sizeof(unsigned int) * (num_type_carved - tmp));
   }
 
+  stats.set_name(type_id, type_name);
+  stats.on_call(type_id);
+  stats.add_traversal_ns(type_id, traversal_end_ns - traversal_begin_ns);
+
   if (num_inputs <= (1 << MINSIZE)) {
     skip_write = true;
   } else {
@@ -847,18 +881,6 @@ void __carv_close(const char *type_name, const char *func_name) {
       index += 1;
     }
 
-    if (cur_type_idx >= num_type_carved) {
-      int tmp = num_type_carved;
-      while (cur_type_idx >= num_type_carved) {
-        num_type_carved *= 2;
-      }
-
-      type_carved_inputssize = (int **)realloc(type_carved_inputssize,
-                                               sizeof(int *) * num_type_carved);
-      memset(type_carved_inputssize + tmp, 0,
-             sizeof(int *) * (num_type_carved - tmp));
-    }
-
     if (type_carved_inputssize[cur_type_idx] == 0) {
       type_carved_inputssize[cur_type_idx] =
           (int *)calloc(MAXSIZE - MINSIZE + 1, sizeof(int));
@@ -879,21 +901,15 @@ void __carv_close(const char *type_name, const char *func_name) {
     }
 
     num_excluded += 1;
+    stats.on_skipped(type_id);
     return;
   }
 
-  unsigned int *type_count =
-      type_counter.find(type_name);  // type_counter[type_name];
-  if (type_count == NULL) {
-    type_counter.insert(type_name, 1);
-    type_count = type_counter.find(type_name);  // type_counter[type_name];
-  } else {
-    (*type_count)++;
-  }
+  unsigned int type_count = ++type_counter[cur_type_idx];
 
   char outfile_name[256];
   snprintf(outfile_name, 256, "%s/%s_%d_%s", outdir_name, type_name,
-           (*type_count), func_name);
+           type_count, func_name);
   FILE *outfile = fopen(outfile_name, "w");
 
   if (outfile == NULL) {
@@ -981,7 +997,12 @@ void __carv_close(const char *type_name, const char *func_name) {
     idx++;
   }
 
+  long num_bytes = ftell(outfile);
   fclose(outfile);
+
+  CARV_PROBE3(dump, type_name, num_inputs, num_bytes);
+  stats.on_carved(type_id, num_inputs, num_bytes < 0 ? 0 : num_bytes);
+  stats.add_serialize_ns(type_id, carv_stats::now_ns() - traversal_end_ns);
   return;
 }
 }
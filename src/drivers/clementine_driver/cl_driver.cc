@@ -1,71 +1,32 @@
 #include <assert.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <cstring>
-#include <fstream>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <vector>
 
+#include "utils/carved_reader.hpp"
+#include "utils/dir_index.hpp"
+#include "utils/file_store.hpp"
+#include "utils/fork_server.hpp"
+#include "utils/name_index.hpp"
+#include "utils/ptr_bitset.hpp"
+
 using namespace std;
 
 int __cur_target_func_idx;
 
-static int filename_cmp(const void *l, const void *r) {
-  return strcmp((const char *)l, (const char *)r);
-}
-
-class classinfo {
- public:
-  int class_index;
-  int size;
-
-  classinfo(int class_index, int size) {
-    this->class_index = class_index;
-    this->size = size;
-  }
-
-  classinfo() {
-    this->class_index = 0;
-    this->size = 0;
-  }
-
-  classinfo(int) {
-    class_index = 0;
-    size = 0;
-  }
-
-  classinfo(const classinfo &other) {
-    class_index = other.class_index;
-    size = other.size;
-  }
-
-  classinfo(classinfo &&other) {
-    class_index = other.class_index;
-    size = other.size;
-    other.class_index = 0;
-    other.size = 0;
-  }
-
-  classinfo &operator=(const classinfo &other) {
-    class_index = other.class_index;
-    size = other.size;
-    return *this;
-  }
-
-  classinfo &operator=(classinfo &&other) {
-    class_index = other.class_index;
-    size = other.size;
-    other.class_index = 0;
-    other.size = 0;
-    return *this;
-  }
-};
+// Directories replay files are selected from
+static dir_index replay_dirs;
 
 enum INPUT_TYPE {
   CHAR,
@@ -80,7 +41,9 @@ enum INPUT_TYPE {
   NULLPTR,
   FUNCPTR,
   VTABLE_PTR,
-  UNKNOWN_PTR
+  UNKNOWN_PTR,
+  TRUNCATED,
+  SKIPPED
 };
 
 class POINTER {
@@ -156,10 +119,35 @@ class VAR : public IVAR {
 
 extern "C" {
 
-map<char *, classinfo> __replay_class_info;
+// Entries of the static tables that ClementinePass emits into the
+// `carv_meta` section, bound by __driver_bind_meta.
+typedef struct func_meta_ {
+  void *addr;
+  char *name;
+} func_meta;
+
+typedef struct class_meta_ {
+  char *class_name;
+  int size;
+  int index;
+} class_meta;
+
+// Indexed by name, replay looks them up by the carved names.
+static class_meta *__replay_class_info = NULL;
+static name_index __replay_class_names;
 
-// Function pointer names
-static map<void *, char *> __replay_func_ptrs;
+static func_meta *__replay_func_ptrs = NULL;
+static name_index __replay_func_names;
+
+static func_meta *find_func_meta(char *name) {
+  int idx = __replay_func_names.find(name);
+  return idx < 0 ? NULL : &__replay_func_ptrs[idx];
+}
+
+static class_meta *find_class_meta(const char *class_name) {
+  int idx = __replay_class_names.find(class_name);
+  return idx < 0 ? NULL : &__replay_class_info[idx];
+}
 
 IVAR **__replay_inputs = NULL;
 unsigned int __replay_inputs_size = 0;
@@ -167,15 +155,11 @@ unsigned int __replay_inputs_capacity = 0;
 
 vector<POINTER> __replay_carved_ptrs;
 
-IVAR **__replay_default_inputs = NULL;
-unsigned int __replay_default_inputs_size = 0;
-unsigned int __replay_default_inputs_capacity = 0;
-
 vector<POINTER> __replay_default_carved_ptrs;
 
-// adhoc to make a set
-map<int, char> __replay_replayed_ptr;
-map<int, char> __replay_default_replayed_ptr;
+// Pointer table indexes whose pointee is replayed
+static ptr_bitset __replay_replayed_ptr;
+static ptr_bitset __replay_default_replayed_ptr;
 
 char *__carved_obj_dir = NULL;
 
@@ -195,104 +179,93 @@ void __driver_input_argv_modifier(int *argcptr, char ***argvptr) {
   (*argvptr)[argc] = 0;
 }
 
-static char **__tc_dir_names = NULL;
-static unsigned int __num_tc_dirs = 0;
+// Called by main once the driver is set up. With REPLAY_FORK_SERVER=1 only
+// the forked children return, each replaying from the carved object
+// directory it was sent in place of the one given on the command line, see
+// fork_server.hpp. The arguments of the target program are left alone.
+void __driver_fork_server(int *argcptr, char ***argvptr) {
+  char *request = fork_server_run();
+  if (request == NULL) {
+    return;
+  }
+
+  __carved_obj_dir = request;
+}
+
 static char *__cl_target_func_name = NULL;
 static char *__default_tc_dir_name = NULL;
 static char *__default_tc_file_name = NULL;
 
 void __driver_select_default_file(unsigned int tc_id, unsigned int carv_id) {
-  DIR *dir = opendir(__carved_obj_dir);
-  if (dir == NULL) {
+  char **tc_dir_names;
+  int num_tc_dirs = replay_dirs.get(__carved_obj_dir, DT_DIR, &tc_dir_names);
+  if (num_tc_dirs < 0) {
     return;
   }
 
-  struct dirent *ent;
-  while ((ent = readdir(dir)) != NULL) {
-    if (ent->d_type == DT_DIR) {
-      __num_tc_dirs++;
-    }
-  }
-
-  if (__num_tc_dirs == 0) {
+  if (num_tc_dirs == 0) {
     fprintf(stderr, "Replay error : No dirs in directory : %s\n",
             __carved_obj_dir);
     return;
   }
 
-  char **__tc_dir_names = (char **)malloc(sizeof(char *) * __num_tc_dirs);
-
-  rewinddir(dir);
-
-  int dir_idx = 0;
-  while ((ent = readdir(dir)) != NULL) {
-    if (ent->d_type == DT_DIR) {
-      __tc_dir_names[dir_idx++] = strdup(ent->d_name);
-    }
-  }
-
-  qsort(__tc_dir_names, __num_tc_dirs, sizeof(char *), filename_cmp);
-
-  int sel_dir_idx = tc_id % __num_tc_dirs;
+  int sel_dir_idx = tc_id % num_tc_dirs;
 
+  free(__default_tc_dir_name);
   __default_tc_dir_name = (char *)malloc(
-      strlen(__carved_obj_dir) + strlen(__tc_dir_names[sel_dir_idx]) + 2);
+      strlen(__carved_obj_dir) + strlen(tc_dir_names[sel_dir_idx]) + 2);
 
   sprintf(__default_tc_dir_name, "%s/%s", __carved_obj_dir,
-          __tc_dir_names[sel_dir_idx]);
-  closedir(dir);
+          tc_dir_names[sel_dir_idx]);
 
   if (__cl_target_func_name == NULL) {
     return;
   }
 
-  dir = opendir(__default_tc_dir_name);
-  if (dir == NULL) {
+  char **file_names;
+  int num_files = replay_dirs.get(__default_tc_dir_name, DT_REG, &file_names);
+  if (num_files < 0) {
     return;
   }
 
-  char **__target_func_files = (char **)malloc(sizeof(char *) * 16);
-  unsigned int __target_func_files_capacity = 16;
-  unsigned int __num_target_func_files = 0;
-
-  while ((ent = readdir(dir)) != NULL) {
-    if (ent->d_type != DT_REG) {
-      continue;
-    }
-
-    char *file_name = ent->d_name;
-    if (strstr(file_name, __cl_target_func_name) != NULL) {
-      if (__num_target_func_files >= __target_func_files_capacity) {
-        __target_func_files_capacity *= 2;
-        __target_func_files = (char **)realloc(
-            __target_func_files, sizeof(char *) * __target_func_files_capacity);
-      }
-
-      __target_func_files[__num_target_func_files++] = strdup(file_name);
+  unsigned int num_target_func_files = 0;
+  int file_idx;
+  for (file_idx = 0; file_idx < num_files; file_idx++) {
+    if (strstr(file_names[file_idx], __cl_target_func_name) != NULL) {
+      num_target_func_files++;
     }
   }
 
-  if (__num_target_func_files == 0) {
+  if (num_target_func_files == 0) {
     fprintf(stderr,
             "Replay error : No files for function %s in directory : %s\n",
             __cl_target_func_name, __default_tc_dir_name);
     return;
   }
 
-  char *__target_func_file_name =
-      __target_func_files[carv_id % __num_target_func_files];
+  // The selected one among the files of the target function, in name order
+  unsigned int sel_target_idx = carv_id % num_target_func_files;
+  char *target_func_file_name = NULL;
+  for (file_idx = 0; file_idx < num_files; file_idx++) {
+    if (strstr(file_names[file_idx], __cl_target_func_name) == NULL) {
+      continue;
+    }
+    if (sel_target_idx-- == 0) {
+      target_func_file_name = file_names[file_idx];
+      break;
+    }
+  }
 
+  free(__default_tc_file_name);
   __default_tc_file_name = (char *)malloc(strlen(__default_tc_dir_name) +
-                                          strlen(__target_func_file_name) + 2);
+                                          strlen(target_func_file_name) + 2);
 
-  snprintf(__default_tc_file_name,
-           strlen(__default_tc_dir_name) + strlen(__target_func_file_name) + 2,
-           "%s/%s", __default_tc_dir_name, __target_func_file_name);
+  sprintf(__default_tc_file_name, "%s/%s", __default_tc_dir_name,
+          target_func_file_name);
 
   std::cerr << "Got default tc file : " << __default_tc_file_name << "\n";
 
-  FILE *input_fp = fopen(__default_tc_file_name, "r");
-  if (input_fp == NULL) {
+  if (access(__default_tc_file_name, R_OK) != 0) {
     std::cerr << "Can't read input file : " << __default_tc_file_name << "\n";
     return;
   }
@@ -300,6 +273,9 @@ void __driver_select_default_file(unsigned int tc_id, unsigned int carv_id) {
   return;
 }
 
+// The default carved file, records are decoded as they are replayed.
+static carved_reader default_reader;
+
 void __driver_inputf_open(char *inputfilename) {
   if (inputfilename == NULL) {
     fprintf(stderr, "Replay error : inputfilename is NULL\n");
@@ -309,164 +285,22 @@ void __driver_inputf_open(char *inputfilename) {
 
   fprintf(stderr, "Trying to read %s\n", inputfilename);
 
-  FILE *input_fp = fopen(inputfilename, "r");
-  if (input_fp == NULL) {
+  // Records of the default files start one char into their line.
+  if (!default_reader.open(inputfilename, 1)) {
     // fprintf(stderr, "Can't read input file\n");
     std::abort();
   }
 
-  __replay_default_inputs_size = 0;
-  __replay_default_inputs_capacity = 1024;
-  __replay_default_inputs =
-      (IVAR **)malloc(sizeof(IVAR *) * __replay_default_inputs_capacity);
-
-  char *line = NULL;
-  size_t len = 0;
-  ssize_t read;
-  bool is_carved_ptr = true;
-  while ((read = getline(&line, &len, input_fp)) != -1) {
-    if (is_carved_ptr) {
-      if (line[0] == '#') {
-        is_carved_ptr = false;
-      } else {
-        char *addr_str = strchr(line, ':');
-        if (addr_str == NULL) {
-          // fprintf(stderr, "Invalid input file\n");
-          // std::abort();
-        }
-        char *size_str = strchr(addr_str + 1, ':');
-        if (size_str == NULL) {
-          // fprintf(stderr, "Invalid input file\n");
-          // std::abort();
-        }
-        char *type_str = strchr(size_str + 1, ':');
-        if (type_str == NULL) {
-          // fprintf(stderr, "Invalid input file\n");
-          // std::abort();
-        }
-
-        *type_str = 0;
-        len = strlen(type_str + 1);
-        type_str[len] = 0;
-
-        int ptr_size = atoi(size_str + 1);
-
-        void *new_ptr = malloc(ptr_size);
-
-        __replay_default_carved_ptrs.push_back(
-            POINTER(new_ptr, strdup(type_str + 1), ptr_size));
-      }
-    } else {
-      char *type_str = line;
-      char *value_str = strchr(type_str + 1, ':');
-      if (value_str == NULL) {
-        fprintf(stderr, "Invalid input file\n");
-        std::abort();
-      }
-      char *index_str = strchr(value_str + 1, ':');
-
-      *value_str = 0;
-
-      type_str += 1;
-      if (!strncmp(type_str, "CHAR", 4)) {
-        char value = atoi(value_str + 1);
-        VAR<char> *inputv = new VAR<char>(value, 0, INPUT_TYPE::CHAR);
-        __replay_default_inputs[__replay_default_inputs_size++] =
-            ((IVAR *)inputv);
-      } else if (!strncmp(type_str, "SHORT", 5)) {
-        short value = atoi(value_str + 1);
-        VAR<short> *inputv = new VAR<short>(value, 0, INPUT_TYPE::SHORT);
-        __replay_default_inputs[__replay_default_inputs_size++] =
-            ((IVAR *)inputv);
-      } else if (!strncmp(type_str, "INT", 3)) {
-        int value = atoi(value_str + 1);
-        VAR<int> *inputv = new VAR<int>(value, 0, INPUT_TYPE::INT);
-        __replay_default_inputs[__replay_default_inputs_size++] =
-            ((IVAR *)inputv);
-      } else if (!strncmp(type_str, "LONG", 4)) {
-        long value = atol(value_str + 1);
-        VAR<long> *inputv = new VAR<long>(value, 0, INPUT_TYPE::LONG);
-        __replay_default_inputs[__replay_default_inputs_size++] =
-            ((IVAR *)inputv);
-      } else if (!strncmp(type_str, "LONGLONG", 8)) {
-        long long value = atoll(value_str + 1);
-        VAR<long long> *inputv =
-            new VAR<long long>(value, 0, INPUT_TYPE::LONGLONG);
-        __replay_default_inputs[__replay_default_inputs_size++] =
-            ((IVAR *)inputv);
-      } else if (!strncmp(type_str, "FLOAT", 5)) {
-        float value = atof(value_str + 1);
-        VAR<float> *inputv = new VAR<float>(value, 0, INPUT_TYPE::FLOAT);
-        __replay_default_inputs[__replay_default_inputs_size++] =
-            ((IVAR *)inputv);
-      } else if (!strncmp(type_str, "DOUBLE", 6)) {
-        double value = atof(value_str + 1);
-        VAR<double> *inputv = new VAR<double>(value, 0, INPUT_TYPE::DOUBLE);
-        __replay_default_inputs[__replay_default_inputs_size++] =
-            ((IVAR *)inputv);
-      } else if (!strncmp(type_str, "NULLPTR", 7)) {
-        VAR<void *> *inputv = new VAR<void *>(0, 0, INPUT_TYPE::NULLPTR);
-        __replay_default_inputs[__replay_default_inputs_size++] =
-            ((IVAR *)inputv);
-      } else if (!strncmp(type_str, "FUNCPTR", 7)) {
-        char *func_name = value_str + 1;
-        len = strlen(func_name);
-        func_name[len - 1] = 0;
-
-        bool found_func = false;
-
-        for (auto iter : __replay_func_ptrs) {
-          if (!strcmp(iter.second, func_name)) {
-            VAR<void *> *inputv =
-                new VAR<void *>(iter.first, 0, INPUT_TYPE::FUNCPTR);
-            __replay_default_inputs[__replay_default_inputs_size++] =
-                ((IVAR *)inputv);
-            found_func = true;
-            break;
-          }
-        }
-
-        if (!found_func) {
-          VAR<void *> *inputv = new VAR<void *>(0, 0, INPUT_TYPE::FUNCPTR);
-          __replay_default_inputs[__replay_default_inputs_size++] =
-              ((IVAR *)inputv);
-        }
-      } else if (!strncmp(type_str, "PTR", 3)) {
-        if (index_str == NULL) {
-          // fprintf(stderr, "Invalid input file\n");
-          // std::abort();
-        }
-
-        int ptr_index = atoi(value_str + 1);
-        int ptr_offset = atoi(index_str + 1);
-        VAR<int> *inputv =
-            new VAR<int>(ptr_index, 0, ptr_offset, INPUT_TYPE::PTR);
-        __replay_default_inputs[__replay_default_inputs_size++] =
-            ((IVAR *)inputv);
-      } else if (!strncmp(type_str, "UNKNOWN_PTR", 11)) {
-        VAR<void *> *inputv = new VAR<void *>(0, 0, INPUT_TYPE::UNKNOWN_PTR);
-        __replay_default_inputs[__replay_default_inputs_size++] =
-            ((IVAR *)inputv);
-      } else {
-        // fprintf(stderr, "Invalid input file\n");
-        // std::abort();
-      }
-
-      while (__replay_default_inputs_size >= __replay_default_inputs_capacity) {
-        __replay_inputs_capacity *= 2;
-        __replay_default_inputs =
-            (IVAR **)realloc(__replay_default_inputs,
-                             sizeof(IVAR *) * __replay_default_inputs_capacity);
-      }
-    }
-  }
+  int ptr_size;
+  const char *type_name;
+  unsigned long addr;
+  while (default_reader.next_ptr(&ptr_size, &type_name, &addr)) {
+    // Zeroed, elements left out by a sampling carver stay 0.
+    void *new_ptr = calloc(1, ptr_size);
 
-  if (line) {
-    free(line);
+    __replay_default_carved_ptrs.push_back(
+        POINTER(new_ptr, type_name, ptr_size));
   }
-  fclose(input_fp);
-
-  fprintf(stderr, "Read %u inputs\n", __replay_default_inputs_size);
   return;
 }
 
@@ -484,54 +318,54 @@ char *__select_replay_file(char *name, unsigned int id) {
       (char *)malloc(strlen(__carved_obj_dir) + strlen(name) + 2);
   sprintf(type_dir_name, "%s/%s", __carved_obj_dir, name);
 
-  DIR *dir = opendir(type_dir_name);
-  if (dir == NULL) {
+  char **file_names;
+  int num_files = replay_dirs.get(type_dir_name, DT_REG, &file_names);
+  if (num_files < 0) {
     std::cerr << "Error : Can't open dir : " << type_dir_name << "\n";
+    free(type_dir_name);
     return 0;
   }
 
-  struct dirent *ent;
-  int num_files = 0;
-  while ((ent = readdir(dir)) != NULL) {
-    if (ent->d_type == DT_REG) {
-      num_files++;
-    }
-  }
-
   if (num_files == 0) {
     fprintf(stderr, "Replay error : No files in directory : %s\n",
             type_dir_name);
     // std::abort();
+    free(type_dir_name);
     return 0;
   }
 
-  char **file_names = (char **)malloc(sizeof(char *) * num_files);
-
-  rewinddir(dir);
-
-  int file_idx = 0;
-  while ((ent = readdir(dir)) != NULL) {
-    if (ent->d_type == DT_REG) {
-      file_names[file_idx++] = ent->d_name;
-    }
-  }
-
-  qsort(file_names, num_files, sizeof(char *), filename_cmp);
-
   int sel_file_idx = id % num_files;
 
   char *file_name = (char *)malloc(strlen(type_dir_name) +
                                    strlen(file_names[sel_file_idx]) + 2);
 
   sprintf(file_name, "%s/%s", type_dir_name, file_names[sel_file_idx]);
-  closedir(dir);
 
   free(type_dir_name);
-  free(file_names);
 
   return file_name;
 }
 
+// Copies the selected carved file to `to_name`, as a reflink where the file
+// system allows it and in the kernel otherwise.
+static void copy_fetched_file(const char *from_name, const char *to_name) {
+  int from_fd = open(from_name, O_RDONLY);
+  if (from_fd < 0) {
+    return;
+  }
+
+  struct stat st;
+  int to_fd = open(to_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if ((to_fd >= 0) && (fstat(from_fd, &st) == 0)) {
+    file_store::copy_file(from_fd, to_fd, st.st_size);
+  }
+
+  if (to_fd >= 0) {
+    close(to_fd);
+  }
+  close(from_fd);
+}
+
 char *__fetch_file(char *name, unsigned int id) {
   if (__carved_obj_dir == NULL) {
     fprintf(stderr, "Replay error : __carved_obj_dir is NULL\n");
@@ -543,64 +377,34 @@ char *__fetch_file(char *name, unsigned int id) {
       (char *)malloc(strlen(__carved_obj_dir) + strlen(name) + 14);
   sprintf(type_dir_name, "%s/carved_file_%s", __carved_obj_dir, name);
 
-  DIR *dir = opendir(type_dir_name);
-  if (dir == NULL) {
+  char **file_names;
+  int num_files = replay_dirs.get(type_dir_name, DT_REG, &file_names);
+  if (num_files < 0) {
     fprintf(stderr, "Replay error : Can't open directory : %s\n",
             type_dir_name);
     // std::abort();
+    free(type_dir_name);
     return 0;
   }
 
-  struct dirent *ent;
-  int num_files = 0;
-  while ((ent = readdir(dir)) != NULL) {
-    if (ent->d_type == DT_REG) {
-      num_files++;
-    }
-  }
-
   if (num_files == 0) {
     fprintf(stderr, "Replay error : No files in directory : %s\n",
             type_dir_name);
     // std::abort();
+    free(type_dir_name);
     return 0;
   }
 
-  char **file_names = (char **)malloc(sizeof(char *) * num_files);
-
-  rewinddir(dir);
-
-  int file_idx = 0;
-  while ((ent = readdir(dir)) != NULL) {
-    if (ent->d_type == DT_REG) {
-      file_names[file_idx++] = ent->d_name;
-    }
-  }
-
-  qsort(file_names, num_files, sizeof(char *), filename_cmp);
-
   int sel_file_idx = id % num_files;
 
   char *file_name = (char *)malloc(strlen(type_dir_name) +
                                    strlen(file_names[sel_file_idx]) + 2);
 
   sprintf(file_name, "%s/%s", type_dir_name, file_names[sel_file_idx]);
-  closedir(dir);
 
-  // copy file
-  FILE *to_fp = fopen(name, "w");
-  FILE *from_fp = fopen(file_name, "r");
-  char buf[1024];
-  size_t nread;
-  while ((nread = fread(buf, 1, sizeof(buf), from_fp)) > 0) {
-    fwrite(buf, 1, nread, to_fp);
-  }
-
-  fclose(to_fp);
-  fclose(from_fp);
+  copy_fetched_file(file_name, name);
 
   free(type_dir_name);
-  free(file_names);
 
   return file_name;
 }
@@ -614,7 +418,7 @@ void __driver_initialize() {
 
   __replay_inputs_size = 0;
   __replay_carved_ptrs.clear();
-  __replay_replayed_ptr.clear();
+  __replay_replayed_ptr.clear(0);
   cur_input_idx = 0;
   return;
 }
@@ -764,6 +568,13 @@ void *Replay_pointer(int default_idx, int default_pointee_size,
 #endif
   }
 
+  if (elem->type == INPUT_TYPE::TRUNCATED) {
+    // Carving ran out of budget here, give it one zeroed object.
+    __replay_cur_alloc_size = 0;
+    __replay_cur_pointee_size = -1;
+    return calloc(1, default_pointee_size);
+  }
+
   if (elem->type != INPUT_TYPE::PTR) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     __replay_cur_alloc_size = 0;
@@ -777,13 +588,11 @@ void *Replay_pointer(int default_idx, int default_pointee_size,
 
   POINTER carved_ptr = __replay_carved_ptrs[ptr_index];
 
-  auto search = __replay_replayed_ptr.find(ptr_index);
-  if (search != __replay_replayed_ptr.end()) {
+  if (__replay_replayed_ptr.test_and_set(ptr_index)) {
     __replay_cur_alloc_size = 0;
     __replay_cur_pointee_size = -1;
     return (char *)carved_ptr.addr + ptr_offset;
   }
-  __replay_replayed_ptr.insert(make_pair(ptr_index, 0));
 
   __replay_cur_alloc_size = carved_ptr.alloc_size;
   __replay_cur_zero_address = carved_ptr.addr;
@@ -798,12 +607,10 @@ void *Replay_pointer(int default_idx, int default_pointee_size,
   }
 
   // carved ptr has different type
-  for (auto iter : __replay_class_info) {
-    if (!strcmp(iter.first, type_name)) {
-      __replay_cur_pointee_size = iter.second.size;
-      __replay_cur_class_index = iter.second.class_index;
-      break;
-    }
+  class_meta *class_search = find_class_meta(type_name);
+  if (class_search != NULL) {
+    __replay_cur_pointee_size = class_search->size;
+    __replay_cur_class_index = class_search->index;
   }
 
   return (char *)carved_ptr.addr + ptr_offset;
@@ -825,117 +632,36 @@ void *Replay_func_ptr() {
   return ((VAR<void *> *)elem)->input;
 }
 
-void __keep_class_info(char *class_name, int size, int index) {
-  classinfo tmp{index, size};
-  __replay_class_info.insert(make_pair(class_name, tmp));
-}
+// Bind the static function pointer and class tables emitted by the pass.
+void __driver_bind_meta(func_meta *funcs, int num_funcs, class_meta *classes,
+                        int num_classes) {
+  int idx;
+  for (idx = 0; idx < num_funcs; idx++) {
+    __replay_func_names.insert(funcs[idx].name, idx);
+  }
+  for (idx = 0; idx < num_classes; idx++) {
+    __replay_class_names.insert(classes[idx].class_name, idx);
+  }
 
-void __record_func_ptr(void *ptr, char *name) {
-  __replay_func_ptrs.insert(make_pair(ptr, name));
+  __replay_func_ptrs = funcs;
+  __replay_class_info = classes;
 }
 
 char *__update_class_ptr(char *ptr, int idx, int size) {
   return ptr + (idx * size);
 }
 
-// coverage
-static map<char *, map<std::string, map<std::string, bool>>>
-    __replay_coverage_info;
-
-void __record_bb_cov(char *file_name, char *func_name, char *bb_name) {
-  if (__replay_coverage_info.find(file_name) == __replay_coverage_info.end()) {
-    __replay_coverage_info.insert(
-        make_pair(file_name, map<std::string, map<std::string, bool>>()));
-  }
-
-  map<std::string, map<std::string, bool>> &file_info =
-      __replay_coverage_info[file_name];
-  if (file_info.find(func_name) == file_info.end()) {
-    file_info.insert(make_pair(func_name, map<std::string, bool>()));
-  }
-
-  map<std::string, bool> &func_info = file_info[func_name];
-  if (func_info.find(bb_name) == func_info.end()) {
-    func_info.insert(make_pair(bb_name, true));
-  }
-
-  return;
-}
-
-void __cov_fini() {
-  for (auto iter : __replay_coverage_info) {
-    const std::string cov_file_name = std::string(iter.first) + ".cov";
-
-    map<std::string, map<std::string, bool>> &file_info = iter.second;
-
-    std::ifstream cov_file_in(cov_file_name, std::ios::in);
-
-    if (cov_file_in.is_open()) {
-      std::string type;
-      std::string name;
-      bool is_covered = false;
-      std::string cur_func = "";
-      std::string line;
-      while (getline(cov_file_in, line)) {
-        auto pos1 = line.find(" ");
-
-        if (pos1 == std::string::npos) {
-          break;
-        }
-
-        auto pos2 = line.find_last_of(" ");
-
-        if (pos2 == std::string::npos) {
-          break;
-        }
-
-        if (pos1 == pos2) {
-          break;
-        }
-
-        type = line.substr(0, pos1);
-        name = line.substr(pos1 + 1, pos2 - pos1 - 1);
-        is_covered = line.substr(pos2 + 1) == "1";
-        if (type == "F") {
-          if (file_info.find(name) == file_info.end()) {
-            file_info.insert(make_pair(name, map<std::string, bool>()));
-          }
-
-          cur_func = name;
-        } else {
-          if (file_info[cur_func].find(name) == file_info[cur_func].end()) {
-            file_info[cur_func].insert(make_pair(name, is_covered));
-          } else if (is_covered) {
-            file_info[cur_func][name] = true;
-          }
-        }
-      }
+// Next element to replay after `idx`, past the elements a sampling carver
+// left out.
+int __replay_next_elem_idx(int idx, int num_elems) {
+  if (cur_input_idx < __replay_inputs_size) {
+    IVAR *elem = __replay_inputs[cur_input_idx];
+    if (elem->type == INPUT_TYPE::SKIPPED) {
+      cur_input_idx++;
+      return idx + 1 + ((VAR<int> *)elem)->input;
     }
-    cov_file_in.close();
-
-    std::ofstream cov_file_out(cov_file_name, std::ios::out);
-
-    for (auto iter2 : file_info) {
-      bool is_func_covered = false;
-      const map<std::string, bool> &func_info = iter2.second;
-
-      for (auto iter3 : func_info) {
-        if (iter3.second) {
-          is_func_covered = true;
-          break;
-        }
-      }
-
-      cov_file_out << "F " << iter2.first << " " << is_func_covered << "\n";
-
-      for (auto iter3 : func_info) {
-        cov_file_out << "B " << iter3.first << " " << iter3.second << "\n";
-      }
-    }
-
-    cov_file_out.close();
   }
-  return;
+  return idx + 1;
 }
 
 static map<int, char *> __target_func_idx_map;
@@ -949,115 +675,88 @@ void __driver_get_target_func_name(int func_idx) {
 }
 
 // Default replay
-static int cur_default_input_idx = 0;
 char Replay_default_char() {
-  if (__replay_default_inputs_size <= cur_default_input_idx) {
-    return 0;
-  }
-
-  IVAR *elem = __replay_default_inputs[cur_default_input_idx++];
+  const carved_record *elem = default_reader.next();
 
-  if ((elem->type != INPUT_TYPE::CHAR)) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::CHAR)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  return ((VAR<char> *)elem)->input;
+  return elem->value;
 }
 
 short Replay_default_short() {
-  if (__replay_default_inputs_size <= cur_default_input_idx) {
-    return 0;
-  }
-
-  IVAR *elem = __replay_default_inputs[cur_default_input_idx++];
+  const carved_record *elem = default_reader.next();
 
-  if (elem->type != INPUT_TYPE::SHORT) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::SHORT)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  return ((VAR<short> *)elem)->input;
+  return elem->value;
 }
 
 int Replay_default_int() {
-  if (__replay_default_inputs_size <= cur_default_input_idx) {
-    return 0;
-  }
-
-  IVAR *elem = __replay_default_inputs[cur_default_input_idx++];
+  const carved_record *elem = default_reader.next();
 
-  if (elem->type != INPUT_TYPE::INT) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::INT)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  return ((VAR<int> *)elem)->input;
+  return elem->value;
 }
 
 long Replay_default_longtype() {
-  if (__replay_default_inputs_size <= cur_default_input_idx) {
-    return 0;
-  }
-
-  IVAR *elem = __replay_default_inputs[cur_default_input_idx++];
+  const carved_record *elem = default_reader.next();
 
-  if (elem->type != INPUT_TYPE::LONG) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::LONG)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  return ((VAR<long> *)elem)->input;
+  return elem->value;
 }
 
 long long Replay_default_longlong() {
-  if (__replay_default_inputs_size <= cur_default_input_idx) {
-    return 0;
-  }
-
-  IVAR *elem = __replay_default_inputs[cur_default_input_idx++];
+  const carved_record *elem = default_reader.next();
 
-  if (elem->type != INPUT_TYPE::LONGLONG) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::LONGLONG)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  return ((VAR<long long> *)elem)->input;
+  return elem->value;
 }
 
 float Replay_default_float() {
-  if (__replay_default_inputs_size <= cur_default_input_idx) {
-    return 0;
-  }
-  IVAR *elem = __replay_default_inputs[cur_default_input_idx++];
+  const carved_record *elem = default_reader.next();
 
-  if (elem->type != INPUT_TYPE::FLOAT) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::FLOAT)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  return ((VAR<float> *)elem)->input;
+  return elem->fvalue;
 }
 
 double Replay_default_double() {
-  if (__replay_default_inputs_size <= cur_default_input_idx) {
-    return 0;
-  }
-  IVAR *elem = __replay_default_inputs[cur_default_input_idx++];
+  const carved_record *elem = default_reader.next();
 
-  if (elem->type != INPUT_TYPE::DOUBLE) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::DOUBLE)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  return ((VAR<double> *)elem)->input;
+  return elem->fvalue;
 }
 
 int __replay_default_cur_alloc_size = 0;
@@ -1067,21 +766,20 @@ void *__replay_default_cur_zero_address = 0;
 
 void *Replay_default_pointer(int default_idx, int default_pointee_size,
                              char *pointee_type_name) {
-  if (__replay_default_inputs_size <= cur_default_input_idx) {
+  const carved_record *elem = default_reader.next();
+  if (elem == NULL) {
     __replay_default_cur_alloc_size = 0;
     __replay_default_cur_pointee_size = -1;
     return 0;
   }
 
-  IVAR *elem = __replay_default_inputs[cur_default_input_idx++];
-
-  if (elem->type == INPUT_TYPE::NULLPTR) {
+  if (elem->type == RECORD_TYPE::NULLPTR) {
     __replay_default_cur_alloc_size = 0;
     __replay_default_cur_pointee_size = -1;
     return 0;
   }
 
-  if (elem->type == INPUT_TYPE::UNKNOWN_PTR) {
+  if (elem->type == RECORD_TYPE::UNKNOWN_PTR) {
     // alloc 1 object
 #define ALLOC_1_OBJ
 #ifdef ALLOC_1_OBJ
@@ -1095,26 +793,30 @@ void *Replay_default_pointer(int default_idx, int default_pointee_size,
 #endif
   }
 
-  if (elem->type != INPUT_TYPE::PTR) {
+  if (elem->type == RECORD_TYPE::TRUNCATED) {
+    // Carving ran out of budget here, give it one zeroed object.
+    __replay_default_cur_alloc_size = 0;
+    __replay_default_cur_pointee_size = -1;
+    return calloc(1, default_pointee_size);
+  }
+
+  if (elem->type != RECORD_TYPE::PTR) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     __replay_default_cur_alloc_size = 0;
     __replay_default_cur_pointee_size = -1;
     return 0;
   }
 
-  VAR<int> *elem_v = (VAR<int> *)elem;
-  int ptr_index = elem_v->input;
-  int ptr_offset = elem_v->pointer_offset;
+  int ptr_index = elem->value;
+  int ptr_offset = elem->offset;
 
   POINTER carved_ptr = __replay_default_carved_ptrs[ptr_index];
 
-  auto search = __replay_default_replayed_ptr.find(ptr_index);
-  if (search != __replay_default_replayed_ptr.end()) {
+  if (__replay_default_replayed_ptr.test_and_set(ptr_index)) {
     __replay_default_cur_alloc_size = 0;
     __replay_default_cur_pointee_size = -1;
     return (char *)carved_ptr.addr + ptr_offset;
   }
-  __replay_default_replayed_ptr.insert(make_pair(ptr_index, 0));
 
   __replay_default_cur_alloc_size = carved_ptr.alloc_size;
   __replay_default_cur_zero_address = carved_ptr.addr;
@@ -1129,31 +831,26 @@ void *Replay_default_pointer(int default_idx, int default_pointee_size,
   }
 
   // carved ptr has different type
-  for (auto iter : __replay_class_info) {
-    if (!strcmp(iter.first, type_name)) {
-      __replay_default_cur_pointee_size = iter.second.size;
-      __replay_default_cur_class_index = iter.second.class_index;
-      break;
-    }
+  class_meta *class_search = find_class_meta(type_name);
+  if (class_search != NULL) {
+    __replay_default_cur_pointee_size = class_search->size;
+    __replay_default_cur_class_index = class_search->index;
   }
 
   return (char *)carved_ptr.addr + ptr_offset;
 }
 
 void *Replay_default_func_ptr() {
-  if (__replay_default_inputs_size <= cur_default_input_idx) {
-    return 0;
-  }
-  IVAR *elem = __replay_default_inputs[cur_default_input_idx++];
+  const carved_record *elem = default_reader.next();
 
-  if ((elem->type != INPUT_TYPE::FUNCPTR) &&
-      (elem->type != INPUT_TYPE::NULLPTR)) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::FUNCPTR)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  return ((VAR<void *> *)elem)->input;
+  func_meta *found_func = find_func_meta((char *)elem->name);
+  return found_func == NULL ? NULL : found_func->addr;
 }
 
 }  // extern "C"
\ No newline at end of file
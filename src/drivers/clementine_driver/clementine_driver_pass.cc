@@ -4,7 +4,6 @@ FunctionCallee sel_file;
 FunctionCallee init_driver;
 FunctionCallee fetch_file;
 FunctionCallee cov_fini;
-FunctionCallee record_bb;
 Constant *cur_target_func_idx;
 
 FunctionCallee default_class_replay;
@@ -87,8 +86,6 @@ bool ClementinePass::instrument_module() {
   fetch_file =
       Mod->getOrInsertFunction("__fetch_file", Int8PtrTy, Int8PtrTy, Int32Ty);
 
-  record_bb = Mod->getOrInsertFunction("__record_bb_cov", VoidTy, Int8PtrTy,
-                                       Int8PtrTy, Int8PtrTy);
 
   cov_fini = Mod->getOrInsertFunction("__cov_fini", VoidTy);
 
@@ -194,28 +191,13 @@ bool ClementinePass::instrument_module() {
     instrument_stub(&F);
   }
 
-  for (auto iter : file_bb_map) {
-    std::string filename = iter.first;
-
-    std::string cov_filename = filename + ".cov";
-    std::ofstream cov_file(cov_filename);
-
-    for (auto iter2 : iter.second) {
-      const std::set<std::string> &bb_set = iter2.second;
-      cov_file << "F " << iter2.first << " " << false << "\n";
-      for (auto &bb_name : bb_set) {
-        cov_file << "b " << bb_name << " " << false << "\n";
-      }
-    }
-
-    cov_file.close();
-  }
-
   if (main_func == NULL) {
     DEBUG0("FATAL : main function not found.\n");
     return false;
   }
 
+  insert_bb_cov_bind(main_func);
+
   check_and_dump_module();
   delete IRB;
   return true;
@@ -227,10 +209,11 @@ void ClementinePass::instrument_main_func(Function *main_func) {
   BasicBlock *entry_block = &main_func->getEntryBlock();
   IRB->SetInsertPoint(entry_block->getFirstNonPHIOrDbgOrLifetime());
 
-  // Record func ptr
-  FunctionCallee record_func_ptr = Mod->getOrInsertFunction(
-      "__record_func_ptr", VoidTy, Int8PtrTy, Int8PtrTy);
+  // Bind func ptr and class info tables
+  FunctionCallee bind_meta = Mod->getOrInsertFunction(
+      "__driver_bind_meta", VoidTy, Int8PtrTy, Int32Ty, Int8PtrTy, Int32Ty);
 
+  std::vector<std::pair<Function *, std::string>> funcs;
   for (Function *func : func_list) {
     std::string func_name = func->getName().str();
 
@@ -238,19 +221,16 @@ void ClementinePass::instrument_main_func(Function *main_func) {
       continue;
     }
 
-    Constant *func_name_const = gen_new_string_constant(func_name, IRB);
-    Value *cast_val =
-        IRB->CreateCast(Instruction::CastOps::BitCast, func, Int8PtrTy);
-    IRB->CreateCall(record_func_ptr, {cast_val, func_name_const});
+    funcs.push_back(std::make_pair(func, func_name));
   }
 
-  // Record class type string constants
-  for (auto iter : class_name_map) {
-    unsigned int class_size = DL->getTypeAllocSize(iter.first);
-    IRB->CreateCall(keep_class_info,
-                    {iter.second.second, ConstantInt::get(Int32Ty, class_size),
-                     ConstantInt::get(Int32Ty, iter.second.first)});
-  }
+  Constant *func_ptr_table = gen_func_ptr_table(funcs);
+  Constant *class_info_table = gen_class_info_table();
+
+  IRB->CreateCall(bind_meta,
+                  {func_ptr_table, ConstantInt::get(Int32Ty, funcs.size()),
+                   class_info_table,
+                   ConstantInt::get(Int32Ty, class_name_map.size())});
 
   Value *new_argc = NULL;
   Value *new_argv = NULL;
@@ -291,6 +271,11 @@ void ClementinePass::instrument_main_func(Function *main_func) {
     IRB->CreateCall(record_func_idx, {idx_const, func_name_const});
   }
 
+  // Setup is done, a fork server takes over here if asked.
+  FunctionCallee fork_server = Mod->getOrInsertFunction(
+      "__driver_fork_server", VoidTy, Int32PtrTy, Int8PtrPtrPtrTy);
+  IRB->CreateCall(fork_server, {argc_ptr, argv_ptr});
+
   std::set<ReturnInst *> ret_inst_set;
   for (auto &BB : *main_func) {
     for (auto &I : BB) {
@@ -603,19 +588,7 @@ void ClementinePass::get_target_func_idx() {
 
 void ClementinePass::instrument_bb_cov(Function *F, const std::string &filename,
                                        const std::string &func_name) {
-  if (file_bb_map.find(filename) == file_bb_map.end()) {
-    file_bb_map.insert({filename, {}});
-  }
-
-  if (file_bb_map[filename].find(func_name) == file_bb_map[filename].end()) {
-    file_bb_map[filename].insert({func_name, {}});
-  }
-
-  Constant *filename_const = gen_new_string_constant(filename, IRB);
-  Constant *func_name_const = gen_new_string_constant(func_name, IRB);
-
-  std::set<std::string> &cur_bb_set = file_bb_map[filename][func_name];
-
+  std::vector<std::pair<Instruction *, std::string>> cov_blocks;
   for (auto &BB : F->getBasicBlockList()) {
     Instruction *first_inst = BB.getFirstNonPHIOrDbgOrLifetime();
     if (first_inst == NULL) {
@@ -630,14 +603,11 @@ void ClementinePass::instrument_bb_cov(Function *F, const std::string &filename,
     if (BB_name == "") {
       continue;
     }
-    cur_bb_set.insert(BB_name);
-
-    IRB->SetInsertPoint(first_inst);
-    Constant *bb_name_const = gen_new_string_constant(BB_name, IRB);
-    IRB->CreateCall(record_bb,
-                    {filename_const, func_name_const, bb_name_const});
+    cov_blocks.push_back(std::make_pair(first_inst, BB_name));
   }
 
+  insert_bb_cov_counters(filename, func_name, cov_blocks);
+
   // Insert cov fini
   for (auto &BB : F->getBasicBlockList()) {
     for (auto &IN : BB) {
@@ -870,6 +840,8 @@ Value *insert_replay_probe_cl(Type *typeptr, Value *ptr) {
 
     unsigned int num_elem = struct_type->getNumElements();
 
+    // Each field is inserted into the value holding the previous ones.
+    result = UndefValue::get(typeptr);
     unsigned int idx = 0;
     for (idx = 0; idx < num_elem; idx++) {
       Type *field_type = struct_type->getElementType(idx);
@@ -877,8 +849,7 @@ Value *insert_replay_probe_cl(Type *typeptr, Value *ptr) {
       if (carved_val == NULL) {
         return NULL;
       }
-      result =
-          IRB->CreateInsertValue(UndefValue::get(typeptr), carved_val, idx);
+      result = IRB->CreateInsertValue(result, carved_val, idx);
     }
   } else if (is_func_ptr_type(typeptr)) {
     result = IRB->CreateCall(replay_func_ptr, {});
@@ -986,8 +957,9 @@ Value *insert_replay_probe_cl(Type *typeptr, Value *ptr) {
       insert_gep_replay_probe(getelem_instr);
     }
 
+    // Skips the elements left out by a sampling carver.
     Value *index_update_instr =
-        IRB->CreateAdd(index_phi, ConstantInt::get(Int32Ty, 1));
+        IRB->CreateCall(replay_next_elem_idx, {index_phi, ptr_size});
     index_phi->addIncoming(index_update_instr, IRB->GetInsertBlock());
 
     Value *cmp_instr2 = IRB->CreateICmpSLT(index_update_instr, ptr_size);
@@ -2,6 +2,8 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,121 +12,30 @@
 #include <unistd.h>
 
 #include <iostream>
-#include <map>
-#include <fstream>
 
+#include "utils/carved_reader.hpp"
 #include "utils/data_utils.hpp"
+#include "utils/dir_index.hpp"
+#include "utils/file_store.hpp"
+#include "utils/fork_server.hpp"
+#include "utils/name_index.hpp"
+#include "utils/ptr_bitset.hpp"
+#include "utils/replay_arena.hpp"
 
 extern "C" {
 
-map<char *, classinfo> __replay_class_info;
+// Classes by name, for pointees carved with another type
+static vector<classinfo> __replay_class_info;
+static name_index __replay_class_names;
 
-// Function pointer names
-static map<void *, char *> __replay_func_ptrs;
+// Function pointers by name
+static vector<void *> __replay_func_ptrs;
+static name_index __replay_func_names;
 
-// coverage
-static std::map<char *, std::map<std::string, std::map<std::string, bool>>> __replay_coverage_info;
-
-void __record_bb_cov(char *file_name, char *func_name, char *bb_name) {
-  if (__replay_coverage_info.find(file_name) == __replay_coverage_info.end()) {
-    __replay_coverage_info.insert(
-        std::make_pair(file_name, std::map<std::string, std::map<std::string, bool>>()));
-  }
-
-  std::map<std::string, std::map<std::string, bool>> &file_info = __replay_coverage_info[file_name];
-  if (file_info.find(func_name) == file_info.end()) {
-    file_info.insert(std::make_pair(func_name, std::map<std::string, bool>()));
-  }
-
-  std::map<std::string, bool> &func_info = file_info[func_name];
-  if (func_info.find(bb_name) == func_info.end()) {
-    func_info.insert(std::make_pair(bb_name, true));
-  }
-
-  return;
-}
-
-void __cov_fini() {
-  for (auto iter : __replay_coverage_info) {
-    const std::string cov_file_name = std::string(iter.first) + ".cov";
-
-    std::map<std::string, std::map<std::string, bool>> &file_info = iter.second;
-
-    std::ifstream cov_file_in(cov_file_name, std::ios::in);
-
-    if (cov_file_in.is_open()) {
-      std::string type;
-      std::string name;
-      bool is_covered = false;
-      std::string cur_func = "";
-      std::string line;
-      while (getline(cov_file_in, line)) {
-        auto pos1 = line.find(" ");
-
-        if (pos1 == std::string::npos) {
-          break;
-        }
-
-        auto pos2 = line.find_last_of(" ");
-
-        if (pos2 == std::string::npos) {
-          break;
-        }
-
-        if (pos1 == pos2) {
-          break;
-        }
-
-        type = line.substr(0, pos1);
-        name = line.substr(pos1 + 1, pos2 - pos1 - 1);
-        is_covered = line.substr(pos2 + 1) == "1";
-        if (type == "F") {
-          if (file_info.find(name) == file_info.end()) {
-            file_info.insert(std::make_pair(name, std::map<std::string, bool>()));
-          }
-
-          cur_func = name;
-        } else {
-          if (file_info[cur_func].find(name) == file_info[cur_func].end()) {
-            file_info[cur_func].insert(make_pair(name, is_covered));
-          } else if (is_covered) {
-            file_info[cur_func][name] = true;
-          }
-        }
-      }
-    }
-    cov_file_in.close();
-
-    std::ofstream cov_file_out(cov_file_name, std::ios::out);
-
-    for (auto iter2 : file_info) {
-      bool is_func_covered = false;
-      const std::map<std::string, bool> &func_info = iter2.second;
-
-      for (auto iter3 : func_info) {
-        if (iter3.second) {
-          is_func_covered = true;
-          break;
-        }
-      }
-
-      cov_file_out << "F " << iter2.first << " " << is_func_covered << "\n";
-
-      for (auto iter3 : func_info) {
-        cov_file_out << "B " << iter3.first << " " << iter3.second << "\n";
-      }
-    }
-
-    cov_file_out.close();
-  }
-  return;
-}
-
-vector<IVAR *> __replay_inputs;
 vector<POINTER> __replay_carved_ptrs;
 
-// adhoc to make a set
-map<int, char> __replay_replayed_ptr;
+// Pointer table indexes whose pointee is replayed
+static ptr_bitset __replay_replayed_ptr;
 
 char *__carved_obj_dir = NULL;
 
@@ -144,6 +55,24 @@ void __driver_input_argv_modifier(int *argcptr, char ***argvptr) {
   (*argvptr)[argc] = 0;
 }
 
+// The carved file being replayed, records are decoded as they are replayed.
+static carved_reader replay_reader;
+
+// Objects of the context being replayed get their own calloc, the target
+// may free or realloc them. They are never freed by the driver, which does
+// not know which ones the target freed, so a persistent replay grows by
+// the objects of every context. With REPLAY_ARENA=1 they come from an
+// arena instead and are freed at once by __replay_fini.
+static replay_arena replay_objs;
+static bool replay_use_arena = false;
+
+static void *replay_alloc(size_t size, unsigned long orig_addr) {
+  if (replay_use_arena) {
+    return replay_objs.alloc(size, orig_addr);
+  }
+  return calloc(1, size);
+}
+
 void __driver_inputf_open(char *inputfilename) {
   if (inputfilename == NULL) {
     fprintf(stderr, "Replay error : inputfilename is NULL\n");
@@ -151,148 +80,27 @@ void __driver_inputf_open(char *inputfilename) {
     return;
   }
 
-  FILE *input_fp = fopen(inputfilename, "r");
-  if (input_fp == NULL) {
+  if (!replay_reader.open(inputfilename, 0)) {
     // fprintf(stderr, "Can't read input file\n");
     std::abort();
   }
 
-  char *line = NULL;
-  size_t len = 0;
-  ssize_t read;
-  bool is_carved_ptr = true;
-  while ((read = getline(&line, &len, input_fp)) != -1) {
-    if (is_carved_ptr) {
-      if (line[0] == '#') {
-        is_carved_ptr = false;
-      } else {
-        char *addr_str = strchr(line, ':');
-        if (addr_str == NULL) {
-          // fprintf(stderr, "Invalid input file\n");
-          // std::abort();
-        }
-        char *size_str = strchr(addr_str + 1, ':');
-        if (size_str == NULL) {
-          // fprintf(stderr, "Invalid input file\n");
-          // std::abort();
-        }
-        char *type_str = strchr(size_str + 1, ':');
-        if (type_str == NULL) {
-          // fprintf(stderr, "Invalid input file\n");
-          // std::abort();
-        }
-
-        *type_str = 0;
-        len = strlen(type_str + 1);
-        type_str[len] = 0;
-
-        int ptr_size = atoi(size_str + 1);
-
-        void *new_ptr = malloc(ptr_size);
-
-        __replay_carved_ptrs.push_back(
-            POINTER(new_ptr, strdup(type_str + 1), ptr_size));
-      }
-    } else {
-      if (!strncmp(line, "OBJ_INFO", 8)) {
-        continue;
-      }
+  int ptr_size;
+  const char *type_name;
+  unsigned long addr;
+  while (replay_reader.next_ptr(&ptr_size, &type_name, &addr)) {
+    // Zeroed, elements left out by a sampling carver stay 0.
+    void *new_ptr = replay_alloc(ptr_size, addr);
 
-      char *type_str = line;
-
-      char *value_str = strchr(type_str, ':');
-      if (value_str == NULL) {
-        fprintf(stderr, "Invalid input file 2\n");
-        std::abort();
-      }
-
-      char *index_str = strchr(value_str + 1, ':');
-      
-      if (!strncmp(type_str, "CHAR", 4)) {
-        char value = atoi(value_str + 1);
-        VAR<char> *inputv = new VAR<char>(value, 0, INPUT_TYPE::CHAR);
-        __replay_inputs.push_back((IVAR *)inputv);
-      } else if (!strncmp(type_str, "SHORT", 5)) {
-        short value = atoi(value_str + 1);
-        VAR<short> *inputv = new VAR<short>(value, 0, INPUT_TYPE::SHORT);
-        __replay_inputs.push_back((IVAR *)inputv);
-      } else if (!strncmp(type_str, "INT", 3)) {
-        int value = atoi(value_str + 1);
-        VAR<int> *inputv = new VAR<int>(value, 0, INPUT_TYPE::INT);
-        __replay_inputs.push_back((IVAR *)inputv);
-      } else if (!strncmp(type_str, "LONG", 4)) {
-        long value = atol(value_str + 1);
-        VAR<long> *inputv = new VAR<long>(value, 0, INPUT_TYPE::LONG);
-        __replay_inputs.push_back((IVAR *)inputv);
-      } else if (!strncmp(type_str, "LONGLONG", 8)) {
-        long long value = atoll(value_str + 1);
-        VAR<long long> *inputv =
-            new VAR<long long>(value, 0, INPUT_TYPE::LONGLONG);
-        __replay_inputs.push_back((IVAR *)inputv);
-      } else if (!strncmp(type_str, "FLOAT", 5)) {
-        float value = atof(value_str + 1);
-        VAR<float> *inputv = new VAR<float>(value, 0, INPUT_TYPE::FLOAT);
-        __replay_inputs.push_back((IVAR *)inputv);
-      } else if (!strncmp(type_str, "DOUBLE", 6)) {
-        double value = atof(value_str + 1);
-        VAR<double> *inputv = new VAR<double>(value, 0, INPUT_TYPE::DOUBLE);
-        __replay_inputs.push_back((IVAR *)inputv);
-      } else if (!strncmp(type_str, "NULLPTR", 7)) {
-        VAR<void *> *inputv = new VAR<void *>(0, 0, INPUT_TYPE::NULLPTR);
-        __replay_inputs.push_back((IVAR *)inputv);
-      } else if (!strncmp(type_str, "FUNCPTR", 7)) {
-        char *func_name = value_str + 1;
-        len = strlen(func_name);
-        func_name[len - 1] = 0;
-        int idx = 0;
-        int num_funcs = __replay_func_ptrs.size();
-        for (idx = 0; idx < num_funcs; idx++) {
-          auto data = __replay_func_ptrs.get_by_idx(idx);
-          if (!strcmp(func_name, data->elem)) {
-            VAR<void *> *inputv =
-                new VAR<void *>(data->key, 0, INPUT_TYPE::FUNCPTR);
-            __replay_inputs.push_back((IVAR *)inputv);
-            break;
-          }
-        }
-
-        if (idx == num_funcs) {
-          // fprintf(stderr, "Replay error : Can't get function name : %s\n",
-          // func_name);
-          VAR<void *> *inputv = new VAR<void *>(0, 0, INPUT_TYPE::FUNCPTR);
-          __replay_inputs.push_back((IVAR *)inputv);
-        }
-      } else if (!strncmp(type_str, "PTR", 3)) {
-        if (index_str == NULL) {
-          // fprintf(stderr, "Invalid input file\n");
-          // std::abort();
-        }
-
-        int ptr_index = atoi(value_str + 1);
-        int ptr_offset = atoi(index_str + 1);
-        VAR<int> *inputv =
-            new VAR<int>(ptr_index, 0, ptr_offset, INPUT_TYPE::PTR);
-        __replay_inputs.push_back((IVAR *)inputv);
-      } else if (!strncmp(type_str, "UNKNOWN_PTR", 11)) {
-        VAR<void *> *inputv = new VAR<void *>(0, 0, INPUT_TYPE::UNKNOWN_PTR);
-        __replay_inputs.push_back((IVAR *)inputv);
-      } else {
-        // fprintf(stderr, "Invalid input file\n");
-        // std::abort();
-      }
-    }
+    __replay_carved_ptrs.push_back(POINTER(new_ptr, type_name, ptr_size));
   }
 
-  if (line) {
-    free(line);
-  }
-  fclose(input_fp);
+  __replay_replayed_ptr.clear(__replay_carved_ptrs.size());
   return;
 }
 
-static int filename_cmp(const void *l, const void *r) {
-  return strcmp((const char *)l, (const char *)r);
-}
+// Type directories of __select_replay_file and __fetch_file
+static dir_index replay_dirs;
 
 char *__select_replay_file(char *name, unsigned int id) {
   if (__carved_obj_dir == NULL) {
@@ -304,54 +112,54 @@ char *__select_replay_file(char *name, unsigned int id) {
       (char *)malloc(strlen(__carved_obj_dir) + strlen(name) + 2);
   sprintf(type_dir_name, "%s/%s", __carved_obj_dir, name);
 
-  DIR *dir = opendir(type_dir_name);
-  if (dir == NULL) {
+  char **file_names;
+  int num_files = replay_dirs.get(type_dir_name, DT_REG, &file_names);
+  if (num_files < 0) {
     // std::abort();
+    free(type_dir_name);
     return 0;
   }
 
-  struct dirent *ent;
-  int num_files = 0;
-  while ((ent = readdir(dir)) != NULL) {
-    if (ent->d_type == DT_REG) {
-      num_files++;
-    }
-  }
-
   if (num_files == 0) {
     fprintf(stderr, "Replay error : No files in directory : %s\n",
             type_dir_name);
     // std::abort();
+    free(type_dir_name);
     return 0;
   }
 
-  char **file_names = (char **)malloc(sizeof(char *) * num_files);
-
-  rewinddir(dir);
-
-  int file_idx = 0;
-  while ((ent = readdir(dir)) != NULL) {
-    if (ent->d_type == DT_REG) {
-      file_names[file_idx++] = ent->d_name;
-    }
-  }
-
-  qsort(file_names, num_files, sizeof(char *), filename_cmp);
-
   int sel_file_idx = id % num_files;
 
   char *file_name = (char *)malloc(strlen(type_dir_name) +
                                    strlen(file_names[sel_file_idx]) + 2);
 
   sprintf(file_name, "%s/%s", type_dir_name, file_names[sel_file_idx]);
-  closedir(dir);
 
   free(type_dir_name);
-  free(file_names);
 
   return file_name;
 }
 
+// Copies the selected carved file to `to_name`, as a reflink where the file
+// system allows it and in the kernel otherwise.
+static void copy_fetched_file(const char *from_name, const char *to_name) {
+  int from_fd = open(from_name, O_RDONLY);
+  if (from_fd < 0) {
+    return;
+  }
+
+  struct stat st;
+  int to_fd = open(to_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if ((to_fd >= 0) && (fstat(from_fd, &st) == 0)) {
+    file_store::copy_file(from_fd, to_fd, st.st_size);
+  }
+
+  if (to_fd >= 0) {
+    close(to_fd);
+  }
+  close(from_fd);
+}
+
 char *__fetch_file(char *name, unsigned int id) {
   if (__carved_obj_dir == NULL) {
     fprintf(stderr, "Replay error : __carved_obj_dir is NULL\n");
@@ -363,169 +171,130 @@ char *__fetch_file(char *name, unsigned int id) {
       (char *)malloc(strlen(__carved_obj_dir) + strlen(name) + 14);
   sprintf(type_dir_name, "%s/carved_file_%s", __carved_obj_dir, name);
 
-  DIR *dir = opendir(type_dir_name);
-  if (dir == NULL) {
+  char **file_names;
+  int num_files = replay_dirs.get(type_dir_name, DT_REG, &file_names);
+  if (num_files < 0) {
     fprintf(stderr, "Replay error : Can't open directory : %s\n",
             type_dir_name);
     // std::abort();
+    free(type_dir_name);
     return 0;
   }
 
-  struct dirent *ent;
-  int num_files = 0;
-  while ((ent = readdir(dir)) != NULL) {
-    if (ent->d_type == DT_REG) {
-      num_files++;
-    }
-  }
-
   if (num_files == 0) {
     fprintf(stderr, "Replay error : No files in directory : %s\n",
             type_dir_name);
     // std::abort();
+    free(type_dir_name);
     return 0;
   }
 
-  char **file_names = (char **)malloc(sizeof(char *) * num_files);
-
-  rewinddir(dir);
-
-  int file_idx = 0;
-  while ((ent = readdir(dir)) != NULL) {
-    if (ent->d_type == DT_REG) {
-      file_names[file_idx++] = ent->d_name;
-    }
-  }
-
-  qsort(file_names, num_files, sizeof(char *), filename_cmp);
-
   int sel_file_idx = id % num_files;
 
   char *file_name = (char *)malloc(strlen(type_dir_name) +
                                    strlen(file_names[sel_file_idx]) + 2);
 
   sprintf(file_name, "%s/%s", type_dir_name, file_names[sel_file_idx]);
-  closedir(dir);
-
-  // copy file
-  FILE *to_fp = fopen(name, "w");
-  FILE *from_fp = fopen(file_name, "r");
-  char buf[1024];
-  size_t nread;
-  while ((nread = fread(buf, 1, sizeof(buf), from_fp)) > 0) {
-    fwrite(buf, 1, nread, to_fp);
-  }
 
-  fclose(to_fp);
-  fclose(from_fp);
+  copy_fetched_file(file_name, name);
 
   free(type_dir_name);
-  free(file_names);
 
   return file_name;
 }
 
-static int cur_input_idx = 0;
-
 void __driver_initialize() {
-  __replay_inputs.clear();
+  replay_reader.close();
+  if (replay_use_arena) {
+    replay_objs.reset();
+  }
   __replay_carved_ptrs.clear();
-  __replay_replayed_ptr.clear();
-  cur_input_idx = 0;
+  __replay_replayed_ptr.clear(0);
   return;
 }
 
 char Replay_char() {
-  auto elem = __replay_inputs[cur_input_idx++];
+  const carved_record *elem = replay_reader.next();
 
-  if ((elem == NULL) || ((*elem)->type != INPUT_TYPE::CHAR)) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::CHAR)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  IVAR *elem_ptr = *elem;
-
-  return ((VAR<char> *)elem_ptr)->input;
+  return elem->value;
 }
 
 short Replay_short() {
-  auto elem = __replay_inputs[cur_input_idx++];
+  const carved_record *elem = replay_reader.next();
 
-  if ((elem == NULL) || ((*elem)->type != INPUT_TYPE::SHORT)) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::SHORT)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  IVAR *elem_ptr = *elem;
-  return ((VAR<short> *)elem_ptr)->input;
+  return elem->value;
 }
 
 int Replay_int() {
-  auto elem = __replay_inputs[cur_input_idx++];
+  const carved_record *elem = replay_reader.next();
 
-  if ((elem == NULL) || ((*elem)->type != INPUT_TYPE::INT)) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::INT)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  IVAR *elem_ptr = *elem;
-  return ((VAR<int> *)elem_ptr)->input;
+  return elem->value;
 }
 
 long Replay_longtype() {
-  auto elem = __replay_inputs[cur_input_idx++];
+  const carved_record *elem = replay_reader.next();
 
-  if ((elem == NULL) || ((*elem)->type != INPUT_TYPE::LONG)) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::LONG)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  IVAR *elem_ptr = *elem;
-
-  return ((VAR<long> *)elem_ptr)->input;
+  return elem->value;
 }
 
 long long Replay_longlong() {
-  auto elem = __replay_inputs[cur_input_idx++];
+  const carved_record *elem = replay_reader.next();
 
-  if ((elem == NULL) || ((*elem)->type != INPUT_TYPE::LONGLONG)) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::LONGLONG)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  IVAR *elem_ptr = *elem;
-  return ((VAR<long long> *)elem_ptr)->input;
+  return elem->value;
 }
 
 float Replay_float() {
-  auto elem = __replay_inputs[cur_input_idx++];
+  const carved_record *elem = replay_reader.next();
 
-  if ((elem == NULL) || ((*elem)->type != INPUT_TYPE::FLOAT)) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::FLOAT)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  IVAR *elem_ptr = *elem;
-  return ((VAR<float> *)elem_ptr)->input;
+  return elem->fvalue;
 }
 
 double Replay_double() {
-  auto elem = __replay_inputs[cur_input_idx++];
+  const carved_record *elem = replay_reader.next();
 
-  if ((elem == NULL) || ((*elem)->type != INPUT_TYPE::DOUBLE)) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::DOUBLE)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  IVAR *elem_ptr = *elem;
-  return ((VAR<double> *)elem_ptr)->input;
+  return elem->fvalue;
 }
 
 int __replay_cur_alloc_size = 0;
@@ -541,8 +310,8 @@ void *Replay_pointer(int default_idx, int default_pointee_size,
     fprintf(stderr, "Replay pointer: %s\n", pointee_type_name);
   }
 
-  auto elem = __replay_inputs[cur_input_idx++];
-  if (elem == NULL) {
+  const carved_record *elem_ptr = replay_reader.next();
+  if (elem_ptr == NULL) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     __replay_cur_alloc_size = 0;
@@ -550,21 +319,19 @@ void *Replay_pointer(int default_idx, int default_pointee_size,
     return 0;
   }
 
-  IVAR *elem_ptr = *elem;
-
-  if (elem_ptr->type == INPUT_TYPE::NULLPTR) {
+  if (elem_ptr->type == RECORD_TYPE::NULLPTR) {
     __replay_cur_alloc_size = 0;
     __replay_cur_pointee_size = -1;
     return 0;
   }
 
-  if (elem_ptr->type == INPUT_TYPE::UNKNOWN_PTR) {
+  if (elem_ptr->type == RECORD_TYPE::UNKNOWN_PTR) {
     // alloc 1 object
 #define ALLOC_1_OBJ
 #ifdef ALLOC_1_OBJ
     __replay_cur_alloc_size = 0;
     __replay_cur_pointee_size = -1;
-    return malloc(default_pointee_size);
+    return replay_alloc(default_pointee_size, 0);
 #else
     __replay_cur_alloc_size = 0;
     __replay_cur_pointee_size = -1;
@@ -572,26 +339,30 @@ void *Replay_pointer(int default_idx, int default_pointee_size,
 #endif
   }
 
-  if (elem_ptr->type != INPUT_TYPE::PTR) {
+  if (elem_ptr->type == RECORD_TYPE::TRUNCATED) {
+    // Carving ran out of budget here, give it one zeroed object.
+    __replay_cur_alloc_size = 0;
+    __replay_cur_pointee_size = -1;
+    return replay_alloc(default_pointee_size, 0);
+  }
+
+  if (elem_ptr->type != RECORD_TYPE::PTR) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     __replay_cur_alloc_size = 0;
     __replay_cur_pointee_size = -1;
     return 0;
   }
 
-  VAR<int> *elem_v = (VAR<int> *)elem_ptr;
-  int ptr_index = elem_v->input;
-  int ptr_offset = elem_v->pointer_offset;
+  int ptr_index = elem_ptr->value;
+  int ptr_offset = elem_ptr->offset;
 
   POINTER *carved_ptr = __replay_carved_ptrs[ptr_index];
 
-  char *search = __replay_replayed_ptr.find(ptr_index);
-  if (search != NULL) {
+  if (__replay_replayed_ptr.test_and_set(ptr_index)) {
     __replay_cur_alloc_size = 0;
     __replay_cur_pointee_size = -1;
     return (char *)carved_ptr->addr + ptr_offset;
   }
-  __replay_replayed_ptr.insert(ptr_index, 0);
 
   __replay_cur_alloc_size = carved_ptr->alloc_size;
   __replay_cur_zero_address = carved_ptr->addr;
@@ -606,48 +377,197 @@ void *Replay_pointer(int default_idx, int default_pointee_size,
   }
 
   // carved ptr has different type
-  int num___replay_class_info = __replay_class_info.size();
-  int idx = 0;
-  for (idx = 0; idx < num___replay_class_info; idx++) {
-    auto __replay_class_info_elem = __replay_class_info.get_by_idx(idx);
-    if (!strcmp(type_name, __replay_class_info_elem->key)) {
-      __replay_cur_pointee_size = __replay_class_info_elem->elem.size;
-      __replay_cur_class_index = __replay_class_info_elem->elem.class_index;
-      break;
-    }
+  int class_idx = __replay_class_names.find(type_name);
+  if (class_idx >= 0) {
+    classinfo *class_info = __replay_class_info[class_idx];
+    __replay_cur_pointee_size = class_info->size;
+    __replay_cur_class_index = class_info->class_index;
   }
 
   return (char *)carved_ptr->addr + ptr_offset;
 }
 
 void *Replay_func_ptr() {
-  auto elem = __replay_inputs[cur_input_idx++];
+  const carved_record *elem = replay_reader.next();
 
-  if ((elem == NULL) || (((*elem)->type != INPUT_TYPE::FUNCPTR) &&
-                         ((*elem)->type != INPUT_TYPE::NULLPTR))) {
+  if ((elem == NULL) || (elem->type != RECORD_TYPE::FUNCPTR)) {
     // fprintf(stderr, "Replay error : Invalid input type\n");
     // std::abort();
     return 0;
   }
 
-  IVAR *elem_ptr = *elem;
-  return ((VAR<void *> *)elem_ptr)->input;
+  int func_idx = __replay_func_names.find(elem->name);
+  if (func_idx >= 0) {
+    return *__replay_func_ptrs[func_idx];
+  }
+
+  // fprintf(stderr, "Replay error : Can't get function name : %s\n",
+  // elem->name);
+  return 0;
 }
 
 void __keep_class_info(char *class_name, int size, int index) {
   classinfo tmp{index, size};
-  __replay_class_info.insert(class_name, tmp);
+  __replay_class_names.insert(class_name, __replay_class_info.size());
+  __replay_class_info.push_back(tmp);
 }
 
 void __record_func_ptr(void *ptr, char *name) {
-  __replay_func_ptrs.insert(ptr, name);
+  __replay_func_names.insert(name, __replay_func_ptrs.size());
+  __replay_func_ptrs.push_back(ptr);
 }
 
 char *__update_class_ptr(char *ptr, int idx, int size) {
   return ptr + (idx * size);
 }
 
+// Next element to replay after `idx`, past the elements a sampling carver
+// left out.
+int __replay_next_elem_idx(int idx, int num_elems) {
+  const carved_record *elem = replay_reader.peek();
+  if ((elem != NULL) && (elem->type == RECORD_TYPE::SKIPPED)) {
+    replay_reader.next();
+    return idx + 1 + elem->value;
+  }
+  return idx + 1;
+}
+
 void __replay_fini() {
-  // TODO free
+  // Objects the target kept a pointer to are gone as well, as they would be
+  // in a new process. Calloc'ed objects are left to the target.
+  if (replay_use_arena) {
+    replay_objs.reset();
+  }
+}
+
+// Persistent replay, one process replays every context given to main.
+
+// Context being replayed, named when the target crashes on it.
+static const char *cur_replay_file = NULL;
+
+static const int crash_signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+
+static void replay_crash_handler(int sig) {
+  if (cur_replay_file != NULL) {
+    const char msg[] = "Replay crashed on input : ";
+    write(STDERR_FILENO, msg, sizeof(msg) - 1);
+    write(STDERR_FILENO, cur_replay_file, strlen(cur_replay_file));
+    write(STDERR_FILENO, "\n", 1);
+  }
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+static void replay_context_file(const char *file_name,
+                                void (*replay_context)(char *)) {
+  __driver_initialize();
+  cur_replay_file = file_name;
+  replay_context((char *)file_name);
+  cur_replay_file = NULL;
+}
+
+static int file_name_ptr_cmp(const void *l, const void *r) {
+  return strcmp(*(char *const *)l, *(char *const *)r);
+}
+
+// Replays the contexts in `dir_name` in name order, not the snapshots and
+// objects under it nor the carving stats.
+static void replay_context_dir(const char *dir_name,
+                               void (*replay_context)(char *)) {
+  DIR *dir = opendir(dir_name);
+  if (dir == NULL) {
+    fprintf(stderr, "Replay error : Can't open directory : %s\n", dir_name);
+    return;
+  }
+
+  char **file_names = NULL;
+  int num_files = 0;
+  int capacity = 0;
+  struct dirent *ent;
+  while ((ent = readdir(dir)) != NULL) {
+    if ((ent->d_type != DT_REG) || (ent->d_name[0] == '.') ||
+        !strncmp(ent->d_name, "carving_stats", 13)) {
+      continue;
+    }
+    if (num_files == capacity) {
+      capacity = capacity == 0 ? 256 : capacity * 2;
+      file_names = (char **)realloc(file_names, sizeof(char *) * capacity);
+    }
+    char *file_name =
+        (char *)malloc(strlen(dir_name) + strlen(ent->d_name) + 2);
+    sprintf(file_name, "%s/%s", dir_name, ent->d_name);
+    file_names[num_files++] = file_name;
+  }
+  closedir(dir);
+
+  qsort(file_names, num_files, sizeof(char *), file_name_ptr_cmp);
+
+  int idx;
+  for (idx = 0; idx < num_files; idx++) {
+    replay_context_file(file_names[idx], replay_context);
+    free(file_names[idx]);
+  }
+  free(file_names);
+}
+
+// Main of the driver. `driver <context>` replays one context as it always
+// did. Given several contexts or a directory of them, and "-" for names read
+// from stdin, it replays all of them in this process. Replay state is reset
+// before each one, the rest of the program state is not. Without
+// REPLAY_ARENA=1 the carved objects of every context stay allocated, the
+// process grows with the number of contexts replayed. With
+// REPLAY_FORK_SERVER=1 it replays each context requested by the controller
+// in a fresh fork instead, see fork_server.hpp.
+int __driver_replay_main(int argc, char **argv,
+                         void (*replay_context)(char *)) {
+  const char *arena_str = getenv("REPLAY_ARENA");
+  if ((arena_str != NULL) && (atoi(arena_str) != 0)) {
+    replay_use_arena = true;
+  }
+
+  char *request = fork_server_run();
+  if (request != NULL) {
+    replay_context(request);
+    return 0;
+  }
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage : %s <context file | dir | -> ...\n", argv[0]);
+    return 1;
+  }
+
+  struct stat st;
+  if ((argc == 2) && (strcmp(argv[1], "-") != 0) &&
+      ((stat(argv[1], &st) != 0) || !S_ISDIR(st.st_mode))) {
+    replay_context(argv[1]);
+    return 0;
+  }
+
+  for (int sig : crash_signals) {
+    signal(sig, replay_crash_handler);
+  }
+
+  int arg_idx;
+  for (arg_idx = 1; arg_idx < argc; arg_idx++) {
+    const char *arg = argv[arg_idx];
+    if (!strcmp(arg, "-")) {
+      char *line = NULL;
+      size_t len = 0;
+      ssize_t read;
+      while ((read = getline(&line, &len, stdin)) != -1) {
+        line[strcspn(line, "\n")] = 0;
+        if (line[0] != 0) {
+          replay_context_file(line, replay_context);
+        }
+      }
+      free(line);
+    } else if ((stat(arg, &st) == 0) && S_ISDIR(st.st_mode)) {
+      replay_context_dir(arg, replay_context);
+    } else {
+      replay_context_file(arg, replay_context);
+    }
+  }
+
+  return 0;
 }
 }
\ No newline at end of file
@@ -28,6 +28,9 @@ class driver_pass : public ModulePass {
       return true;
     }
 
+    const char *libfuzzer_str = getenv("FUZZ_DRIVER_LIBFUZZER");
+    libfuzzer_mode = (libfuzzer_str != NULL) && (atoi(libfuzzer_str) != 0);
+
     get_llvm_types();
 
     get_driver_func_callees();
@@ -89,8 +92,14 @@ class driver_pass : public ModulePass {
   Function *target_func;
   std::vector<Function *> func_list;
 
+  // FUZZ_DRIVER_LIBFUZZER=1 : emit LLVMFuzzerTestOneInput instead of a main
+  // replaying one input file
+  bool libfuzzer_mode = false;
+
   bool get_target_func();
   void instrument_main_func(Function *main_func);
+  void instrument_libfuzzer_entry(Function *main_func);
+  void insert_target_call();
   void dump_func_info();
 };
 
@@ -178,6 +187,11 @@ void driver_pass::instrument_main_func(Function *main_func) {
                      ConstantInt::get(Int32Ty, iter.second.first)});
   }
 
+  if (libfuzzer_mode) {
+    instrument_libfuzzer_entry(main_func);
+    return;
+  }
+
   Value *argv = main_func->getArg(1);
   Value *argv_1 = IRB->CreateGEP(Int8PtrTy, argv, ConstantInt::get(Int32Ty, 1));
   argv_1 = IRB->CreateLoad(Int8PtrTy, argv_1);
@@ -187,8 +201,50 @@ void driver_pass::instrument_main_func(Function *main_func) {
 
   IRB->CreateCall(input_fb_open, {argv_1});
 
+  insert_target_call();
+
+  IRB->CreateRet(ConstantInt::get(Int32Ty, 0));
+}
+
+// libFuzzer owns main, the setup emitted so far becomes
+// LLVMFuzzerInitialize and each input is replayed in process by
+// LLVMFuzzerTestOneInput.
+void driver_pass::instrument_libfuzzer_entry(Function *main_func) {
+  FunctionType *init_type =
+      FunctionType::get(Int32Ty, {Int32PtrTy, Int8PtrPtrTy->getPointerTo()},
+                        false);
+  Function *init_func =
+      Function::Create(init_type, GlobalValue::LinkageTypes::ExternalLinkage,
+                       "LLVMFuzzerInitialize", Mod);
+  IRB->CreateRet(ConstantInt::get(Int32Ty, 0));
+  init_func->getBasicBlockList().splice(init_func->end(),
+                                        main_func->getBasicBlockList());
+
+  // The target's main stays for its callers, it does nothing anymore.
+  main_func->setName("__Replay__main");
+  main_func->setLinkage(GlobalValue::LinkageTypes::InternalLinkage);
+  IRB->SetInsertPoint(BasicBlock::Create(*Context, "entry", main_func));
+  IRB->CreateRet(ConstantInt::get(Int32Ty, 0));
+
+  FunctionType *test_type =
+      FunctionType::get(Int32Ty, {Int8PtrTy, Int64Ty}, false);
+  Function *test_func =
+      Function::Create(test_type, GlobalValue::LinkageTypes::ExternalLinkage,
+                       "LLVMFuzzerTestOneInput", Mod);
+  IRB->SetInsertPoint(BasicBlock::Create(*Context, "entry", test_func));
+
+  FunctionCallee input_fb_set = Mod->getOrInsertFunction(
+      get_link_name("__driver_inputfb_set"), VoidTy, Int8PtrTy, Int64Ty);
+
+  IRB->CreateCall(input_fb_set, {test_func->getArg(0), test_func->getArg(1)});
+
+  insert_target_call();
+
+  IRB->CreateRet(ConstantInt::get(Int32Ty, 0));
+}
+
+void driver_pass::insert_target_call() {
   std::vector<Value *> target_args;
-  int arg_idx = 0;
   for (auto &arg : target_func->args()) {
     Type *arg_type = arg.getType();
     Value *replay_res = insert_replay_probe(arg_type, NULL);
@@ -208,15 +264,12 @@ void driver_pass::instrument_main_func(Function *main_func) {
     }
   }
 
-  CallInst *target_call =
-      IRB->CreateCall(target_func->getFunctionType(), target_func, target_args);
+  IRB->CreateCall(target_func->getFunctionType(), target_func, target_args);
 
   target_func->setSubprogram(0);
 
   // Return
   IRB->CreateCall(__replay_fini, {});
-
-  IRB->CreateRet(ConstantInt::get(Int32Ty, 0));
 }
 
 bool driver_pass::get_target_func() {
@@ -1,30 +1,55 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "utils/data_utils.hpp"
+#include "utils/replay_arena.hpp"
 
 extern vector<POINTER> __replay_carved_ptrs;
-extern map<char *, classinfo> __replay_class_info;
-extern map<int, char *> __replay_replayed_ptr;
+
+// Pointee type each pointer table index was first replayed as
+static map<int, char *> __replay_replayed_ptr;
 
 static vector<void *> func_ptr_index;
 
-static FILE *input_fp = NULL;
+// Fuzz input being replayed, the Replay_*2 probes consume it from the
+// cursor. It is the whole input file, or the libFuzzer buffer.
+static const unsigned char *input_cur = NULL;
+static const unsigned char *input_end = NULL;
+
+static unsigned char *input_file_buf = NULL;
+
+// Pointees of the input being replayed, freed when the next one is set.
+static replay_arena input_objs;
 
 #define MAX_NUM_PTRS 1000
 #define MAX_ALLOC_SIZE (1024)
 
+static bool read_input(void *val, size_t size) {
+  if ((size_t)(input_end - input_cur) < size) {
+    input_cur = input_end;
+    return false;
+  }
+  memcpy(val, input_cur, size);
+  input_cur += size;
+  return true;
+}
+
 extern "C" {
 
-void __driver_inputfb_open(char *inputfname) {
-  input_fp = fopen(inputfname, "rb");
-  if (input_fp == NULL) {
-    fprintf(stderr, "Can't read input file\n");
-    std::abort();
-  }
+// Starts replaying `data`. Reads the pointer table at its head and resets
+// the replay state of the previous input, so it can be called once per
+// libFuzzer iteration.
+void __driver_inputfb_set(const unsigned char *data, size_t size) {
+  input_objs.reset();
+  __replay_carved_ptrs.clear();
+  __replay_replayed_ptr.clear();
+
+  input_cur = data;
+  input_end = data + size;
 
   int num_ptrs = 0;
-  if (!fread(&num_ptrs, sizeof(int), 1, input_fp)) {
+  if (!read_input(&num_ptrs, sizeof(int))) {
     return;
   }
 
@@ -33,7 +58,7 @@ void __driver_inputfb_open(char *inputfname) {
   int index;
   for (index = 0; index < num_ptrs; index++) {
     int size = 0;
-    if (!fread(&size, sizeof(int), 1, input_fp)) {
+    if (!read_input(&size, sizeof(int))) {
       return;
     }
 
@@ -43,7 +68,7 @@ void __driver_inputfb_open(char *inputfname) {
       continue;
     }
 
-    void *new_addr = malloc(size);
+    void *new_addr = input_objs.alloc(size, 0);
     POINTER ptr{new_addr, size};
     __replay_carved_ptrs.push_back(ptr);
   }
@@ -51,11 +76,40 @@ void __driver_inputfb_open(char *inputfname) {
   return;
 }
 
+void __driver_inputfb_open(char *inputfname) {
+  FILE *input_fp = fopen(inputfname, "rb");
+  if (input_fp == NULL) {
+    fprintf(stderr, "Can't read input file\n");
+    std::abort();
+  }
+
+  fseek(input_fp, 0, SEEK_END);
+  long size = ftell(input_fp);
+  fseek(input_fp, 0, SEEK_SET);
+  if (size < 0) {
+    size = 0;
+  }
+
+  free(input_file_buf);
+  input_file_buf = (unsigned char *)malloc(size + 1);
+  size = fread(input_file_buf, 1, size, input_fp);
+  fclose(input_fp);
+
+  __driver_inputfb_set(input_file_buf, size);
+}
+
 void __record_func_ptr_index(void *ptr) { func_ptr_index.push_back(ptr); }
 
+// Fuzz inputs have no SKIPPED records, every element is replayed. Weak as
+// driver.a, linked for the class replay helpers, defines it for carved
+// files.
+__attribute__((weak)) int __replay_next_elem_idx(int idx, int num_elems) {
+  return idx + 1;
+}
+
 char Replay_char2() {
   char val;
-  if (!fread(&val, sizeof(char), 1, input_fp)) {
+  if (!read_input(&val, sizeof(char))) {
     return 0;
   }
 
@@ -64,7 +118,7 @@ char Replay_char2() {
 
 short Replay_short2() {
   short val;
-  if (!fread(&val, sizeof(short), 1, input_fp)) {
+  if (!read_input(&val, sizeof(short))) {
     return 0;
   }
 
@@ -73,7 +127,7 @@ short Replay_short2() {
 
 int Replay_int2() {
   int val;
-  if (!fread(&val, sizeof(int), 1, input_fp)) {
+  if (!read_input(&val, sizeof(int))) {
     return 0;
   }
 
@@ -82,7 +136,7 @@ int Replay_int2() {
 
 long Replay_long2() {
   long val;
-  if (!fread(&val, sizeof(long), 1, input_fp)) {
+  if (!read_input(&val, sizeof(long))) {
     return 0;
   }
 
@@ -91,7 +145,7 @@ long Replay_long2() {
 
 float Replay_float2() {
   float val;
-  if (!fread(&val, sizeof(float), 1, input_fp)) {
+  if (!read_input(&val, sizeof(float))) {
     return 0;
   }
 
@@ -100,7 +154,7 @@ float Replay_float2() {
 
 double Replay_double2() {
   double val;
-  if (!fread(&val, sizeof(double), 1, input_fp)) {
+  if (!read_input(&val, sizeof(double))) {
     return 0;
   }
 
@@ -109,7 +163,7 @@ double Replay_double2() {
 
 long long Replay_longlong2() {
   long long val;
-  if (!fread(&val, sizeof(long long), 1, input_fp)) {
+  if (!read_input(&val, sizeof(long long))) {
     return 0;
   }
 
@@ -124,7 +178,7 @@ extern void *__replay_cur_zero_address;
 void *Replay_pointer2(int default_idx, int default_pointee_size,
                       char *pointee_type_name) {
   int ptr_idx;
-  if (!fread(&ptr_idx, sizeof(int), 1, input_fp)) {
+  if (!read_input(&ptr_idx, sizeof(int))) {
     __replay_cur_alloc_size = 0;
     __replay_cur_pointee_size = -1;
     return NULL;
@@ -147,7 +201,7 @@ void *Replay_pointer2(int default_idx, int default_pointee_size,
   ptr_idx = ptr_idx % num_carved_ptrs;
 
   int offset;
-  if (!fread(&offset, sizeof(int), 1, input_fp)) {
+  if (!read_input(&offset, sizeof(int))) {
     __replay_cur_alloc_size = 0;
     __replay_cur_pointee_size = -1;
     return NULL;
@@ -190,8 +244,12 @@ void *Replay_pointer2(int default_idx, int default_pointee_size,
 }
 
 void *Replay_func_ptr2() {
+  if (func_ptr_index.size() == 0) {
+    return NULL;
+  }
+
   int val;
-  if (!fread(&val, sizeof(int), 1, input_fp)) {
+  if (!read_input(&val, sizeof(int))) {
     return NULL;
   }
 
@@ -2,8 +2,8 @@
 
 namespace {
 
-FunctionCallee replay_record_bb;
 FunctionCallee replay_cov_fini;
+FunctionCallee replay_main;
 
 class driver_pass : public ModulePass {
 
@@ -31,10 +31,6 @@ class driver_pass : public ModulePass {
   void instrument_main_func(Function * main_func);
   bool instrument_module();
 
-  // To measure coverage
-  std::map<std::string, std::map<std::string, std::set<std::string>>>
-      file_bb_map;
-
   void instrument_bb_cov(llvm::Function *, const std::string &, const std::string &);
 
   static std::map<std::string, llvm::Constant *> new_string_globals;
@@ -85,7 +81,10 @@ bool driver_pass::hookInstrs(Module &M) {
     return false;
   }
 
-  instrument_module();
+  if (!instrument_module()) {
+    delete IRB;
+    return false;
+  }
 
   // instrument_main_func(main_func);
 
@@ -100,8 +99,6 @@ bool driver_pass::hookInstrs(Module &M) {
 }
 
 bool driver_pass::instrument_module() {
-  replay_record_bb = Mod->getOrInsertFunction("__record_bb_cov", VoidTy, Int8PtrTy,
-                                      Int8PtrTy, Int8PtrTy);
   replay_cov_fini = Mod->getOrInsertFunction("__cov_fini", VoidTy);
 
   Function * main_func = NULL;
@@ -124,6 +121,7 @@ bool driver_pass::instrument_module() {
     }
 
     if (func_name == "main") {
+      main_func = &F;
       instrument_main_func(&F);
 
       std::set<llvm::ReturnInst *> ret_inst_set;
@@ -165,43 +163,21 @@ bool driver_pass::instrument_module() {
     instrument_bb_cov(&F, filename, func_name);
   }
 
-  for (auto iter : file_bb_map) {
-    std::string filename = iter.first;
-
-    std::string cov_filename = filename + ".cov";
-    std::ofstream cov_file(cov_filename);
-
-    for (auto iter2 : iter.second) {
-      const std::set<std::string> &bb_set = iter2.second;
-      cov_file << "F " << iter2.first << " " << false << "\n";
-      for (auto &bb_name : bb_set) {
-        cov_file << "b " << bb_name << " " << false << "\n";
-      }
-    }
-
-    cov_file.close();
+  if (main_func == NULL) {
+    DEBUG0("FATAL : main function not found.\n");
+    return false;
   }
 
+  insert_bb_cov_bind(main_func);
+
   return true;
 }
 
 void driver_pass::instrument_bb_cov(llvm::Function *F, const std::string &filename,
                                     const std::string &func_name) {
-  if (file_bb_map.find(filename) == file_bb_map.end()) {
-    file_bb_map.insert({filename, {}});
-  }
-
-  if (file_bb_map[filename].find(func_name) == file_bb_map[filename].end()) {
-    file_bb_map[filename].insert({func_name, {}});
-  }
-
-  llvm::Constant *filename_const = gen_new_string_constant(filename, IRB);
-  llvm::Constant *func_name_const = gen_new_string_constant(func_name, IRB);
-
-  std::set<std::string> &cur_bb_set = file_bb_map[filename][func_name];
-
   llvm::errs() << "Instrumenting " << func_name << " in " << filename << "\n";
 
+  std::vector<std::pair<llvm::Instruction *, std::string>> cov_blocks;
   int bb_index = 0;
   for (auto &BB : F->getBasicBlockList()) {
     llvm::Instruction *first_inst = BB.getFirstNonPHIOrDbgOrLifetime();
@@ -216,14 +192,11 @@ void driver_pass::instrument_bb_cov(llvm::Function *F, const std::string &filena
     // string BB_name = BB.getName().str();
     std::string BB_name = func_name + "_" + std::to_string(bb_index++);
 
-    cur_bb_set.insert(BB_name);
-
-    IRB->SetInsertPoint(first_inst);
-    llvm::Constant *bb_name_const = gen_new_string_constant(BB_name, IRB);
-    IRB->CreateCall(replay_record_bb,
-                    {filename_const, func_name_const, bb_name_const});
+    cov_blocks.push_back(std::make_pair(first_inst, BB_name));
   }
 
+  insert_bb_cov_counters(filename, func_name, cov_blocks);
+
   // Insert cov fini
   for (auto &BB : F->getBasicBlockList()) {
     for (auto &IN : BB) {
@@ -250,22 +223,6 @@ void driver_pass::instrument_bb_cov(llvm::Function *F, const std::string &filena
 
 void driver_pass::instrument_main_func(Function * main_func) {
 
-  const DebugLoc * debug_loc = NULL;
-
-  //get random debug info...
-  for (auto &BB : main_func->getBasicBlockList()) {
-    for (auto &IN : BB) {
-      if (isa<CallInst>(&IN)) {
-        CallInst * CI = cast<CallInst>(&IN);
-        const DebugLoc & DL = CI->getDebugLoc();
-        debug_loc = &DL;
-        break;
-      }
-    }
-
-    if (debug_loc != NULL) { break; }
-  }
-
   //remove all BBs
   std::vector<BasicBlock *> BBs;
   for (auto &BB: main_func->getBasicBlockList()) {
@@ -306,11 +263,25 @@ void driver_pass::instrument_main_func(Function * main_func) {
       , ConstantInt::get(Int32Ty, iter.second.first)});
   }
 
-  Value * argv = main_func->getArg(1);
-  Value * argv_1 = IRB->CreateGEP(Int8PtrTy, argv, ConstantInt::get(Int32Ty, 1));
-  argv_1 = IRB->CreateLoad(Int8PtrTy, argv_1);
+  // Replaying one context is outlined, __driver_replay_main calls it once
+  // per context given on the command line.
+  FunctionType * replay_ctx_type =
+    FunctionType::get(VoidTy, {Int8PtrTy}, false);
+  Function * replay_ctx_func = Function::Create(replay_ctx_type
+    , GlobalValue::LinkageTypes::InternalLinkage, "__Replay__context", Mod);
 
-  IRB->CreateCall(__inputf_open, {argv_1});
+  replay_main = Mod->getOrInsertFunction("__driver_replay_main", Int32Ty
+    , Int32Ty, Int8PtrPtrTy, replay_ctx_type->getPointerTo());
+
+  Value * replay_res = IRB->CreateCall(replay_main, {main_func->getArg(0)
+    , main_func->getArg(1), replay_ctx_func});
+  IRB->CreateRet(replay_res);
+
+  BasicBlock * replay_ctx_block =
+    BasicBlock::Create(*Context, "entry", replay_ctx_func);
+  IRB->SetInsertPoint(replay_ctx_block);
+
+  IRB->CreateCall(__inputf_open, {replay_ctx_func->getArg(0)});
 
   std::vector<Value *> target_args;
   int arg_idx = 0;
@@ -333,15 +304,13 @@ void driver_pass::instrument_main_func(Function * main_func) {
     }
   }
 
-  CallInst * target_call = IRB->CreateCall(
-    target_func->getFunctionType(), target_func, target_args);
-  
-  target_call->setDebugLoc(*debug_loc);
-  
+  // No debug location, the caller has no debug info of its own.
+  IRB->CreateCall(target_func->getFunctionType(), target_func, target_args);
+
   //Return
   IRB->CreateCall(__replay_fini, {});
 
-  IRB->CreateRet(ConstantInt::get(Int32Ty, 0));
+  IRB->CreateRetVoid();
 }
 
 bool driver_pass::runOnModule(Module &M) {
@@ -1 +1,10 @@
-#include "utils/data_utils.hpp"
\ No newline at end of file
+#include "utils/data_utils.hpp"
+
+extern "C" {
+
+// Mocked inputs have no SKIPPED records, every element is replayed. Weak
+// as driver.a defines it for carved files.
+__attribute__((weak)) int __replay_next_elem_idx(int idx, int num_elems) {
+  return idx + 1;
+}
+}
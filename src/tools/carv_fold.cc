@@ -0,0 +1,175 @@
+// carv-fold : folds the crash mode journal into model carver contexts.
+//
+//   carv-fold <carved_ctx_dir | context>...
+//
+// With `-crash`, the model carver dumps a context once on the first read
+// and appends a `+ p<ptr_idx>[<elem_idx>]` line for every element read
+// after it (see m_carver.cc). A run that returns rewrites the context with
+// these reads folded in, a run that crashes in the callee leaves them in
+// the journal. Every context given, or found directly in a given
+// directory, that ends with a journal is rewritten as __carv_close would
+// have dumped it: the `PTR_IDX` line of each journaled element and the
+// values of the element are marked as reached (`%`). A journal line cut
+// short by the crash is dropped.
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef std::set<std::pair<int, int>> reached_elems;
+
+static bool ignore_file_name(const char *name) {
+  return (name[0] == '.') || !strncmp(name, "carving_stats", 13);
+}
+
+// Content of a dump line, after the reached flag and the indent
+static const char *line_content(const std::string &line) {
+  const char *content = line.c_str() + 1;
+  while (*content == ' ') {
+    content++;
+  }
+  return content;
+}
+
+// -1 if the file can't be folded, else the number of journal lines folded
+static int fold_context(const char *path) {
+  std::ifstream infile(path);
+  if (!infile.is_open()) {
+    return -1;
+  }
+
+  std::vector<std::string> dump_lines;
+  reached_elems journal;
+  int num_journal_lines = 0;
+  std::string line;
+  while (std::getline(infile, line)) {
+    // The last line has no line break if the crash cut its write short.
+    bool complete = !infile.eof();
+    if (line[0] == '+') {
+      int ptr_idx, elem_idx;
+      if (complete &&
+          (sscanf(line.c_str(), "+ p%d[%d]", &ptr_idx, &elem_idx) == 2)) {
+        journal.insert(std::make_pair(ptr_idx, elem_idx));
+      }
+      num_journal_lines++;
+      continue;
+    }
+    if (num_journal_lines != 0) {
+      fprintf(stderr, "Error: %s has dump lines after its journal\n", path);
+      return -1;
+    }
+    dump_lines.push_back(line);
+  }
+  infile.close();
+
+  if (num_journal_lines == 0) {
+    return 0;
+  }
+
+  std::string tmp_path = std::string(path) + ".fold";
+  std::ofstream outfile(tmp_path);
+  if (!outfile.is_open()) {
+    return -1;
+  }
+
+  // Same walk as dump_result, a PTR_IDX line sets the flag of the values
+  // after it, up to the next PTR_IDX.
+  std::vector<int> ptr_stack;
+  bool print_obj = false;
+  for (std::string &dump_line : dump_lines) {
+    if ((dump_line.size() < 2) || (dump_line[1] != ' ')) {
+      outfile << dump_line << '\n';
+      continue;
+    }
+
+    const char *content = line_content(dump_line);
+    bool reached = dump_line[0] == '%';
+    if (!strncmp(content, "PTR_BEGIN ", 10)) {
+      ptr_stack.push_back(atoi(content + 10));
+    } else if (!strncmp(content, "PTR_END ", 8)) {
+      if (!ptr_stack.empty()) {
+        ptr_stack.pop_back();
+      }
+    } else if (!strncmp(content, "PTR_ADDR ", 9) ||
+               !strncmp(content, "PAGE ", 5)) {
+      // Pointer table and pages of -lazy-pages, no per element flags
+    } else if (!strncmp(content, "PTR_IDX ", 8)) {
+      if (!ptr_stack.empty()) {
+        int elem_idx = atoi(content + 8);
+        reached |= journal.count(std::make_pair(ptr_stack.back(), elem_idx));
+      }
+      print_obj = reached;
+    } else {
+      reached |= print_obj;
+    }
+
+    dump_line[0] = reached ? '%' : '-';
+    outfile << dump_line << '\n';
+  }
+
+  outfile.close();
+  if (outfile.fail() || (rename(tmp_path.c_str(), path) != 0)) {
+    unlink(tmp_path.c_str());
+    return -1;
+  }
+  return num_journal_lines;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage : %s <carved_ctx_dir | context>...\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<std::string> contexts;
+  for (int idx = 1; idx < argc; idx++) {
+    struct stat st;
+    if (stat(argv[idx], &st) != 0) {
+      fprintf(stderr, "Error: Can't find %s\n", argv[idx]);
+      return 1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+      contexts.push_back(argv[idx]);
+      continue;
+    }
+
+    DIR *dir = opendir(argv[idx]);
+    if (dir == NULL) {
+      fprintf(stderr, "Error: Can't read %s\n", argv[idx]);
+      return 1;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+      if ((ent->d_type != DT_REG) || ignore_file_name(ent->d_name)) {
+        continue;
+      }
+      contexts.push_back(std::string(argv[idx]) + "/" + ent->d_name);
+    }
+    closedir(dir);
+  }
+
+  int res = 0;
+  unsigned long num_folded = 0;
+  for (const std::string &context : contexts) {
+    int num_journal_lines = fold_context(context.c_str());
+    if (num_journal_lines < 0) {
+      fprintf(stderr, "Error: Failed to fold %s\n", context.c_str());
+      res = 1;
+    } else if (num_journal_lines > 0) {
+      num_folded++;
+    }
+  }
+
+  printf("folded %lu of %lu contexts\n", num_folded,
+         (unsigned long)contexts.size());
+  return res;
+}
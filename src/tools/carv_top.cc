@@ -0,0 +1,201 @@
+// carv-top : live view of a running carver.
+//
+//   carv-top <carve output dir | carving_stats.live> [interval ms]
+//
+// Attaches to the stats file the carver runtime maps into its output
+// directory (see utils/carv_live.hpp) and refreshes a summary and the
+// busiest functions until the carver finishes or exits.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "utils/carv_live.hpp"
+
+#define NUM_TOP_UNITS 20
+
+static unsigned long now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((unsigned long)ts.tv_sec) * 1000000000UL + ts.tv_nsec;
+}
+
+static const char *human_bytes(unsigned long bytes, char *buf, int buf_size) {
+  const char *units[] = {"B", "KB", "MB", "GB", "TB"};
+  double val = bytes;
+  int idx = 0;
+  while ((val >= 1024.0) && (idx < 4)) {
+    val /= 1024.0;
+    idx++;
+  }
+  snprintf(buf, buf_size, "%.1f%s", val, units[idx]);
+  return buf;
+}
+
+typedef struct unit_view_ {
+  int id;
+  unsigned long calls;
+  unsigned long carved;
+  unsigned long bytes;
+  // Since the previous refresh
+  unsigned long delta_calls;
+} unit_view;
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <carve output dir | %s> [interval ms]\n",
+            argv[0], CARV_LIVE_FILE_NAME);
+    return 1;
+  }
+
+  char live_file_name[512];
+  struct stat st;
+  if ((stat(argv[1], &st) == 0) && S_ISDIR(st.st_mode)) {
+    snprintf(live_file_name, 512, "%s/%s", argv[1], CARV_LIVE_FILE_NAME);
+  } else {
+    snprintf(live_file_name, 512, "%s", argv[1]);
+  }
+
+  int interval_ms = 1000;
+  if (argc > 2) {
+    interval_ms = atoi(argv[2]);
+    if (interval_ms <= 0) {
+      interval_ms = 1000;
+    }
+  }
+
+  int fd = open(live_file_name, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Error: Can't open %s, errno : %s\n", live_file_name,
+            strerror(errno));
+    return 1;
+  }
+
+  if ((fstat(fd, &st) != 0) ||
+      (st.st_size < (off_t)sizeof(carv_live_segment))) {
+    fprintf(stderr, "Error: %s is not a carving stats file\n", live_file_name);
+    close(fd);
+    return 1;
+  }
+
+  carv_live_segment *live = (carv_live_segment *)mmap(
+      NULL, sizeof(carv_live_segment), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (live == MAP_FAILED) {
+    fprintf(stderr, "Error: Failed to map %s, errno : %s\n", live_file_name,
+            strerror(errno));
+    return 1;
+  }
+
+  carv_live_header *header = &live->header;
+  if ((__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != CARV_LIVE_MAGIC) ||
+      (header->version != CARV_LIVE_VERSION)) {
+    fprintf(stderr, "Error: %s is not a carving stats file\n", live_file_name);
+    munmap(live, sizeof(carv_live_segment));
+    return 1;
+  }
+
+  std::vector<unsigned long> prev_unit_calls(CARV_LIVE_MAX_UNITS, 0);
+  unsigned long prev_ns = now_ns();
+  unsigned long prev_carved = CARV_LIVE_LOAD(header->carved);
+  unsigned long prev_bytes = CARV_LIVE_LOAD(header->bytes);
+
+  while (1) {
+    usleep(interval_ms * 1000);
+
+    bool finished = __atomic_load_n(&header->finished, __ATOMIC_ACQUIRE);
+    bool alive = (kill(header->pid, 0) == 0) || (errno == EPERM);
+
+    unsigned long cur_ns = now_ns();
+    double elapsed_s = (cur_ns - prev_ns) / 1e9;
+    double run_s = (cur_ns - header->start_ns) / 1e9;
+
+    unsigned long carved = CARV_LIVE_LOAD(header->carved);
+    unsigned long bytes = CARV_LIVE_LOAD(header->bytes);
+
+    char buf1[32], buf2[32];
+
+    printf("\033[H\033[2J");
+    printf("carv-top  %s  pid %d (%s)  up %.0fs\n\n", header->carver,
+           header->pid,
+           finished ? "finished" : (alive ? "running" : "exited"), run_s);
+    printf("contexts : %lu calls, %lu carved (%.1f/s), %lu skipped, %lu "
+           "deduped\n",
+           CARV_LIVE_LOAD(header->calls), carved,
+           (carved - prev_carved) / elapsed_s, CARV_LIVE_LOAD(header->skipped),
+           CARV_LIVE_LOAD(header->deduped));
+    printf("written  : %s (%s/s), %lu records\n",
+           human_bytes(bytes, buf1, 32),
+           human_bytes((bytes - prev_bytes) / elapsed_s, buf2, 32),
+           CARV_LIVE_LOAD(header->records));
+    printf("depth    : %lu open contexts, %lu pending shm events, %lu "
+           "dropped\n",
+           CARV_LIVE_LOAD(header->ctx_depth),
+           CARV_LIVE_LOAD(header->shm_pending),
+           CARV_LIVE_LOAD(header->dropped_shm_events));
+    printf("ptr_map  : %lu live nodes\n\n",
+           CARV_LIVE_LOAD(header->ptr_map_nodes));
+
+    int num_units = __atomic_load_n(&header->num_units, __ATOMIC_ACQUIRE);
+    if (num_units > CARV_LIVE_MAX_UNITS) {
+      num_units = CARV_LIVE_MAX_UNITS;
+    }
+
+    std::vector<unit_view> views;
+    for (int idx = 0; idx < num_units; idx++) {
+      carv_live_unit *cur = &live->units[idx];
+      unsigned long calls = CARV_LIVE_LOAD(cur->calls);
+      if (calls == 0) {
+        continue;
+      }
+      views.push_back({idx, calls, CARV_LIVE_LOAD(cur->carved),
+                       CARV_LIVE_LOAD(cur->bytes),
+                       calls - prev_unit_calls[idx]});
+      prev_unit_calls[idx] = calls;
+    }
+
+    // Busiest first, then by total calls
+    std::sort(views.begin(), views.end(),
+              [](const unit_view &l, const unit_view &r) {
+                if (l.delta_calls != r.delta_calls) {
+                  return l.delta_calls > r.delta_calls;
+                }
+                return l.calls > r.calls;
+              });
+
+    printf("%10s %12s %10s %10s  %s\n", "calls/s", "calls", "carved",
+           "bytes", "name");
+    for (size_t idx = 0; (idx < views.size()) && (idx < NUM_TOP_UNITS);
+         idx++) {
+      unit_view *view = &views[idx];
+      char name[CARV_LIVE_NAME_LEN];
+      memcpy(name, live->units[view->id].name, CARV_LIVE_NAME_LEN);
+      name[CARV_LIVE_NAME_LEN - 1] = 0;
+      printf("%10.1f %12lu %10lu %10s  %s\n", view->delta_calls / elapsed_s,
+             view->calls, view->carved, human_bytes(view->bytes, buf1, 32),
+             name);
+    }
+    fflush(stdout);
+
+    prev_ns = cur_ns;
+    prev_carved = carved;
+    prev_bytes = bytes;
+
+    if (finished || !alive) {
+      break;
+    }
+  }
+
+  munmap(live, sizeof(carv_live_segment));
+  return 0;
+}
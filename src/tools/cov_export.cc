@@ -0,0 +1,164 @@
+// cov-export : text coverage reports from a replay coverage map.
+//
+//   cov-export <module>.cov_layout [<module>.covmap]
+//
+// Writes `<source file>.cov` for every source file in the layout, an
+// `F <function> <0|1>` line per function followed by a `B <block> <0|1>`
+// line per block, and prints the number of covered blocks. The map
+// defaults to the one next to the layout (see utils/cov_map.hpp), a
+// missing map reports nothing covered.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "utils/cov_map.hpp"
+
+// Covered flag of each block, by function, by source file
+typedef std::map<std::string, std::map<std::string, bool>> func_cov;
+typedef std::map<std::string, func_cov> file_cov;
+
+// Every block line takes the next block id, see cov_map.hpp.
+static bool is_block_line(const std::string &line) {
+  return (line.size() > 2) && (line[0] == 'B') && (line[1] == ' ');
+}
+
+int main(int argc, char **argv) {
+  if ((argc != 2) && (argc != 3)) {
+    fprintf(stderr, "Usage : %s <module%s> [<module%s>]\n", argv[0],
+            COV_LAYOUT_SUFFIX, COV_MAP_SUFFIX);
+    return 1;
+  }
+
+  std::string layout_path = argv[1];
+  std::ifstream layout_file(layout_path);
+  if (!layout_file.is_open()) {
+    fprintf(stderr, "Can't read %s\n", layout_path.c_str());
+    return 1;
+  }
+  std::stringstream layout_buf;
+  layout_buf << layout_file.rdbuf();
+  const std::string layout = layout_buf.str();
+
+  std::string map_path;
+  if (argc == 3) {
+    map_path = argv[2];
+  } else {
+    size_t suffix_len = strlen(COV_LAYOUT_SUFFIX);
+    if ((layout_path.size() > suffix_len) &&
+        (layout_path.compare(layout_path.size() - suffix_len, suffix_len,
+                             COV_LAYOUT_SUFFIX) == 0)) {
+      layout_path.resize(layout_path.size() - suffix_len);
+    }
+    map_path = layout_path + COV_MAP_SUFFIX;
+  }
+
+  unsigned long num_bbs = 0;
+  std::istringstream lines(layout);
+  std::string line;
+  while (getline(lines, line)) {
+    if (is_block_line(line)) {
+      num_bbs++;
+    }
+  }
+
+  const unsigned char *bits = NULL;
+  void *base = MAP_FAILED;
+  size_t map_size = COV_MAP_SIZE(num_bbs);
+  int fd = open(map_path.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    struct stat st;
+    if ((fstat(fd, &st) == 0) && ((size_t)st.st_size == map_size)) {
+      base = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (base == MAP_FAILED) {
+      fprintf(stderr, "%s does not match %s\n", map_path.c_str(),
+              argv[1]);
+      return 1;
+    }
+
+    const cov_map_header *header = (const cov_map_header *)base;
+    if ((header->magic != COV_MAP_MAGIC) ||
+        (header->version != COV_MAP_VERSION) ||
+        (header->layout_hash !=
+         hash_cov_layout(layout.data(), layout.size())) ||
+        (header->num_bbs != num_bbs)) {
+      fprintf(stderr, "%s does not match %s\n", map_path.c_str(),
+              argv[1]);
+      return 1;
+    }
+    bits = (const unsigned char *)base + sizeof(cov_map_header);
+  }
+
+  file_cov cov;
+  func_cov *cur_file = NULL;
+  std::map<std::string, bool> *cur_func = NULL;
+  unsigned long bb_id = 0;
+  unsigned long num_covered = 0;
+
+  lines.clear();
+  lines.seekg(0);
+  while (getline(lines, line)) {
+    if (is_block_line(line)) {
+      // A block outside of a function keeps its id but is not reported.
+      bool is_covered =
+          (bits != NULL) && ((bits[bb_id / 8] >> (bb_id % 8)) & 1);
+      if (cur_func != NULL) {
+        (*cur_func)[line.substr(2)] |= is_covered;
+        num_covered += is_covered;
+      }
+      bb_id++;
+      continue;
+    }
+
+    if (line.size() < 2) {
+      continue;
+    }
+    const std::string name = line.substr(2);
+    if (line[0] == 'S') {
+      cur_file = &cov[name];
+      cur_func = NULL;
+    } else if ((line[0] == 'F') && (cur_file != NULL)) {
+      cur_func = &(*cur_file)[name];
+    }
+  }
+
+  for (auto &file_iter : cov) {
+    const std::string cov_file_name = file_iter.first + ".cov";
+    std::ofstream cov_file(cov_file_name);
+    if (!cov_file.is_open()) {
+      fprintf(stderr, "Can't write %s\n", cov_file_name.c_str());
+      continue;
+    }
+
+    for (auto &func_iter : file_iter.second) {
+      bool is_func_covered = false;
+      for (auto &bb_iter : func_iter.second) {
+        is_func_covered |= bb_iter.second;
+      }
+
+      cov_file << "F " << func_iter.first << " " << is_func_covered << "\n";
+      for (auto &bb_iter : func_iter.second) {
+        cov_file << "B " << bb_iter.first << " " << bb_iter.second << "\n";
+      }
+    }
+  }
+
+  printf("%lu / %lu blocks covered\n", num_covered, num_bbs);
+
+  if (base != MAP_FAILED) {
+    munmap(base, map_size);
+  }
+  return 0;
+}
@@ -0,0 +1,439 @@
+// replay-run : replays a corpus of carved contexts with a driver in
+// parallel.
+//
+//   replay-run [-j jobs] [-t timeout ms] [-m memory MB] [-o results]
+//              <corpus dir | index file | -> <driver> [driver args]
+//
+// Each context is replayed in a fresh process, `<driver> [driver args]
+// <context>`, with its output discarded. The corpus is a directory of
+// carved files (not its subdirectories nor the carving stats) or a file
+// listing one context path per line, `-` for stdin. Contexts are split
+// into one queue per job in corpus order and a job that runs out steals
+// from the back of the fullest queue.
+//
+// The wall clock limit is an ITIMER_REAL timer and the memory limit an
+// RLIMIT_AS set in the child before exec. A run can replace the timer or
+// block its signal, so the job also kills a run still alive
+// KILL_GRACE_MS after the limit. Every run is classified as
+//
+//   P  pass     exited 0
+//   F  fail     exited with another status, or could not be started
+//   C  crash    killed by a signal
+//   T  timeout  killed by the timer, the CPU time limit or the job
+//
+// and written to the results file (default replay_results.txt) as
+// `<class> <exit status or signal> <ms> <context>`, in completion order.
+// The status of a run that could not be started is -1.
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#define DEFAULT_TIMEOUT_MS 1000
+#define DEFAULT_RESULTS_FILE "replay_results.txt"
+
+// Time a run gets past the limit to be killed by its own timer
+#define KILL_GRACE_MS 100
+// Poll interval of a job waiting for a run, without pidfd_open
+#define WAIT_POLL_MS 5
+
+enum RUN_CLASS { PASS, FAIL, CRASH, TIMEOUT, NUM_RUN_CLASSES };
+
+static const char run_class_chars[NUM_RUN_CLASSES] = {'P', 'F', 'C', 'T'};
+
+// Contexts left to a job, the owner pops the front and thieves the back.
+typedef struct job_queue_ {
+  pthread_mutex_t lock;
+  std::deque<const char *> contexts;
+} job_queue;
+
+static std::vector<std::string> contexts;
+static std::vector<job_queue> queues;
+
+static char **driver_argv = NULL;
+static int num_driver_args = 0;
+
+static int timeout_ms = DEFAULT_TIMEOUT_MS;
+static unsigned long mem_limit_mb = 0;
+
+static FILE *results_file = NULL;
+static pthread_mutex_t results_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long num_runs[NUM_RUN_CLASSES];
+
+static unsigned long now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((unsigned long)ts.tv_sec) * 1000UL + ts.tv_nsec / 1000000;
+}
+
+static bool ignore_file_name(const char *name) {
+  return (name[0] == '.') || !strncmp(name, "carving_stats", 13);
+}
+
+static bool read_corpus_dir(const char *dir_name) {
+  DIR *dir = opendir(dir_name);
+  if (dir == NULL) {
+    return false;
+  }
+
+  size_t first = contexts.size();
+  struct dirent *ent;
+  while ((ent = readdir(dir)) != NULL) {
+    if ((ent->d_type != DT_REG) || ignore_file_name(ent->d_name)) {
+      continue;
+    }
+    contexts.push_back(std::string(dir_name) + "/" + ent->d_name);
+  }
+  closedir(dir);
+
+  std::sort(contexts.begin() + first, contexts.end());
+  return true;
+}
+
+static bool read_corpus_index(FILE *index) {
+  char *line = NULL;
+  size_t len = 0;
+  while (getline(&line, &len, index) != -1) {
+    line[strcspn(line, "\n")] = 0;
+    if (line[0] != 0) {
+      contexts.push_back(line);
+    }
+  }
+  free(line);
+  return true;
+}
+
+static bool read_corpus(const char *corpus) {
+  if (!strcmp(corpus, "-")) {
+    return read_corpus_index(stdin);
+  }
+
+  struct stat st;
+  if (stat(corpus, &st) != 0) {
+    return false;
+  }
+  if (S_ISDIR(st.st_mode)) {
+    return read_corpus_dir(corpus);
+  }
+
+  FILE *index = fopen(corpus, "r");
+  if (index == NULL) {
+    return false;
+  }
+  bool res = read_corpus_index(index);
+  fclose(index);
+  return res;
+}
+
+static const char *pop_context(int job_idx) {
+  job_queue *own = &queues[job_idx];
+  pthread_mutex_lock(&own->lock);
+  if (!own->contexts.empty()) {
+    const char *context = own->contexts.front();
+    own->contexts.pop_front();
+    pthread_mutex_unlock(&own->lock);
+    return context;
+  }
+  pthread_mutex_unlock(&own->lock);
+
+  // Steal from the back of the fullest queue. The queue may drain between
+  // picking and locking it, then look again.
+  while (true) {
+    int victim_idx = -1;
+    size_t victim_size = 0;
+    for (size_t idx = 0; idx < queues.size(); idx++) {
+      pthread_mutex_lock(&queues[idx].lock);
+      size_t size = queues[idx].contexts.size();
+      pthread_mutex_unlock(&queues[idx].lock);
+      if (size > victim_size) {
+        victim_idx = idx;
+        victim_size = size;
+      }
+    }
+    if (victim_idx < 0) {
+      return NULL;
+    }
+
+    job_queue *victim = &queues[victim_idx];
+    pthread_mutex_lock(&victim->lock);
+    if (!victim->contexts.empty()) {
+      const char *context = victim->contexts.back();
+      victim->contexts.pop_back();
+      pthread_mutex_unlock(&victim->lock);
+      return context;
+    }
+    pthread_mutex_unlock(&victim->lock);
+  }
+}
+
+// Soft RLIMIT_CPU of a run. CPU time never exceeds the wall clock, the
+// limit only catches the runs that block SIGALRM.
+static unsigned long cpu_limit_sec() { return (timeout_ms + 999) / 1000 + 1; }
+
+// Only async signal safe calls between fork and exec, other jobs may hold
+// locks of this process.
+static void exec_driver(char **argv) {
+  int null_fd = open("/dev/null", O_RDWR);
+  if (null_fd >= 0) {
+    dup2(null_fd, STDIN_FILENO);
+    dup2(null_fd, STDOUT_FILENO);
+    dup2(null_fd, STDERR_FILENO);
+  }
+
+  if (mem_limit_mb != 0) {
+    struct rlimit mem_limit;
+    mem_limit.rlim_cur = mem_limit.rlim_max = mem_limit_mb << 20;
+    setrlimit(RLIMIT_AS, &mem_limit);
+  }
+
+  if (timeout_ms != 0) {
+    // The soft limit sends SIGXCPU, the kernel only sends SIGKILL at the
+    // hard one.
+    struct rlimit cpu_limit;
+    cpu_limit.rlim_cur = cpu_limit_sec();
+    cpu_limit.rlim_max = cpu_limit.rlim_cur + 1;
+    setrlimit(RLIMIT_CPU, &cpu_limit);
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = 0;
+    timer.it_value.tv_sec = timeout_ms / 1000;
+    timer.it_value.tv_usec = (timeout_ms % 1000) * 1000;
+    setitimer(ITIMER_REAL, &timer, NULL);
+  }
+
+  execv(argv[0], argv);
+  _exit(127);
+}
+
+static void write_result(RUN_CLASS run_class, int code,
+                         unsigned long elapsed_ms, const char *context) {
+  write_result(run_class, code, elapsed_ms, context);
+}
+
+// Waits for the run to exit until `deadline_ms`, true if it did.
+static bool wait_driver_until(pid_t child_pid, int pidfd,
+                              unsigned long deadline_ms) {
+  while (true) {
+    unsigned long cur_ms = now_ms();
+    if (cur_ms >= deadline_ms) {
+      return false;
+    }
+    int wait_ms = deadline_ms - cur_ms;
+
+    if (pidfd >= 0) {
+      struct pollfd pfd;
+      pfd.fd = pidfd;
+      pfd.events = POLLIN;
+      int res = poll(&pfd, 1, wait_ms);
+      if (res > 0) {
+        return true;
+      }
+      if ((res < 0) && (errno != EINTR)) {
+        return false;
+      }
+      continue;
+    }
+
+    siginfo_t info;
+    info.si_pid = 0;
+    if ((waitid(P_PID, child_pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0) &&
+        (info.si_pid == child_pid)) {
+      return true;
+    }
+    usleep((wait_ms < WAIT_POLL_MS ? wait_ms : WAIT_POLL_MS) * 1000);
+  }
+}
+
+// Reaps the run, killing it first if it outlives the limit. True if the
+// job killed it.
+static bool wait_driver(pid_t child_pid, unsigned long begin_ms, int *status,
+                        struct rusage *usage) {
+  bool is_killed = false;
+  if (timeout_ms != 0) {
+    int pidfd = -1;
+#ifdef SYS_pidfd_open
+    pidfd = syscall(SYS_pidfd_open, child_pid, 0);
+#endif
+    if (!wait_driver_until(child_pid, pidfd,
+                           begin_ms + timeout_ms + KILL_GRACE_MS)) {
+      kill(child_pid, SIGKILL);
+      is_killed = true;
+    }
+    if (pidfd >= 0) {
+      close(pidfd);
+    }
+  }
+
+  while ((wait4(child_pid, status, 0, usage) < 0) && (errno == EINTR)) {
+  }
+  return is_killed;
+}
+
+static void run_context(const char *context) {
+  std::vector<char *> argv(driver_argv, driver_argv + num_driver_args);
+  argv.push_back((char *)context);
+  argv.push_back(NULL);
+
+  unsigned long begin_ms = now_ms();
+
+  pid_t child_pid = fork();
+  if (child_pid < 0) {
+    fprintf(stderr, "Error: fork failed, errno : %s\n", strerror(errno));
+    write_result(FAIL, -1, now_ms() - begin_ms, context);
+    return;
+  }
+  if (child_pid == 0) {
+    exec_driver(argv.data());
+  }
+
+  int status = 0;
+  struct rusage usage;
+  bool is_killed = wait_driver(child_pid, begin_ms, &status, &usage);
+
+  unsigned long elapsed_ms = now_ms() - begin_ms;
+
+  RUN_CLASS run_class;
+  int code;
+  if (is_killed) {
+    // Exited or crashed on its own right at the deadline, it still timed out
+    code = WIFSIGNALED(status) ? WTERMSIG(status) : SIGKILL;
+    run_class = TIMEOUT;
+  } else if (WIFSIGNALED(status)) {
+    code = WTERMSIG(status);
+    run_class = ((code == SIGALRM) || (code == SIGXCPU)) ? TIMEOUT : CRASH;
+
+    // SIGKILL at the hard CPU limit, the run ignored SIGXCPU
+    unsigned long cpu_ms = usage.ru_utime.tv_sec * 1000UL +
+                           usage.ru_utime.tv_usec / 1000 +
+                           usage.ru_stime.tv_sec * 1000UL +
+                           usage.ru_stime.tv_usec / 1000;
+    if ((code == SIGKILL) && (timeout_ms != 0) &&
+        (cpu_ms >= cpu_limit_sec() * 1000UL)) {
+      run_class = TIMEOUT;
+    }
+  } else {
+    code = WEXITSTATUS(status);
+    run_class = code == 0 ? PASS : FAIL;
+  }
+
+  pthread_mutex_lock(&results_lock);
+  num_runs[run_class]++;
+  fprintf(results_file, "%c %d %lu %s\n", run_class_chars[run_class], code,
+          elapsed_ms, context);
+  pthread_mutex_unlock(&results_lock);
+}
+
+static void *job_main(void *arg) {
+  int job_idx = (long)arg;
+  const char *context;
+  while ((context = pop_context(job_idx)) != NULL) {
+    run_context(context);
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  long num_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  const char *results_file_name = DEFAULT_RESULTS_FILE;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "+j:t:m:o:")) != -1) {
+    switch (opt) {
+      case 'j':
+        num_jobs = atol(optarg);
+        break;
+      case 't':
+        timeout_ms = atoi(optarg);
+        break;
+      case 'm':
+        mem_limit_mb = strtoul(optarg, NULL, 10);
+        break;
+      case 'o':
+        results_file_name = optarg;
+        break;
+      default:
+        argc = 0;
+        break;
+    }
+  }
+
+  if (argc - optind < 2) {
+    fprintf(stderr,
+            "Usage: %s [-j jobs] [-t timeout ms] [-m memory MB] [-o results] "
+            "<corpus dir | index file | -> <driver> [driver args]\n",
+            argv[0]);
+    return 1;
+  }
+
+  if (num_jobs <= 0) {
+    num_jobs = 1;
+  }
+  if (timeout_ms < 0) {
+    timeout_ms = 0;
+  }
+
+  const char *corpus = argv[optind];
+  if (!read_corpus(corpus)) {
+    fprintf(stderr, "Error: Can't read corpus %s\n", corpus);
+    return 1;
+  }
+
+  driver_argv = argv + optind + 1;
+  num_driver_args = argc - optind - 1;
+
+  results_file = fopen(results_file_name, "w");
+  if (results_file == NULL) {
+    fprintf(stderr, "Error: Can't write %s, errno : %s\n", results_file_name,
+            strerror(errno));
+    return 1;
+  }
+
+  // Contiguous shards keep the contexts of a directory on one job.
+  queues = std::vector<job_queue>(num_jobs);
+  size_t shard_size = (contexts.size() + num_jobs - 1) / num_jobs;
+  for (long job_idx = 0; job_idx < num_jobs; job_idx++) {
+    pthread_mutex_init(&queues[job_idx].lock, NULL);
+    size_t begin = std::min(contexts.size(), job_idx * shard_size);
+    size_t end = std::min(contexts.size(), begin + shard_size);
+    for (size_t idx = begin; idx < end; idx++) {
+      queues[job_idx].contexts.push_back(contexts[idx].c_str());
+    }
+  }
+
+  unsigned long begin_ms = now_ms();
+
+  std::vector<pthread_t> jobs(num_jobs);
+  for (long job_idx = 0; job_idx < num_jobs; job_idx++) {
+    pthread_create(&jobs[job_idx], NULL, job_main, (void *)job_idx);
+  }
+  for (long job_idx = 0; job_idx < num_jobs; job_idx++) {
+    pthread_join(jobs[job_idx], NULL);
+  }
+
+  fclose(results_file);
+
+  printf("pass:%lu fail:%lu crash:%lu timeout:%lu total:%lu in %.1fs\n",
+         num_runs[PASS], num_runs[FAIL], num_runs[CRASH], num_runs[TIMEOUT],
+         (unsigned long)contexts.size(), (now_ms() - begin_ms) / 1000.0);
+  return 0;
+}
@@ -0,0 +1,176 @@
+#include "utils/addr_space.hpp"
+
+#include <link.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAPS_LINE_SIZE 4096
+
+// Longest read only string carved by value
+#define MAX_RODATA_STR_LEN (1 << 16)
+
+addr_space::addr_space() {}
+
+addr_space::~addr_space() { free(ranges_); }
+
+typedef struct dl_counters_ {
+  unsigned long long adds;
+  unsigned long long subs;
+} dl_counters;
+
+static int read_dl_counters(struct dl_phdr_info *info, size_t size,
+                            void *data) {
+  dl_counters *counters = (dl_counters *)data;
+  if (size >= offsetof(struct dl_phdr_info, dlpi_subs) +
+                  sizeof(info->dlpi_subs)) {
+    counters->adds = info->dlpi_adds;
+    counters->subs = info->dlpi_subs;
+  }
+  // Same for every object, the first one is enough.
+  return 1;
+}
+
+bool addr_space::dl_changed() {
+  dl_counters counters = {dl_adds_, dl_subs_};
+  dl_iterate_phdr(read_dl_counters, &counters);
+  return (counters.adds != dl_adds_) || (counters.subs != dl_subs_);
+}
+
+bool addr_space::load() {
+  FILE *maps_file = fopen("/proc/self/maps", "r");
+  if (maps_file == NULL) {
+    return false;
+  }
+
+  char exe_name[MAPS_LINE_SIZE];
+  ssize_t exe_name_len = readlink("/proc/self/exe", exe_name,
+                                  sizeof(exe_name) - 1);
+  exe_name[exe_name_len < 0 ? 0 : exe_name_len] = 0;
+
+  dl_counters counters = {0, 0};
+  dl_iterate_phdr(read_dl_counters, &counters);
+  dl_adds_ = counters.adds;
+  dl_subs_ = counters.subs;
+
+  num_ranges_ = 0;
+
+  char line[MAPS_LINE_SIZE];
+  while (fgets(line, sizeof(line), maps_file) != NULL) {
+    unsigned long begin, end, offset, inode;
+    char perms[8];
+    int path_pos = 0;
+    if (sscanf(line, "%lx-%lx %7s %lx %*s %lu %n", &begin, &end, perms,
+               &offset, &inode, &path_pos) < 5) {
+      continue;
+    }
+
+    // Inaccessible guard pages can never be carved.
+    if (perms[0] != 'r') {
+      continue;
+    }
+
+    char *path = line + path_pos;
+    size_t path_len = strlen(path);
+    if ((path_len > 0) && (path[path_len - 1] == '\n')) {
+      path[--path_len] = 0;
+    }
+
+    range cur;
+    cur.begin_ = begin;
+    cur.end_ = end;
+    cur.is_lib_ = false;
+
+    if (path[0] == '[') {
+      if (!strcmp(path, "[heap]")) {
+        cur.kind_ = HEAP;
+      } else if (!strncmp(path, "[stack", 6)) {
+        cur.kind_ = STACK;
+      } else {
+        cur.kind_ = SPECIAL;
+      }
+    } else if (path[0] == 0) {
+      cur.kind_ = ANON;
+    } else {
+      cur.is_lib_ = strcmp(path, exe_name) != 0;
+      if (perms[2] == 'x') {
+        cur.kind_ = TEXT;
+      } else if (perms[1] == 'w') {
+        cur.kind_ = DATA;
+      } else {
+        cur.kind_ = RODATA;
+      }
+    }
+
+    if (num_ranges_ == capacity_) {
+      int new_capacity = (capacity_ == 0) ? 256 : capacity_ * 2;
+      range *new_ranges =
+          (range *)realloc(ranges_, sizeof(range) * new_capacity);
+      if (new_ranges == nullptr) {
+        break;
+      }
+      ranges_ = new_ranges;
+      capacity_ = new_capacity;
+    }
+
+    // The kernel lists mappings sorted by address.
+    ranges_[num_ranges_++] = cur;
+  }
+
+  fclose(maps_file);
+  num_loads_++;
+  return true;
+}
+
+const addr_space::range *addr_space::search(unsigned long addr) const {
+  int low = 0;
+  int high = num_ranges_ - 1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    const range *cur = &ranges_[mid];
+    if (addr < cur->begin_) {
+      high = mid - 1;
+    } else if (addr >= cur->end_) {
+      low = mid + 1;
+    } else {
+      return cur;
+    }
+  }
+  return nullptr;
+}
+
+const addr_space::range *addr_space::find(const void *addr) {
+  if (num_loads_ == 0) {
+    load();
+  }
+
+  const range *found = search((unsigned long)addr);
+  if ((found == nullptr) && dl_changed()) {
+    load();
+    found = search((unsigned long)addr);
+  }
+  return found;
+}
+
+int addr_space::rodata_size(const void *addr, int elem_size, bool is_str) {
+  const range *found = find(addr);
+  if ((found == nullptr) || (found->kind_ != RODATA)) {
+    return 0;
+  }
+
+  unsigned long max_size = found->end_ - (unsigned long)addr;
+  if (is_str) {
+    if (max_size > MAX_RODATA_STR_LEN) {
+      max_size = MAX_RODATA_STR_LEN;
+    }
+    size_t str_len = strnlen((const char *)addr, max_size);
+    return str_len < max_size ? str_len + 1 : str_len;
+  }
+
+  if ((elem_size <= 0) || ((unsigned long)elem_size > max_size)) {
+    return 0;
+  }
+  return elem_size;
+}
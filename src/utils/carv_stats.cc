@@ -0,0 +1,329 @@
+#include "utils/carv_stats.hpp"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utils/ptr_map.hpp"
+
+carv_stats::carv_stats() { start_ns_ = now_ns(); }
+
+carv_stats::~carv_stats() {
+  close_live();
+  free(units_);
+}
+
+unsigned long carv_stats::now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((unsigned long)ts.tv_sec) * 1000000000UL + ts.tv_nsec;
+}
+
+carv_stats::unit *carv_stats::get_unit(int unit_id) {
+  if (unit_id < 0) {
+    return nullptr;
+  }
+
+  if (unit_id >= num_units_) {
+    int new_num_units = (num_units_ == 0) ? 256 : num_units_;
+    while (unit_id >= new_num_units) {
+      new_num_units *= 2;
+    }
+
+    unit *new_units = (unit *)realloc(units_, sizeof(unit) * new_num_units);
+    if (new_units == nullptr) {
+      return nullptr;
+    }
+    memset(new_units + num_units_, 0,
+           sizeof(unit) * (new_num_units - num_units_));
+    units_ = new_units;
+    num_units_ = new_num_units;
+  }
+
+  return &units_[unit_id];
+}
+
+carv_live_unit *carv_stats::get_live_unit(int unit_id) {
+  if ((live_ == nullptr) || (unit_id < 0) ||
+      (unit_id >= CARV_LIVE_MAX_UNITS)) {
+    return nullptr;
+  }
+  return &live_->units[unit_id];
+}
+
+bool carv_stats::open_live(const char *outdir_name, const char *carver_name) {
+  char live_file_name[512];
+  snprintf(live_file_name, 512, "%s/%s", outdir_name, CARV_LIVE_FILE_NAME);
+
+  int fd = open(live_file_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+
+  if (ftruncate(fd, sizeof(carv_live_segment)) != 0) {
+    close(fd);
+    return false;
+  }
+
+  void *mapped = mmap(NULL, sizeof(carv_live_segment), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+
+  live_ = (carv_live_segment *)mapped;
+  carv_live_header *header = &live_->header;
+  header->version = CARV_LIVE_VERSION;
+  header->pid = getpid();
+  header->start_ns = start_ns_;
+  snprintf(header->carver, sizeof(header->carver), "%s", carver_name);
+  // Readers check the magic last.
+  __atomic_store_n(&header->magic, CARV_LIVE_MAGIC, __ATOMIC_RELEASE);
+  return true;
+}
+
+void carv_stats::close_live() {
+  if (live_ == nullptr) {
+    return;
+  }
+
+  CARV_LIVE_STORE(live_->header.ctx_depth, 0);
+  __atomic_store_n(&live_->header.finished, 1, __ATOMIC_RELEASE);
+  munmap(live_, sizeof(carv_live_segment));
+  live_ = nullptr;
+}
+
+void carv_stats::set_name(int unit_id, const char *name) {
+  unit *cur = get_unit(unit_id);
+  if ((cur != nullptr) && (cur->name_ == nullptr)) {
+    cur->name_ = name;
+
+    carv_live_unit *live_unit = get_live_unit(unit_id);
+    if ((live_unit != nullptr) && (name != nullptr)) {
+      strncpy(live_unit->name, name, CARV_LIVE_NAME_LEN - 1);
+      if (unit_id >= live_->header.num_units) {
+        __atomic_store_n(&live_->header.num_units, unit_id + 1,
+                         __ATOMIC_RELEASE);
+      }
+    }
+  }
+}
+
+void carv_stats::on_call(int unit_id) {
+  unit *cur = get_unit(unit_id);
+  if (cur != nullptr) {
+    cur->num_calls_++;
+  }
+
+  if (live_ != nullptr) {
+    CARV_LIVE_ADD(live_->header.calls, 1);
+    if (ptr_map_ != nullptr) {
+      CARV_LIVE_STORE(live_->header.ptr_map_nodes, ptr_map_->num_nodes());
+    }
+
+    carv_live_unit *live_unit = get_live_unit(unit_id);
+    if (live_unit != nullptr) {
+      CARV_LIVE_ADD(live_unit->calls, 1);
+    }
+  }
+}
+
+void carv_stats::on_carved(int unit_id, unsigned long num_records,
+                           unsigned long num_bytes) {
+  unit *cur = get_unit(unit_id);
+  if (cur == nullptr) {
+    return;
+  }
+
+  cur->num_carved_++;
+  cur->num_records_ += num_records;
+  cur->num_bytes_ += num_bytes;
+  if (num_records > cur->max_records_) {
+    cur->max_records_ = num_records;
+  }
+  if (num_bytes > cur->max_bytes_) {
+    cur->max_bytes_ = num_bytes;
+  }
+
+  if (live_ != nullptr) {
+    CARV_LIVE_ADD(live_->header.carved, 1);
+    CARV_LIVE_ADD(live_->header.records, num_records);
+    CARV_LIVE_ADD(live_->header.bytes, num_bytes);
+
+    carv_live_unit *live_unit = get_live_unit(unit_id);
+    if (live_unit != nullptr) {
+      CARV_LIVE_ADD(live_unit->carved, 1);
+      CARV_LIVE_ADD(live_unit->bytes, num_bytes);
+    }
+  }
+}
+
+void carv_stats::on_skipped(int unit_id) {
+  unit *cur = get_unit(unit_id);
+  if (cur != nullptr) {
+    cur->num_skipped_++;
+  }
+
+  if (live_ != nullptr) {
+    CARV_LIVE_ADD(live_->header.skipped, 1);
+  }
+}
+
+void carv_stats::on_deduped(int unit_id) {
+  unit *cur = get_unit(unit_id);
+  if (cur != nullptr) {
+    cur->num_deduped_++;
+  }
+
+  if (live_ != nullptr) {
+    CARV_LIVE_ADD(live_->header.deduped, 1);
+  }
+}
+
+void carv_stats::on_truncated(int unit_id) {
+  unit *cur = get_unit(unit_id);
+  if (cur != nullptr) {
+    cur->num_truncated_++;
+  }
+}
+
+void carv_stats::begin_traversal(int unit_id) {
+  end_traversal();
+  traversal_unit_ = unit_id;
+  traversal_begin_ns_ = now_ns();
+}
+
+void carv_stats::finish_traversal() {
+  unit *cur = get_unit(traversal_unit_);
+  if (cur != nullptr) {
+    cur->traversal_ns_ += now_ns() - traversal_begin_ns_;
+  }
+  traversal_unit_ = -1;
+}
+
+void carv_stats::add_traversal_ns(int unit_id, unsigned long elapsed_ns) {
+  unit *cur = get_unit(unit_id);
+  if (cur != nullptr) {
+    cur->traversal_ns_ += elapsed_ns;
+  }
+}
+
+void carv_stats::add_serialize_ns(int unit_id, unsigned long elapsed_ns) {
+  unit *cur = get_unit(unit_id);
+  if (cur != nullptr) {
+    cur->serialize_ns_ += elapsed_ns;
+  }
+}
+
+static void write_json_string(FILE *outfile, const char *str) {
+  fputc('"', outfile);
+  if (str != nullptr) {
+    for (const char *cur = str; *cur != 0; cur++) {
+      unsigned char c = *cur;
+      if ((c == '"') || (c == '\\')) {
+        fprintf(outfile, "\\%c", c);
+      } else if (c < 0x20) {
+        fprintf(outfile, "\\u%04x", c);
+      } else {
+        fputc(c, outfile);
+      }
+    }
+  }
+  fputc('"', outfile);
+}
+
+bool carv_stats::write_json(const char *outdir_name, const char *carver_name,
+                            const char *unit_kind) {
+  end_traversal();
+
+  char outfile_name[512];
+  snprintf(outfile_name, 512, "%s/carving_stats.json", outdir_name);
+  FILE *outfile = fopen(outfile_name, "w");
+  if (outfile == NULL) {
+    return false;
+  }
+
+  unit total;
+  memset(&total, 0, sizeof(unit));
+
+  int idx;
+  for (idx = 0; idx < num_units_; idx++) {
+    unit *cur = &units_[idx];
+    total.num_calls_ += cur->num_calls_;
+    total.num_carved_ += cur->num_carved_;
+    total.num_skipped_ += cur->num_skipped_;
+    total.num_deduped_ += cur->num_deduped_;
+    total.num_truncated_ += cur->num_truncated_;
+    total.num_records_ += cur->num_records_;
+    total.num_bytes_ += cur->num_bytes_;
+    total.traversal_ns_ += cur->traversal_ns_;
+    total.serialize_ns_ += cur->serialize_ns_;
+  }
+
+  fprintf(outfile, "{\n");
+  fprintf(outfile, "  \"carver\": ");
+  write_json_string(outfile, carver_name);
+  fprintf(outfile, ",\n");
+  fprintf(outfile, "  \"wall_ns\": %lu,\n", now_ns() - start_ns_);
+  fprintf(outfile,
+          "  \"total\": {\"calls\": %lu, \"carved\": %lu, \"skipped\": %lu, "
+          "\"deduped\": %lu, \"truncated\": %lu, \"records\": %lu, "
+          "\"bytes\": %lu, \"traversal_ns\": %lu, \"serialize_ns\": %lu},\n",
+          total.num_calls_, total.num_carved_, total.num_skipped_,
+          total.num_deduped_, total.num_truncated_, total.num_records_,
+          total.num_bytes_, total.traversal_ns_, total.serialize_ns_);
+
+  if (ptr_map_ != nullptr) {
+    unsigned long num_finds = ptr_map_->num_finds();
+    unsigned long num_cache_hits = ptr_map_->num_cache_hits();
+    fprintf(outfile,
+            "  \"ptr_map\": {\"nodes\": %lu, \"max_depth\": %u, "
+            "\"finds\": %lu, \"cache_hits\": %lu, \"cache_hit_rate\": %.4f},\n",
+            ptr_map_->num_nodes(), ptr_map_->max_depth(), num_finds,
+            num_cache_hits,
+            num_finds == 0 ? 0.0 : (double)num_cache_hits / num_finds);
+  } else {
+    fprintf(outfile, "  \"ptr_map\": null,\n");
+  }
+
+  fprintf(outfile, "  \"dropped_shm_events\": %lu,\n", num_dropped_);
+
+  fprintf(outfile, "  \"unit\": ");
+  write_json_string(outfile, unit_kind);
+  fprintf(outfile, ",\n");
+
+  // Units that were never reached are left out.
+  fprintf(outfile, "  \"units\": [");
+  bool first = true;
+  for (idx = 0; idx < num_units_; idx++) {
+    unit *cur = &units_[idx];
+    if ((cur->num_calls_ == 0) && (cur->num_carved_ == 0)) {
+      continue;
+    }
+
+    fprintf(outfile, first ? "\n    {\"id\": %d, \"name\": "
+                           : ",\n    {\"id\": %d, \"name\": ",
+            idx);
+    first = false;
+    write_json_string(outfile, cur->name_);
+    fprintf(outfile,
+            ", \"calls\": %lu, \"carved\": %lu, \"skipped\": %lu, "
+            "\"deduped\": %lu, \"truncated\": %lu, \"records\": %lu, "
+            "\"max_records\": %lu, \"bytes\": %lu, \"max_bytes\": %lu, "
+            "\"traversal_ns\": %lu, \"serialize_ns\": %lu}",
+            cur->num_calls_, cur->num_carved_, cur->num_skipped_,
+            cur->num_deduped_, cur->num_truncated_, cur->num_records_,
+            cur->max_records_, cur->num_bytes_, cur->max_bytes_,
+            cur->traversal_ns_, cur->serialize_ns_);
+  }
+  fprintf(outfile, first ? "]\n" : "\n  ]\n");
+  fprintf(outfile, "}\n");
+
+  fclose(outfile);
+  return true;
+}
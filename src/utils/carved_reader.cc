@@ -0,0 +1,281 @@
+#include "utils/carved_reader.hpp"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class record_name {
+ public:
+  const char *name;
+  size_t len;
+  RECORD_TYPE type;
+};
+
+#define RECORD_NAME(type) \
+  { #type, sizeof(#type) - 1, RECORD_TYPE::type }
+
+static const record_name record_names[] = {
+    RECORD_NAME(CHAR),    RECORD_NAME(SHORT),       RECORD_NAME(INT),
+    RECORD_NAME(LONG),    RECORD_NAME(LONGLONG),    RECORD_NAME(FLOAT),
+    RECORD_NAME(DOUBLE),  RECORD_NAME(PTR),         RECORD_NAME(NULLPTR),
+    RECORD_NAME(FUNCPTR), RECORD_NAME(UNKNOWN_PTR), RECORD_NAME(TRUNCATED),
+    RECORD_NAME(SKIPPED), RECORD_NAME(GLOBAL_REF),  RECORD_NAME(OBJ_REF),
+};
+
+static const record_name *find_record_name(const char *name, size_t len) {
+  for (const record_name &cur : record_names) {
+    if ((cur.len == len) && !memcmp(cur.name, name, len)) {
+      return &cur;
+    }
+  }
+  // OBJ_INFO, POST and unknown records are not inputs
+  return NULL;
+}
+
+carved_reader::carved_reader() {}
+
+carved_reader::~carved_reader() { close(); }
+
+bool carved_reader::push(const char *file_name, int prefix_len) {
+  if (depth_ == MAX_DEPTH) {
+    return false;
+  }
+
+  int fd = ::open(file_name, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  mapping *cur = &mappings_[depth_];
+  cur->base_ = NULL;
+  cur->size_ = st.st_size;
+  cur->is_mapped_ = false;
+
+  if (cur->size_ != 0) {
+    // Private and writable, strings are terminated in place.
+    void *base = mmap(NULL, cur->size_, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                      fd, 0);
+    if (base == MAP_FAILED) {
+      ::close(fd);
+      return false;
+    }
+    cur->base_ = (char *)base;
+    cur->is_mapped_ = true;
+
+    // Every line must end with '\n' for the values to be parsed in place,
+    // the rare file that does not is copied with one more byte.
+    if (cur->base_[cur->size_ - 1] != '\n') {
+      char *copy = (char *)malloc(cur->size_ + 1);
+      if (copy == NULL) {
+        munmap(base, cur->size_);
+        ::close(fd);
+        return false;
+      }
+      memcpy(copy, base, cur->size_);
+      copy[cur->size_] = '\n';
+      munmap(base, cur->size_);
+      cur->base_ = copy;
+      cur->size_ += 1;
+      cur->is_mapped_ = false;
+    }
+  }
+  ::close(fd);
+
+  cur->cur_ = cur->base_;
+  cur->end_ = cur->base_ + cur->size_;
+  cur->prefix_len_ = prefix_len;
+  depth_++;
+  return true;
+}
+
+void carved_reader::pop() {
+  mapping *cur = &mappings_[--depth_];
+  if (cur->is_mapped_) {
+    munmap(cur->base_, cur->size_);
+  } else {
+    free(cur->base_);
+  }
+}
+
+bool carved_reader::open(const char *file_name, int prefix_len) {
+  close();
+
+  if (!push(file_name, prefix_len)) {
+    return false;
+  }
+
+  const char *dir_end = strrchr(file_name, '/');
+  int dir_len = dir_end == NULL ? 0 : dir_end - file_name + 1;
+  dir_name_ = strndup(file_name, dir_len);
+
+  in_ptr_table_ = true;
+  has_cur_ = false;
+  return true;
+}
+
+void carved_reader::close() {
+  while (depth_ > 0) {
+    pop();
+  }
+  free(dir_name_);
+  dir_name_ = nullptr;
+  in_ptr_table_ = false;
+  has_cur_ = false;
+}
+
+bool carved_reader::next_ptr(int *alloc_size, const char **type_name,
+                             unsigned long *addr) {
+  if ((depth_ == 0) || !in_ptr_table_) {
+    return false;
+  }
+
+  mapping *root = &mappings_[0];
+  while (root->cur_ < root->end_) {
+    char *line = root->cur_;
+    char *line_end = (char *)memchr(line, '\n', root->end_ - line);
+    root->cur_ = line_end + 1;
+
+    if (line[0] == '#') {
+      break;
+    }
+
+    // idx:addr:size:type, the type may hold ':' itself.
+    char *addr_str = (char *)memchr(line, ':', line_end - line);
+    char *size_str = addr_str == NULL ? NULL
+                                      : (char *)memchr(addr_str + 1, ':',
+                                                       line_end - addr_str - 1);
+    char *type_str = size_str == NULL ? NULL
+                                      : (char *)memchr(size_str + 1, ':',
+                                                       line_end - size_str - 1);
+    if (type_str == NULL) {
+      continue;
+    }
+
+    *line_end = 0;
+    // Printed with %p, "(nil)" reads as 0.
+    *addr = strtoul(addr_str + 1, NULL, 16);
+    *alloc_size = atoi(size_str + 1);
+    *type_name = type_str + 1;
+    return true;
+  }
+
+  in_ptr_table_ = false;
+  return false;
+}
+
+void carved_reader::push_ref(const char *ref, size_t ref_len) {
+  char *ref_name = (char *)malloc(strlen(dir_name_) + ref_len + 1);
+  sprintf(ref_name, "%s%.*s", dir_name_, (int)ref_len, ref);
+
+  if (!push(ref_name, 0)) {
+    fprintf(stderr, "Replay error : Can't read referenced records %s\n",
+            ref_name);
+    abort();
+  }
+  free(ref_name);
+}
+
+bool carved_reader::fill() {
+  const char *type_name;
+  int alloc_size;
+  unsigned long addr;
+  while (next_ptr(&alloc_size, &type_name, &addr)) {
+  }
+
+  while (depth_ > 0) {
+    mapping *cur = &mappings_[depth_ - 1];
+    if (cur->cur_ >= cur->end_) {
+      if (depth_ == 1) {
+        return false;
+      }
+      pop();
+      continue;
+    }
+
+    char *line = cur->cur_;
+    char *line_end = (char *)memchr(line, '\n', cur->end_ - line);
+    cur->cur_ = line_end + 1;
+
+    if (line_end - line <= cur->prefix_len_) {
+      continue;
+    }
+
+    char *type_str = line + cur->prefix_len_;
+    char *value_str = (char *)memchr(type_str, ':', line_end - type_str);
+    if (value_str == NULL) {
+      continue;
+    }
+
+    const record_name *found =
+        find_record_name(type_str, value_str - type_str);
+    if (found == NULL) {
+      continue;
+    }
+    value_str++;
+
+    cur_.type = found->type;
+    switch (found->type) {
+      case RECORD_TYPE::CHAR:
+      case RECORD_TYPE::SHORT:
+      case RECORD_TYPE::INT:
+      case RECORD_TYPE::LONG:
+      case RECORD_TYPE::LONGLONG:
+      case RECORD_TYPE::SKIPPED:
+        cur_.value = strtoll(value_str, NULL, 10);
+        break;
+      case RECORD_TYPE::FLOAT:
+      case RECORD_TYPE::DOUBLE:
+        cur_.fvalue = strtod(value_str, NULL);
+        break;
+      case RECORD_TYPE::PTR: {
+        char *offset_str;
+        cur_.value = strtoll(value_str, &offset_str, 10);
+        cur_.offset = *offset_str == ':' ? atoi(offset_str + 1) : 0;
+        break;
+      }
+      case RECORD_TYPE::FUNCPTR:
+        *line_end = 0;
+        cur_.name = value_str;
+        break;
+      case RECORD_TYPE::GLOBAL_REF:
+        push_ref(value_str, line_end - value_str);
+        continue;
+      case RECORD_TYPE::OBJ_REF: {
+        char ref[32];
+        snprintf(ref, 32, "objects/%.*s", (int)(line_end - value_str),
+                 value_str);
+        push_ref(ref, strlen(ref));
+        continue;
+      }
+      default:
+        break;
+    }
+    return true;
+  }
+  return false;
+}
+
+const carved_record *carved_reader::next() {
+  if (has_cur_) {
+    has_cur_ = false;
+    return &cur_;
+  }
+  return fill() ? &cur_ : NULL;
+}
+
+const carved_record *carved_reader::peek() {
+  if (!has_cur_) {
+    has_cur_ = fill();
+  }
+  return has_cur_ ? &cur_ : NULL;
+}
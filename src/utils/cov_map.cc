@@ -0,0 +1,121 @@
+#include "utils/cov_map.hpp"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Merges into the map open at `fd`, the caller holds its lock.
+static bool merge_locked(int fd, unsigned long layout_hash,
+                         const unsigned char *bits, unsigned long num_bbs) {
+  size_t map_size = COV_MAP_SIZE(num_bbs);
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    return false;
+  }
+
+  cov_map_header header;
+  bool is_valid =
+      ((size_t)st.st_size == map_size) &&
+      (pread(fd, &header, sizeof(header), 0) == sizeof(header)) &&
+      (header.magic == COV_MAP_MAGIC) && (header.version == COV_MAP_VERSION) &&
+      (header.layout_hash == layout_hash) && (header.num_bbs == num_bbs);
+
+  if (!is_valid) {
+    // New, or left by another build of the module
+    header.magic = COV_MAP_MAGIC;
+    header.version = COV_MAP_VERSION;
+    header.layout_hash = layout_hash;
+    header.num_bbs = num_bbs;
+    if ((ftruncate(fd, 0) != 0) || (ftruncate(fd, map_size) != 0) ||
+        (pwrite(fd, &header, sizeof(header), 0) != sizeof(header))) {
+      return false;
+    }
+  }
+
+  void *base = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    return false;
+  }
+
+  unsigned char *map_bits = (unsigned char *)base + sizeof(cov_map_header);
+  size_t idx;
+  for (idx = 0; idx < (num_bbs + 7) / 8; idx++) {
+    map_bits[idx] |= bits[idx];
+  }
+
+  munmap(base, map_size);
+  return true;
+}
+
+bool cov_map_merge(const char *map_path, unsigned long layout_hash,
+                   const unsigned char *bits, unsigned long num_bbs) {
+  int fd = open(map_path, O_RDWR | O_CREAT, 0666);
+  if (fd < 0) {
+    return false;
+  }
+
+  if (flock(fd, LOCK_EX) != 0) {
+    close(fd);
+    return false;
+  }
+
+  bool res = merge_locked(fd, layout_hash, bits, num_bbs);
+
+  flock(fd, LOCK_UN);
+  close(fd);
+  return res;
+}
+
+// Bound by main
+static cov_func_meta *cov_funcs = NULL;
+static int num_cov_funcs = 0;
+static const char *cov_map_path = NULL;
+static unsigned long cov_layout_hash = 0;
+
+void __cov_bind(cov_func_meta *funcs, int num_funcs, const char *map_path,
+                unsigned long layout_hash) {
+  cov_funcs = funcs;
+  num_cov_funcs = num_funcs;
+  cov_map_path = map_path;
+  cov_layout_hash = layout_hash;
+}
+
+void __cov_fini() {
+  if (cov_map_path == NULL) {
+    return;
+  }
+
+  unsigned long num_bbs = 0;
+  int func_idx;
+  for (func_idx = 0; func_idx < num_cov_funcs; func_idx++) {
+    num_bbs += cov_funcs[func_idx].num_bbs;
+  }
+
+  unsigned char *bits = (unsigned char *)calloc((num_bbs + 7) / 8, 1);
+  if (bits == NULL) {
+    return;
+  }
+
+  unsigned long bb_id = 0;
+  for (func_idx = 0; func_idx < num_cov_funcs; func_idx++) {
+    cov_func_meta *func = &cov_funcs[func_idx];
+    int bb_idx;
+    for (bb_idx = 0; bb_idx < func->num_bbs; bb_idx++, bb_id++) {
+      if (func->counters[bb_idx] != 0) {
+        bits[bb_id / 8] |= 1 << (bb_id % 8);
+      }
+    }
+  }
+
+  if (!cov_map_merge(cov_map_path, cov_layout_hash, bits, num_bbs)) {
+    fprintf(stderr, "Replay error : Can't update coverage map %s\n",
+            cov_map_path);
+  }
+  free(bits);
+}
@@ -624,7 +624,8 @@ FUNC_CONTEXT::FUNC_CONTEXT()
       carving_index(0),
       func_call_idx(0),
       func_id(0),
-      is_carved(false) {}
+      is_carved(false),
+      journal_fd(-1) {}
 
 FUNC_CONTEXT::FUNC_CONTEXT(int _carved_idx, int _func_call_idx,
                            const char *func_name_)
@@ -635,7 +636,8 @@ FUNC_CONTEXT::FUNC_CONTEXT(int _carved_idx, int _func_call_idx,
       carved_ptrs(),
       used_ptrs(),
       func_name(func_name_),
-      is_carved(true) {}
+      is_carved(true),
+      journal_fd(-1) {}
 
 FUNC_CONTEXT::FUNC_CONTEXT(int _carved_idx, int _func_call_idx, int _func_id)
     : carving_index(_carved_idx),
@@ -644,7 +646,8 @@ FUNC_CONTEXT::FUNC_CONTEXT(int _carved_idx, int _func_call_idx, int _func_id)
       inputs(),
       carved_ptrs(),
       func_id(_func_id),
-      is_carved(true) {}
+      is_carved(true),
+      journal_fd(-1) {}
 
 FUNC_CONTEXT::FUNC_CONTEXT(const FUNC_CONTEXT &other)
     : carving_index(other.carving_index),
@@ -655,7 +658,8 @@ FUNC_CONTEXT::FUNC_CONTEXT(const FUNC_CONTEXT &other)
       func_id(other.func_id),
       is_carved(other.is_carved),
       used_ptrs(other.used_ptrs),
-      func_name(other.func_name) {}
+      func_name(other.func_name),
+      journal_fd(other.journal_fd) {}
 
 FUNC_CONTEXT::FUNC_CONTEXT(FUNC_CONTEXT &&other)
     : carving_index(other.carving_index),
@@ -666,7 +670,8 @@ FUNC_CONTEXT::FUNC_CONTEXT(FUNC_CONTEXT &&other)
       func_id(other.func_id),
       is_carved(other.is_carved),
       used_ptrs(other.used_ptrs),
-      func_name(other.func_name) {}
+      func_name(other.func_name),
+      journal_fd(other.journal_fd) {}
 
 FUNC_CONTEXT &FUNC_CONTEXT::operator=(const FUNC_CONTEXT &other) {
   carving_index = other.carving_index;
@@ -678,6 +683,7 @@ FUNC_CONTEXT &FUNC_CONTEXT::operator=(const FUNC_CONTEXT &other) {
   is_carved = other.is_carved;
   func_name = other.func_name;
   used_ptrs = other.used_ptrs;
+  journal_fd = other.journal_fd;
   return *this;
 }
 
@@ -691,6 +697,7 @@ FUNC_CONTEXT &FUNC_CONTEXT::operator=(FUNC_CONTEXT &&other) {
   is_carved = other.is_carved;
   func_name = other.func_name;
   used_ptrs = other.used_ptrs;
+  journal_fd = other.journal_fd;
   return *this;
 }
 
@@ -791,6 +798,96 @@ template class VAR<long double>;
 template class VAR<void *>;
 template class VAR<char *>;
 
+///////////////////
+// Static metadata tables
+///////////////////
+
+static int func_meta_cmp(const void *l, const void *r) {
+  char *l_addr = (char *)((func_meta *)l)->addr;
+  char *r_addr = (char *)((func_meta *)r)->addr;
+  return (l_addr > r_addr) - (l_addr < r_addr);
+}
+
+static int global_meta_cmp(const void *l, const void *r) {
+  char *l_addr = (char *)((global_meta *)l)->addr;
+  char *r_addr = (char *)((global_meta *)r)->addr;
+  return (l_addr > r_addr) - (l_addr < r_addr);
+}
+
+static int class_meta_cmp(const void *l, const void *r) {
+  char *l_name = ((class_meta *)l)->class_name;
+  char *r_name = ((class_meta *)r)->class_name;
+  return (l_name > r_name) - (l_name < r_name);
+}
+
+void sort_func_meta(func_meta *table, int num_entries) {
+  qsort(table, num_entries, sizeof(func_meta), func_meta_cmp);
+}
+
+void sort_global_meta(global_meta *table, int num_entries) {
+  qsort(table, num_entries, sizeof(global_meta), global_meta_cmp);
+}
+
+void sort_class_meta(class_meta *table, int num_entries) {
+  qsort(table, num_entries, sizeof(class_meta), class_meta_cmp);
+}
+
+func_meta *find_func_meta(func_meta *table, int num_entries, void *addr) {
+  int low = 0;
+  int high = num_entries - 1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    if (table[mid].addr == addr) {
+      return &table[mid];
+    } else if ((char *)table[mid].addr < (char *)addr) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return NULL;
+}
+
+global_meta *find_global_meta(global_meta *table, int num_entries,
+                              void *addr) {
+  // Find the last global starting at or before addr.
+  int low = 0;
+  int high = num_entries - 1;
+  global_meta *closest = NULL;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    if ((char *)table[mid].addr <= (char *)addr) {
+      closest = &table[mid];
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+
+  if ((closest == NULL) ||
+      ((char *)addr >= (char *)closest->addr + closest->size)) {
+    return NULL;
+  }
+  return closest;
+}
+
+class_meta *find_class_meta(class_meta *table, int num_entries,
+                            char *class_name) {
+  int low = 0;
+  int high = num_entries - 1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    if (table[mid].class_name == class_name) {
+      return &table[mid];
+    } else if (table[mid].class_name < class_name) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return NULL;
+}
+
 template class vector<int>;
 template class vector<IVAR *>;
 template class vector<POINTER>;
@@ -798,6 +895,7 @@ template class vector<char *>;
 template class vector<FUNC_CONTEXT>;
 template class vector<bool>;
 template class vector<void *>;
+template class vector<classinfo>;
 
 template class map<void *, int>;
 template class map<void *, char>;
@@ -808,4 +906,5 @@ template class map<const char *, int *>;
 template class map<char const *, unsigned int>;
 template class map<char *, char *>;
 template class map<char *, unsigned int>;
-template class map<int, char>;
\ No newline at end of file
+template class map<int, char>;
+template class map<int, char *>;
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "utils/dir_index.hpp"
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INIT_CAPACITY 64
+
+dir_index::dir_index() {}
+
+dir_index::~dir_index() {
+  int idx;
+  for (idx = 0; idx < num_listings_; idx++) {
+    free_names(listings_[idx].names_, listings_[idx].num_names_);
+    free(listings_[idx].key_);
+  }
+  free(listings_);
+}
+
+void dir_index::free_names(char **names, int num_names) {
+  int idx;
+  for (idx = 0; idx < num_names; idx++) {
+    free(names[idx]);
+  }
+  free(names);
+}
+
+static int name_cmp(const void *l, const void *r) {
+  return strcmp(*(char *const *)l, *(char *const *)r);
+}
+
+int dir_index::read_dir(const char *dir_name, unsigned char d_type,
+                        char ***names) {
+  DIR *dir = opendir(dir_name);
+  if (dir == NULL) {
+    return -1;
+  }
+
+  char **dir_names = nullptr;
+  int num_names = 0;
+  int capacity = 0;
+
+  struct dirent *ent;
+  while ((ent = readdir(dir)) != NULL) {
+    if ((ent->d_type != d_type) || !strcmp(ent->d_name, ".") ||
+        !strcmp(ent->d_name, "..")) {
+      continue;
+    }
+    if (num_names == capacity) {
+      capacity = capacity == 0 ? 64 : capacity * 2;
+      dir_names = (char **)realloc(dir_names, sizeof(char *) * capacity);
+    }
+    dir_names[num_names++] = strdup(ent->d_name);
+  }
+  closedir(dir);
+
+  qsort(dir_names, num_names, sizeof(char *), name_cmp);
+  *names = dir_names;
+  return num_names;
+}
+
+int dir_index::get(const char *dir_name, unsigned char d_type,
+                   char ***names) {
+  size_t dir_name_len = strlen(dir_name);
+  char *key = (char *)malloc(dir_name_len + 2);
+  if (key == nullptr) {
+    return -1;
+  }
+  key[0] = d_type;
+  memcpy(key + 1, dir_name, dir_name_len + 1);
+
+  int found = keys_.find(key);
+  if (found >= 0) {
+    free(key);
+    *names = listings_[found].names_;
+    return listings_[found].num_names_;
+  }
+
+  if (num_listings_ == capacity_) {
+    int new_capacity = capacity_ == 0 ? INIT_CAPACITY : capacity_ * 2;
+    listing *new_listings =
+        (listing *)realloc(listings_, sizeof(listing) * new_capacity);
+    if (new_listings == nullptr) {
+      free(key);
+      return -1;
+    }
+    listings_ = new_listings;
+    capacity_ = new_capacity;
+  }
+
+  // A directory that could not be read is remembered as well.
+  char **dir_names = nullptr;
+  int num_names = read_dir(dir_name, d_type, &dir_names);
+  if (!keys_.insert(key, num_listings_)) {
+    free_names(dir_names, num_names);
+    free(key);
+    return -1;
+  }
+
+  listing *cur = &listings_[num_listings_++];
+  cur->key_ = key;
+  cur->names_ = dir_names;
+  cur->num_names_ = num_names;
+
+  *names = dir_names;
+  return num_names;
+}
@@ -12,6 +12,7 @@ FunctionCallee replay_float_func;
 FunctionCallee replay_double_func;
 
 FunctionCallee replay_ptr_func;
+FunctionCallee replay_next_elem_idx;
 
 FunctionCallee replay_func_ptr;
 FunctionCallee record_func_ptr;
@@ -101,6 +102,8 @@ Value *insert_replay_probe(Type *typeptr, Value *ptr) {
 
     unsigned int num_elem = struct_type->getNumElements();
 
+    // Each field is inserted into the value holding the previous ones.
+    result = UndefValue::get(typeptr);
     unsigned int idx = 0;
     for (idx = 0; idx < num_elem; idx++) {
       Type *field_type = struct_type->getElementType(idx);
@@ -108,8 +111,7 @@ Value *insert_replay_probe(Type *typeptr, Value *ptr) {
       if (carved_val == NULL) {
         return NULL;
       }
-      result =
-          IRB->CreateInsertValue(UndefValue::get(typeptr), carved_val, idx);
+      result = IRB->CreateInsertValue(result, carved_val, idx);
     }
   } else if (is_func_ptr_type(typeptr)) {
     result = IRB->CreateCall(replay_func_ptr, {});
@@ -217,8 +219,9 @@ Value *insert_replay_probe(Type *typeptr, Value *ptr) {
       insert_gep_replay_probe(getelem_instr);
     }
 
+    // Skips the elements left out by a sampling carver.
     Value *index_update_instr =
-        IRB->CreateAdd(index_phi, ConstantInt::get(Int32Ty, 1));
+        IRB->CreateCall(replay_next_elem_idx, {index_phi, ptr_size});
     index_phi->addIncoming(index_update_instr, IRB->GetInsertBlock());
 
     Value *cmp_instr2 = IRB->CreateICmpSLT(index_update_instr, ptr_size);
@@ -427,6 +430,8 @@ void get_driver_func_callees() {
   replay_double_func = Mod->getOrInsertFunction("Replay_double", DoubleTy);
   replay_ptr_func = Mod->getOrInsertFunction("Replay_pointer", Int8PtrTy,
                                              Int32Ty, Int32Ty, Int8PtrTy);
+  replay_next_elem_idx = Mod->getOrInsertFunction(
+      "__replay_next_elem_idx", Int32Ty, Int32Ty, Int32Ty);
 
   replay_func_ptr = Mod->getOrInsertFunction("Replay_func_ptr", Int8PtrTy);
 
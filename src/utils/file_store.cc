@@ -0,0 +1,200 @@
+#include "utils/file_store.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils/fnv_hash.hpp"
+
+#define FILE_STORE_BUF_SIZE (1 << 16)
+
+file_store::file_store() {}
+
+file_store::~file_store() {
+  int idx;
+  for (idx = 0; idx < num_entries_; idx++) {
+    free(entries_[idx].file_name_);
+  }
+  free(entries_);
+}
+
+int file_store::save(const char *outdir_name, const char *file_name) {
+  int from_fd = open(file_name, O_RDONLY);
+  if (from_fd < 0) {
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(from_fd, &st) != 0) {
+    close(from_fd);
+    return -1;
+  }
+
+  entry *found =
+      find_by_stat(file_name, st.st_dev, st.st_ino, st.st_size, st.st_mtim);
+  if (found != nullptr) {
+    close(from_fd);
+    num_reused_++;
+    return found->file_idx_;
+  }
+
+  unsigned long hash = 0;
+  if (!hash_file(from_fd, &hash)) {
+    close(from_fd);
+    return -1;
+  }
+
+  int file_idx;
+  found = find_by_hash(file_name, st.st_size, hash);
+  if (found != nullptr) {
+    file_idx = found->file_idx_;
+    num_reused_++;
+  } else {
+    file_idx = next_file_idx(file_name);
+
+    char outfile_name[256];
+    snprintf(outfile_name, 256, "%s/carved_file_%s_%d", outdir_name,
+             file_name, file_idx);
+
+    int to_fd = open(outfile_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (to_fd < 0) {
+      close(from_fd);
+      return -1;
+    }
+
+    bool copied = copy_file(from_fd, to_fd, st.st_size);
+    close(to_fd);
+    if (!copied) {
+      unlink(outfile_name);
+      close(from_fd);
+      return -1;
+    }
+    num_saved_++;
+  }
+
+  close(from_fd);
+
+  // Remember this version, so the next capture can skip hashing.
+  entry *new_entry = push_entry();
+  new_entry->file_name_ = strdup(file_name);
+  new_entry->dev_ = st.st_dev;
+  new_entry->ino_ = st.st_ino;
+  new_entry->size_ = st.st_size;
+  new_entry->mtime_ = st.st_mtim;
+  new_entry->hash_ = hash;
+  new_entry->file_idx_ = file_idx;
+
+  return file_idx;
+}
+
+file_store::entry *file_store::find_by_stat(const char *file_name, dev_t dev,
+                                            ino_t ino, off_t size,
+                                            const struct timespec &mtime) {
+  int idx;
+  for (idx = num_entries_ - 1; idx >= 0; idx--) {
+    entry *cur = &entries_[idx];
+    if ((cur->ino_ == ino) && (cur->dev_ == dev) && (cur->size_ == size) &&
+        (cur->mtime_.tv_sec == mtime.tv_sec) &&
+        (cur->mtime_.tv_nsec == mtime.tv_nsec) &&
+        (strcmp(cur->file_name_, file_name) == 0)) {
+      return cur;
+    }
+  }
+  return nullptr;
+}
+
+file_store::entry *file_store::find_by_hash(const char *file_name, off_t size,
+                                            unsigned long hash) {
+  int idx;
+  for (idx = 0; idx < num_entries_; idx++) {
+    entry *cur = &entries_[idx];
+    if ((cur->hash_ == hash) && (cur->size_ == size) &&
+        (strcmp(cur->file_name_, file_name) == 0)) {
+      return cur;
+    }
+  }
+  return nullptr;
+}
+
+int file_store::next_file_idx(const char *file_name) {
+  int next_idx = 0;
+  int idx;
+  for (idx = 0; idx < num_entries_; idx++) {
+    entry *cur = &entries_[idx];
+    if ((cur->file_idx_ >= next_idx) &&
+        (strcmp(cur->file_name_, file_name) == 0)) {
+      next_idx = cur->file_idx_ + 1;
+    }
+  }
+  return next_idx;
+}
+
+file_store::entry *file_store::push_entry() {
+  if (num_entries_ == capacity_) {
+    capacity_ = (capacity_ == 0) ? 16 : capacity_ * 2;
+    entries_ = (entry *)realloc(entries_, sizeof(entry) * capacity_);
+  }
+  return &entries_[num_entries_++];
+}
+
+// 64-bit FNV-1a of the whole file content.
+bool file_store::hash_file(int fd, unsigned long *hash) {
+  char buf[FILE_STORE_BUF_SIZE];
+  unsigned long hash_val = FNV_OFFSET_BASIS;
+  off_t offset = 0;
+  ssize_t read_size;
+  while ((read_size = pread(fd, buf, FILE_STORE_BUF_SIZE, offset)) > 0) {
+    hash_val = fnv_hash(buf, read_size, hash_val);
+    offset += read_size;
+  }
+
+  if (read_size < 0) {
+    return false;
+  }
+
+  *hash = hash_val;
+  return true;
+}
+
+// Try reflink first, then in-kernel copy, then plain read/write.
+bool file_store::copy_file(int from_fd, int to_fd, off_t size) {
+#ifdef FICLONE
+  if (ioctl(to_fd, FICLONE, from_fd) == 0) {
+    return true;
+  }
+#endif
+
+  off_t from_offset = 0;
+  off_t to_offset = 0;
+  while (from_offset < size) {
+    ssize_t copied = copy_file_range(from_fd, &from_offset, to_fd, &to_offset,
+                                     size - from_offset, 0);
+    if (copied <= 0) {
+      break;
+    }
+  }
+
+  if (from_offset >= size) {
+    return true;
+  }
+
+  // copy_file_range is not supported (e.g. across file systems), fall back.
+  char buf[FILE_STORE_BUF_SIZE];
+  ssize_t read_size;
+  while ((read_size = pread(from_fd, buf, FILE_STORE_BUF_SIZE, from_offset)) >
+         0) {
+    if (pwrite(to_fd, buf, read_size, to_offset) != read_size) {
+      return false;
+    }
+    from_offset += read_size;
+    to_offset += read_size;
+  }
+
+  return read_size == 0;
+}
@@ -0,0 +1,72 @@
+#include "utils/fork_server.hpp"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Longest context path accepted
+#define MAX_REQUEST_LEN 4096
+
+static bool read_all(int fd, void *buf, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t read_size = read(fd, (char *)buf + done, size - done);
+    if (read_size <= 0) {
+      return false;
+    }
+    done += read_size;
+  }
+  return true;
+}
+
+static bool write_word(uint32_t word) {
+  return write(FORKSRV_ST_FD, &word, sizeof(word)) == sizeof(word);
+}
+
+char *fork_server_run() {
+  const char *fork_server_str = getenv(FORK_SERVER_ENV);
+  if ((fork_server_str == NULL) || (atoi(fork_server_str) == 0)) {
+    return NULL;
+  }
+
+  if (!write_word(0)) {
+    fprintf(stderr, "Fork server : No controller on fd %d, replaying once\n",
+            FORKSRV_ST_FD);
+    return NULL;
+  }
+
+  char *request = (char *)malloc(MAX_REQUEST_LEN + 1);
+  while (true) {
+    uint32_t request_len;
+    if (!read_all(FORKSRV_CTL_FD, &request_len, sizeof(request_len)) ||
+        (request_len > MAX_REQUEST_LEN) ||
+        !read_all(FORKSRV_CTL_FD, request, request_len)) {
+      exit(0);
+    }
+    request[request_len] = 0;
+
+    // Or the child writes the buffered output of the server again.
+    fflush(NULL);
+
+    pid_t child_pid = fork();
+    if (child_pid < 0) {
+      perror("Fork server : fork");
+      exit(1);
+    }
+
+    if (child_pid == 0) {
+      close(FORKSRV_CTL_FD);
+      close(FORKSRV_ST_FD);
+      return request;
+    }
+
+    int status = 0;
+    if (!write_word(child_pid) || (waitpid(child_pid, &status, 0) < 0) ||
+        !write_word(status)) {
+      exit(1);
+    }
+  }
+}
@@ -0,0 +1,123 @@
+#include "utils/global_epochs.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define INIT_CAPACITY 64
+
+global_epochs::global_epochs() {}
+
+global_epochs::~global_epochs() {
+  reset();
+  free(entries_);
+}
+
+void global_epochs::reset() {
+  int idx;
+  for (idx = 0; idx < capacity_; idx++) {
+    free(entries_[idx].records_);
+  }
+  if (entries_ != nullptr) {
+    memset(entries_, 0, sizeof(entry) * capacity_);
+  }
+}
+
+bool global_epochs::reserve(int id) {
+  if (id < 0) {
+    return false;
+  }
+
+  // Snapshots of the parent are left to it, generations of a forked child
+  // diverge from the ones they were taken at.
+  int pid = getpid();
+  if (pid != pid_) {
+    reset();
+    pid_ = pid;
+  }
+
+  if (id < capacity_) {
+    return true;
+  }
+
+  int new_capacity = capacity_ == 0 ? INIT_CAPACITY : capacity_;
+  while (new_capacity <= id) {
+    new_capacity *= 2;
+  }
+
+  entry *new_entries =
+      (entry *)realloc(entries_, sizeof(entry) * new_capacity);
+  if (new_entries == nullptr) {
+    return false;
+  }
+  memset(new_entries + capacity_, 0,
+         sizeof(entry) * (new_capacity - capacity_));
+  entries_ = new_entries;
+  capacity_ = new_capacity;
+  return true;
+}
+
+bool global_epochs::is_current(int id, unsigned int gen) {
+  if (!reserve(id)) {
+    return false;
+  }
+  entry *cur = &entries_[id];
+  return cur->valid_ && (cur->gen_ == gen);
+}
+
+void global_epochs::set(int id, unsigned int gen, char *records,
+                        size_t size) {
+  if (!reserve(id)) {
+    free(records);
+    return;
+  }
+
+  entry *cur = &entries_[id];
+  free(cur->records_);
+  cur->gen_ = gen;
+  cur->valid_ = true;
+  cur->saved_ = false;
+  cur->records_ = records;
+  cur->size_ = size;
+}
+
+bool global_epochs::save(const char *outdir, int id) {
+  if (!reserve(id) || !entries_[id].valid_) {
+    return false;
+  }
+
+  entry *cur = &entries_[id];
+  if (cur->saved_) {
+    return true;
+  }
+
+  char dir_name[512];
+  snprintf(dir_name, 512, "%s/globals", outdir);
+  mkdir(dir_name, 0777);
+
+  char ref[256];
+  ref_name(ref, 256, id, cur->gen_);
+
+  char file_name[768];
+  snprintf(file_name, 768, "%s/%s", outdir, ref);
+  FILE *snap_file = fopen(file_name, "w");
+  if (snap_file == NULL) {
+    return false;
+  }
+
+  size_t written = fwrite(cur->records_, 1, cur->size_, snap_file);
+  if ((fclose(snap_file) != 0) || (written != cur->size_)) {
+    unlink(file_name);
+    return false;
+  }
+
+  cur->saved_ = true;
+  return true;
+}
+
+void global_epochs::ref_name(char *buf, size_t size, int id,
+                             unsigned int gen) const {
+  snprintf(buf, size, "globals/%d_%d_%u", pid_, id, gen);
+}
@@ -0,0 +1,73 @@
+#include "utils/name_index.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/fnv_hash.hpp"
+
+#define INIT_CAPACITY 256
+
+name_index::name_index() {}
+
+name_index::~name_index() { free(entries_); }
+
+bool name_index::insert(const char *name, int idx) {
+  if ((num_entries_ + 1) * 2 > capacity_) {
+    unsigned long new_capacity =
+        capacity_ == 0 ? INIT_CAPACITY : capacity_ * 2;
+    entry *new_entries = (entry *)calloc(new_capacity, sizeof(entry));
+    if (new_entries == nullptr) {
+      return false;
+    }
+
+    unsigned long cur_idx;
+    for (cur_idx = 0; cur_idx < capacity_; cur_idx++) {
+      if (entries_[cur_idx].name_ == nullptr) {
+        continue;
+      }
+      unsigned long new_idx = entries_[cur_idx].hash_ & (new_capacity - 1);
+      while (new_entries[new_idx].name_ != nullptr) {
+        new_idx = (new_idx + 1) & (new_capacity - 1);
+      }
+      new_entries[new_idx] = entries_[cur_idx];
+    }
+    free(entries_);
+    entries_ = new_entries;
+    capacity_ = new_capacity;
+  }
+
+  unsigned long hash = fnv_hash_str(name);
+  unsigned long mask = capacity_ - 1;
+  unsigned long cur_idx = hash & mask;
+  while (entries_[cur_idx].name_ != nullptr) {
+    entry *cur = &entries_[cur_idx];
+    if ((cur->hash_ == hash) && !strcmp(cur->name_, name)) {
+      return true;
+    }
+    cur_idx = (cur_idx + 1) & mask;
+  }
+
+  entries_[cur_idx].name_ = name;
+  entries_[cur_idx].hash_ = hash;
+  entries_[cur_idx].idx_ = idx;
+  num_entries_++;
+  return true;
+}
+
+int name_index::find(const char *name) const {
+  if (capacity_ == 0) {
+    return -1;
+  }
+
+  unsigned long hash = fnv_hash_str(name);
+  unsigned long mask = capacity_ - 1;
+  unsigned long cur_idx = hash & mask;
+  while (entries_[cur_idx].name_ != nullptr) {
+    const entry *cur = &entries_[cur_idx];
+    if ((cur->hash_ == hash) && !strcmp(cur->name_, name)) {
+      return cur->idx_;
+    }
+    cur_idx = (cur_idx + 1) & mask;
+  }
+  return -1;
+}
@@ -0,0 +1,171 @@
+#include "utils/obj_store.hpp"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils/fnv_hash.hpp"
+
+#define INIT_CAPACITY 1024
+
+obj_store::obj_store() {}
+
+obj_store::~obj_store() {
+  free(dir_name_);
+  free(hashes_);
+}
+
+bool obj_store::init(const char *outdir) {
+  if (dir_name_ != nullptr) {
+    return true;
+  }
+
+  char dir_name[512];
+  snprintf(dir_name, 512, "%s/objects", outdir);
+  if ((mkdir(dir_name, 0777) != 0) && (access(dir_name, W_OK) != 0)) {
+    return false;
+  }
+
+  hashes_ = (unsigned long *)calloc(INIT_CAPACITY, sizeof(unsigned long));
+  if (hashes_ == nullptr) {
+    return false;
+  }
+  capacity_ = INIT_CAPACITY;
+  dir_name_ = strdup(dir_name);
+  return true;
+}
+
+bool obj_store::contains(unsigned long hash) const {
+  unsigned long mask = capacity_ - 1;
+  unsigned long idx = hash & mask;
+  while (hashes_[idx] != 0) {
+    if (hashes_[idx] == hash) {
+      return true;
+    }
+    idx = (idx + 1) & mask;
+  }
+  return false;
+}
+
+bool obj_store::insert(unsigned long hash) {
+  if ((num_hashes_ + 1) * 2 > capacity_) {
+    unsigned long new_capacity = capacity_ * 2;
+    unsigned long *new_hashes =
+        (unsigned long *)calloc(new_capacity, sizeof(unsigned long));
+    if (new_hashes == nullptr) {
+      return false;
+    }
+
+    unsigned long idx;
+    for (idx = 0; idx < capacity_; idx++) {
+      if (hashes_[idx] == 0) {
+        continue;
+      }
+      unsigned long new_idx = hashes_[idx] & (new_capacity - 1);
+      while (new_hashes[new_idx] != 0) {
+        new_idx = (new_idx + 1) & (new_capacity - 1);
+      }
+      new_hashes[new_idx] = hashes_[idx];
+    }
+    free(hashes_);
+    hashes_ = new_hashes;
+    capacity_ = new_capacity;
+  }
+
+  unsigned long mask = capacity_ - 1;
+  unsigned long idx = hash & mask;
+  while (hashes_[idx] != 0) {
+    idx = (idx + 1) & mask;
+  }
+  hashes_[idx] = hash;
+  num_hashes_++;
+  return true;
+}
+
+bool obj_store::matches(const char *obj_name, const char *data,
+                        size_t size) const {
+  int fd = open(obj_name, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if ((fstat(fd, &st) != 0) || ((size_t)st.st_size != size)) {
+    close(fd);
+    return false;
+  }
+
+  char buf[4096];
+  size_t num_read = 0;
+  while (num_read < size) {
+    ssize_t read_size = read(fd, buf, sizeof(buf));
+    if ((read_size <= 0) || ((size_t)read_size > size - num_read) ||
+        (memcmp(buf, data + num_read, read_size) != 0)) {
+      break;
+    }
+    num_read += read_size;
+  }
+
+  close(fd);
+  return num_read == size;
+}
+
+bool obj_store::save(const char *data, size_t size, unsigned long *hash) {
+  if (dir_name_ == nullptr) {
+    return false;
+  }
+
+  unsigned long cur_hash = fnv_hash(data, size);
+  // 0 marks empty slots of the set.
+  if (cur_hash == 0) {
+    cur_hash = 1;
+  }
+  *hash = cur_hash;
+
+  char obj_name[600];
+  snprintf(obj_name, 600, "%s/%016lx", dir_name_, cur_hash);
+
+  // Stored by this process, another one or an earlier run. FNV-1a is not
+  // collision resistant, an object is only reused if its bytes match.
+  bool is_known = contains(cur_hash);
+  if (is_known || (access(obj_name, F_OK) == 0)) {
+    if (!matches(obj_name, data, size)) {
+      num_collisions_++;
+      return false;
+    }
+    if (!is_known) {
+      insert(cur_hash);
+    }
+    num_reused_++;
+    return true;
+  }
+
+  char tmp_name[640];
+  snprintf(tmp_name, 640, "%s/.tmp_%d_%016lx", dir_name_, getpid(), cur_hash);
+  int fd = open(tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+
+  size_t written = 0;
+  while (written < size) {
+    ssize_t write_size = write(fd, data + written, size - written);
+    if (write_size <= 0) {
+      break;
+    }
+    written += write_size;
+  }
+
+  if ((close(fd) != 0) || (written != size) ||
+      (rename(tmp_name, obj_name) != 0)) {
+    unlink(tmp_name);
+    return false;
+  }
+
+  insert(cur_hash);
+  num_saved_++;
+  return true;
+}
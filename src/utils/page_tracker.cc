@@ -0,0 +1,327 @@
+#include "utils/page_tracker.hpp"
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "utils/carv_sdt.hpp"
+
+#define INIT_TABLE_CAPACITY 4096
+#define INIT_LOG_CAPACITY 64
+#define INIT_CTX_CAPACITY 64
+
+#define PAGE_HASH(page) (((page) >> 12) * 0x9E3779B97F4A7C15UL)
+
+// The tracker the handler reports to, one per process.
+static page_tracker *active_tracker = nullptr;
+static struct sigaction prev_action;
+
+static void on_segv(int sig, siginfo_t *info, void *ucontext) {
+  if ((active_tracker != nullptr) &&
+      active_tracker->on_fault((unsigned long)info->si_addr)) {
+    return;
+  }
+
+  // Not a tracked page, hand it over to whoever had the signal before.
+  if (prev_action.sa_flags & SA_SIGINFO) {
+    if (prev_action.sa_sigaction != nullptr) {
+      prev_action.sa_sigaction(sig, info, ucontext);
+      return;
+    }
+  } else if ((prev_action.sa_handler != SIG_DFL) &&
+             (prev_action.sa_handler != SIG_IGN)) {
+    prev_action.sa_handler(sig);
+    return;
+  }
+
+  // Default action, the faulting access is retried and kills the process.
+  signal(SIGSEGV, SIG_DFL);
+}
+
+static void *map_pages(unsigned long size) {
+  void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return mem == MAP_FAILED ? nullptr : mem;
+}
+
+page_tracker::page_tracker() {}
+
+page_tracker::~page_tracker() {
+  if (active_tracker == this) {
+    unprotect_all(0);
+    sigaction(SIGSEGV, &prev_action, NULL);
+    active_tracker = nullptr;
+  }
+
+  if (table_ != nullptr) {
+    munmap(table_, sizeof(entry) * table_capacity_);
+  }
+  if (log_ != nullptr) {
+    munmap(log_, snapshot_size_ * log_capacity_);
+  }
+  free(ctx_log_begin_);
+}
+
+bool page_tracker::init() {
+  if (enabled_) {
+    return true;
+  }
+
+  if (active_tracker != nullptr) {
+    return false;
+  }
+
+  page_size_ = sysconf(_SC_PAGESIZE);
+  snapshot_size_ = sizeof(snapshot) + page_size_;
+
+  table_ = (entry *)map_pages(sizeof(entry) * INIT_TABLE_CAPACITY);
+  log_ = (char *)map_pages(snapshot_size_ * INIT_LOG_CAPACITY);
+  ctx_log_begin_ =
+      (unsigned long *)malloc(sizeof(unsigned long) * INIT_CTX_CAPACITY);
+  if ((table_ == nullptr) || (log_ == nullptr) ||
+      (ctx_log_begin_ == nullptr)) {
+    return false;
+  }
+  table_capacity_ = INIT_TABLE_CAPACITY;
+  log_capacity_ = INIT_LOG_CAPACITY;
+  ctx_capacity_ = INIT_CTX_CAPACITY;
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = on_segv;
+  action.sa_flags = SA_SIGINFO;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGSEGV, &action, &prev_action) != 0) {
+    return false;
+  }
+
+  active_tracker = this;
+  enabled_ = true;
+  return true;
+}
+
+page_tracker::entry *page_tracker::lookup(unsigned long page) const {
+  unsigned long mask = table_capacity_ - 1;
+  unsigned long idx = PAGE_HASH(page) & mask;
+  while (table_[idx].page_ != 0) {
+    if (table_[idx].page_ == page) {
+      return &table_[idx];
+    }
+    idx = (idx + 1) & mask;
+  }
+  return nullptr;
+}
+
+bool page_tracker::grow_table() {
+  unsigned long new_capacity = table_capacity_ * 2;
+  entry *new_table = (entry *)map_pages(sizeof(entry) * new_capacity);
+  if (new_table == nullptr) {
+    return false;
+  }
+
+  unsigned long mask = new_capacity - 1;
+  unsigned long idx;
+  for (idx = 0; idx < table_capacity_; idx++) {
+    entry *cur = &table_[idx];
+    if (cur->page_ == 0) {
+      continue;
+    }
+    unsigned long new_idx = PAGE_HASH(cur->page_) & mask;
+    while (new_table[new_idx].page_ != 0) {
+      new_idx = (new_idx + 1) & mask;
+    }
+    new_table[new_idx] = *cur;
+  }
+
+  // The handler only runs from the traced program, never while we rehash.
+  entry *old_table = table_;
+  unsigned long old_capacity = table_capacity_;
+  table_ = new_table;
+  table_capacity_ = new_capacity;
+  munmap(old_table, sizeof(entry) * old_capacity);
+  return true;
+}
+
+page_tracker::entry *page_tracker::insert(unsigned long page) {
+  entry *found = lookup(page);
+  if (found != nullptr) {
+    return found;
+  }
+
+  if ((table_size_ + 1) * 2 > table_capacity_) {
+    if (!grow_table()) {
+      return nullptr;
+    }
+  }
+
+  unsigned long mask = table_capacity_ - 1;
+  unsigned long idx = PAGE_HASH(page) & mask;
+  while (table_[idx].page_ != 0) {
+    idx = (idx + 1) & mask;
+  }
+
+  entry *cur = &table_[idx];
+  cur->page_ = page;
+  cur->snap_idx_ = -1;
+  cur->depth_ = 0;
+  cur->is_protected_ = false;
+  table_size_++;
+  return cur;
+}
+
+bool page_tracker::reserve_log() {
+  if (log_len_ < log_capacity_) {
+    return true;
+  }
+
+  // mremap is a plain syscall, fine inside the handler.
+  unsigned long new_capacity = log_capacity_ * 2;
+  void *new_log = mremap(log_, snapshot_size_ * log_capacity_,
+                         snapshot_size_ * new_capacity, MREMAP_MAYMOVE);
+  if (new_log == MAP_FAILED) {
+    return false;
+  }
+  log_ = (char *)new_log;
+  log_capacity_ = new_capacity;
+  return true;
+}
+
+void page_tracker::open_context() {
+  if (!enabled_) {
+    return;
+  }
+
+  if (depth_ == 0) {
+    log_len_ = 0;
+  }
+
+  if (depth_ == ctx_capacity_) {
+    unsigned long *new_begin = (unsigned long *)realloc(
+        ctx_log_begin_, sizeof(unsigned long) * ctx_capacity_ * 2);
+    if (new_begin == nullptr) {
+      return;
+    }
+    ctx_log_begin_ = new_begin;
+    ctx_capacity_ *= 2;
+  }
+
+  ctx_log_begin_[depth_++] = log_len_;
+}
+
+void page_tracker::protect(const void *addr, unsigned long size) {
+  if (!enabled_ || (depth_ == 0) || (size == 0)) {
+    return;
+  }
+
+  unsigned long page_mask = ~(page_size_ - 1);
+  unsigned long page = (unsigned long)addr & page_mask;
+  unsigned long last_page = ((unsigned long)addr + size - 1) & page_mask;
+  unsigned long ctx_begin = ctx_log_begin_[depth_ - 1];
+
+  for (; page <= last_page; page += page_size_) {
+    if (page == 0) {
+      continue;
+    }
+
+    entry *cur = insert(page);
+    if ((cur == nullptr) || cur->is_protected_) {
+      continue;
+    }
+
+    // Already snapshotted with contents valid for this context
+    if ((cur->snap_idx_ >= (long)ctx_begin) &&
+        (get_log(cur->snap_idx_)->depth_ <= depth_)) {
+      continue;
+    }
+
+    if (mprotect((void *)page, page_size_, PROT_NONE) != 0) {
+      continue;
+    }
+    cur->is_protected_ = true;
+    cur->depth_ = depth_;
+  }
+}
+
+bool page_tracker::on_fault(unsigned long addr) {
+  if (!enabled_) {
+    return false;
+  }
+
+  unsigned long page = addr & ~(page_size_ - 1);
+  entry *cur = lookup(page);
+  if ((cur == nullptr) || !cur->is_protected_) {
+    return false;
+  }
+
+  if (mprotect((void *)page, page_size_, PROT_READ | PROT_WRITE) != 0) {
+    return false;
+  }
+  cur->is_protected_ = false;
+  num_faults_++;
+
+  CARV_PROBE2(lazy_page, page, cur->depth_);
+
+  if (!reserve_log()) {
+    num_dropped_++;
+    return true;
+  }
+
+  snapshot *snap = get_log(log_len_);
+  snap->page_ = page;
+  snap->depth_ = cur->depth_;
+  memcpy(snap + 1, (void *)page, page_size_);
+  cur->snap_idx_ = log_len_++;
+  return true;
+}
+
+void page_tracker::unprotect_all(int min_depth) {
+  unsigned long idx;
+  for (idx = 0; idx < table_capacity_; idx++) {
+    entry *cur = &table_[idx];
+    if ((cur->page_ == 0) || !cur->is_protected_ ||
+        (cur->depth_ < min_depth)) {
+      continue;
+    }
+    mprotect((void *)cur->page_, page_size_, PROT_READ | PROT_WRITE);
+    cur->is_protected_ = false;
+  }
+}
+
+page_tracker::snapshot_range page_tracker::close_context() {
+  snapshot_range snaps;
+  if (!enabled_ || (depth_ == 0)) {
+    return snaps;
+  }
+
+  snaps.begin_ = ctx_log_begin_[depth_ - 1];
+  snaps.end_ = log_len_;
+  snaps.depth_ = depth_;
+
+  // Nobody outside would take a snapshot of these anymore.
+  unprotect_all(depth_);
+  depth_--;
+
+  if (depth_ == 0) {
+    memset(table_, 0, sizeof(entry) * table_capacity_);
+    table_size_ = 0;
+  }
+  return snaps;
+}
+
+const char *page_tracker::get_snapshot(const snapshot_range &snaps,
+                                       unsigned long idx,
+                                       unsigned long *page) const {
+  if ((idx < snaps.begin_) || (idx >= snaps.end_) || (idx >= log_len_)) {
+    return nullptr;
+  }
+
+  snapshot *snap = get_log(idx);
+  if (snap->depth_ > snaps.depth_) {
+    return nullptr;
+  }
+
+  *page = snap->page_;
+  return (const char *)(snap + 1);
+}
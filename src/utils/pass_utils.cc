@@ -1,6 +1,9 @@
-
 #include "utils/pass.hpp"
 
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/FileSystem.h"
+#include "utils/cov_map.hpp"
+
 Module *Mod;
 LLVMContext *Context;
 const DataLayout *DL;
@@ -59,12 +62,12 @@ bool is_func_ptr_type(Type *type) {
   return false;
 }
 
-// Get symbol of probe base name.
+// Get symbol of probe base name. Probes are extern "C", their symbol is
+// the base name unless another link name is registered.
 std::string get_link_name(std::string base_name) {
   auto search = probe_link_names.find(base_name);
   if (search == probe_link_names.end()) {
-    DEBUG0("Can't find probe name : " << base_name << "! Abort.\n");
-    std::abort();
+    return base_name;
   }
 
   return search->second;
@@ -184,6 +187,158 @@ void get_class_type_info() {
   }
 }
 
+static Constant *gen_meta_table(StructType *entry_type,
+                                std::vector<Constant *> &entries,
+                                const std::string &table_name) {
+  if (entries.size() == 0) {
+    return Constant::getNullValue(Int8PtrTy);
+  }
+
+  // Not constant, the runtime sorts the entries in place.
+  ArrayType *table_type = ArrayType::get(entry_type, entries.size());
+  GlobalVariable *table = new GlobalVariable(
+      *Mod, table_type, false, GlobalValue::InternalLinkage,
+      ConstantArray::get(table_type, entries), table_name);
+  table->setSection("carv_meta");
+
+  return ConstantExpr::getBitCast(table, Int8PtrTy);
+}
+
+Constant *gen_func_ptr_table(
+    const std::vector<std::pair<Function *, std::string>> &funcs) {
+  StructType *entry_type = StructType::get(Int8PtrTy, Int8PtrTy);
+
+  std::vector<Constant *> entries;
+  for (auto &iter : funcs) {
+    Constant *func_name_const = gen_new_string_constant(iter.second, IRB);
+    Constant *func_ptr = ConstantExpr::getBitCast(iter.first, Int8PtrTy);
+    entries.push_back(
+        ConstantStruct::get(entry_type, {func_ptr, func_name_const}));
+  }
+
+  return gen_meta_table(entry_type, entries, "__carv_func_ptr_table");
+}
+
+Constant *gen_global_var_table(const std::vector<GlobalVariable *> &globals) {
+  StructType *entry_type = StructType::get(Int8PtrTy, Int8PtrTy, Int32Ty);
+
+  std::vector<Constant *> entries;
+  for (GlobalVariable *global_v : globals) {
+    Type *gv_type = global_v->getValueType();
+    unsigned int size = DL->getTypeAllocSize(gv_type);
+
+    Constant *type_name_const = Constant::getNullValue(Int8PtrTy);
+    if (gv_type->isStructTy() && dyn_cast<StructType>(gv_type)->hasName()) {
+      type_name_const =
+          gen_new_string_constant(gv_type->getStructName().str(), IRB);
+    }
+
+    Constant *global_ptr = ConstantExpr::getBitCast(global_v, Int8PtrTy);
+    entries.push_back(ConstantStruct::get(
+        entry_type,
+        {global_ptr, type_name_const, ConstantInt::get(Int32Ty, size)}));
+  }
+
+  return gen_meta_table(entry_type, entries, "__carv_global_var_table");
+}
+
+Constant *gen_class_info_table() {
+  StructType *entry_type = StructType::get(Int8PtrTy, Int32Ty, Int32Ty);
+
+  std::vector<Constant *> entries;
+  for (auto iter : class_name_map) {
+    unsigned int class_size = DL->getTypeAllocSize(iter.first);
+    entries.push_back(ConstantStruct::get(
+        entry_type, {iter.second.second, ConstantInt::get(Int32Ty, class_size),
+                     ConstantInt::get(Int32Ty, iter.second.first)}));
+  }
+
+  return gen_meta_table(entry_type, entries, "__carv_class_info_table");
+}
+
+// Functions given counters, in block id order
+class bb_cov_func {
+ public:
+  std::string filename;
+  std::string func_name;
+  std::vector<std::string> bb_names;
+};
+
+static std::vector<bb_cov_func> bb_cov_funcs;
+static std::vector<Constant *> bb_cov_entries;
+
+void insert_bb_cov_counters(
+    const std::string &filename, const std::string &func_name,
+    const std::vector<std::pair<Instruction *, std::string>> &blocks) {
+  if (blocks.size() == 0) {
+    return;
+  }
+
+  ArrayType *counters_type = ArrayType::get(Int8Ty, blocks.size());
+  GlobalVariable *counters = new GlobalVariable(
+      *Mod, counters_type, false, GlobalValue::InternalLinkage,
+      Constant::getNullValue(counters_type), "__cov_counters");
+
+  bb_cov_funcs.push_back(bb_cov_func{filename, func_name, {}});
+
+  unsigned int bb_id = 0;
+  for (auto &iter : blocks) {
+    IRB->SetInsertPoint(iter.first);
+    Value *counter_ptr =
+        IRB->CreateConstInBoundsGEP2_32(counters_type, counters, 0, bb_id++);
+    Value *count = IRB->CreateLoad(Int8Ty, counter_ptr);
+    Value *new_count = IRB->CreateAdd(count, ConstantInt::get(Int8Ty, 1));
+    // Skips 0 when it wraps, a covered block stays covered.
+    Value *wrapped = IRB->CreateICmpEQ(new_count, ConstantInt::get(Int8Ty, 0));
+    new_count = IRB->CreateAdd(new_count, IRB->CreateZExt(wrapped, Int8Ty));
+    IRB->CreateStore(new_count, counter_ptr);
+
+    bb_cov_funcs.back().bb_names.push_back(iter.second);
+  }
+
+  StructType *entry_type = StructType::get(Int8PtrTy, Int32Ty);
+  bb_cov_entries.push_back(ConstantStruct::get(
+      entry_type, {ConstantExpr::getBitCast(counters, Int8PtrTy),
+                   ConstantInt::get(Int32Ty, blocks.size())}));
+}
+
+void insert_bb_cov_bind(Function *main_func) {
+  std::string layout;
+  for (auto &func : bb_cov_funcs) {
+    layout += "S " + func.filename + "\n";
+    layout += "F " + func.func_name + "\n";
+    for (auto &bb_name : func.bb_names) {
+      layout += "B " + bb_name + "\n";
+    }
+  }
+
+  unsigned long layout_hash = hash_cov_layout(layout.data(), layout.size());
+
+  // Next to the module, wherever the driver runs from
+  SmallString<256> module_path(Mod->getModuleIdentifier());
+  sys::fs::make_absolute(module_path);
+  const std::string layout_path = module_path.str().str() + COV_LAYOUT_SUFFIX;
+  const std::string map_path = module_path.str().str() + COV_MAP_SUFFIX;
+
+  std::ofstream layout_file(layout_path);
+  layout_file << layout;
+  layout_file.close();
+
+  StructType *entry_type = StructType::get(Int8PtrTy, Int32Ty);
+  Constant *cov_table =
+      gen_meta_table(entry_type, bb_cov_entries, "__cov_func_table");
+
+  FunctionCallee cov_bind = Mod->getOrInsertFunction(
+      "__cov_bind", VoidTy, Int8PtrTy, Int32Ty, Int8PtrTy, Int64Ty);
+
+  IRB->SetInsertPoint(
+      main_func->getEntryBlock().getFirstNonPHIOrDbgOrLifetime());
+  IRB->CreateCall(cov_bind,
+                  {cov_table, ConstantInt::get(Int32Ty, bb_cov_entries.size()),
+                   gen_new_string_constant(map_path, IRB),
+                   ConstantInt::get(Int64Ty, layout_hash)});
+}
+
 std::map<Function *, std::vector<GlobalVariable *>> global_var_uses;
 static std::set<Use *> searching_uses;
 
@@ -256,6 +411,181 @@ void find_global_var_uses() {
   // TODO : track callee's uses
 }
 
+std::map<GlobalVariable *, int> global_epoch_ids;
+static FunctionCallee carv_global_begin;
+static FunctionCallee carv_global_end;
+static ArrayType *global_gens_type = NULL;
+static GlobalVariable *global_gens = NULL;
+
+// Records of a pointer free global do not refer to the pointer table of the
+// context, so they can be carved once and referred to afterwards.
+static bool is_pointer_free_type(Type *type) {
+  if (type->isPointerTy()) {
+    return false;
+  } else if (type->isStructTy()) {
+    StructType *struct_type = dyn_cast<StructType>(type);
+    if (struct_type->isOpaque()) {
+      return false;
+    }
+    for (Type *elem_type : struct_type->elements()) {
+      if (!is_pointer_free_type(elem_type)) {
+        return false;
+      }
+    }
+  } else if (type->isArrayTy()) {
+    return is_pointer_free_type(type->getArrayElementType());
+  } else if (type->isVectorTy()) {
+    return is_pointer_free_type(dyn_cast<VectorType>(type)->getElementType());
+  }
+  return true;
+}
+
+// Collects the instructions writing through `ptr`, the address of a global
+// or derived from it. False if the address may reach code that can not be
+// instrumented, or be stored, so writes could be missed.
+static bool collect_global_writes(Value *ptr,
+                                  std::vector<Instruction *> *writes) {
+  for (User *user : ptr->users()) {
+    if (isa<LoadInst>(user) || isa<ICmpInst>(user)) {
+      continue;
+    } else if (isa<StoreInst>(user)) {
+      StoreInst *store_instr = dyn_cast<StoreInst>(user);
+      if (store_instr->getPointerOperand() != ptr) {
+        return false;
+      }
+      writes->push_back(store_instr);
+    } else if (isa<AtomicRMWInst>(user)) {
+      AtomicRMWInst *rmw_instr = dyn_cast<AtomicRMWInst>(user);
+      if (rmw_instr->getPointerOperand() != ptr) {
+        return false;
+      }
+      writes->push_back(rmw_instr);
+    } else if (isa<AtomicCmpXchgInst>(user)) {
+      AtomicCmpXchgInst *cas_instr = dyn_cast<AtomicCmpXchgInst>(user);
+      if (cas_instr->getPointerOperand() != ptr) {
+        return false;
+      }
+      writes->push_back(cas_instr);
+    } else if (isa<MemIntrinsic>(user)) {
+      MemIntrinsic *mem_instr = dyn_cast<MemIntrinsic>(user);
+      if (mem_instr->getRawDest() == ptr) {
+        writes->push_back(mem_instr);
+      } else if (!isa<MemTransferInst>(mem_instr) ||
+                 (dyn_cast<MemTransferInst>(mem_instr)->getRawSource() !=
+                  ptr)) {
+        return false;
+      }
+    } else if (isa<GetElementPtrInst>(user) || isa<BitCastInst>(user)) {
+      if (!collect_global_writes(user, writes)) {
+        return false;
+      }
+    } else if (isa<ConstantExpr>(user)) {
+      ConstantExpr *const_expr = dyn_cast<ConstantExpr>(user);
+      if ((const_expr->getOpcode() != Instruction::GetElementPtr) &&
+          (const_expr->getOpcode() != Instruction::BitCast)) {
+        return false;
+      }
+      if (!collect_global_writes(const_expr, writes)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Global-state epochs. Each pointer free struct global whose address stays
+// in the module gets a generation in `__carv_global_gens`, bumped after
+// every write to it, so the runtime can tell it did not change since it was
+// last carved (see __carv_global_begin).
+void instrument_global_epochs() {
+  carv_global_begin = Mod->getOrInsertFunction("__carv_global_begin", Int32Ty,
+                                               Int32Ty, Int32Ty);
+  carv_global_end =
+      Mod->getOrInsertFunction("__carv_global_end", VoidTy, Int32Ty);
+
+  std::vector<std::pair<GlobalVariable *, std::vector<Instruction *>>>
+      tracked_globals;
+  for (GlobalVariable &global : Mod->globals()) {
+    if (global.isDeclaration() || global.isConstant()) {
+      continue;
+    }
+    if (global.getName().str().find("llvm.") == 0) {
+      continue;
+    }
+    // Code outside the module may write a global it can link to, and those
+    // writes would not bump the generation.
+    if (!global.hasLocalLinkage()) {
+      continue;
+    }
+
+    Type *val_type = global.getValueType();
+    if (!val_type->isStructTy() || !is_pointer_free_type(val_type)) {
+      continue;
+    }
+
+    std::vector<Instruction *> writes;
+    if (!collect_global_writes(&global, &writes)) {
+      continue;
+    }
+
+    global_epoch_ids[&global] = tracked_globals.size();
+    tracked_globals.push_back(std::make_pair(&global, writes));
+  }
+
+  if (tracked_globals.size() == 0) {
+    return;
+  }
+
+  global_gens_type = ArrayType::get(Int32Ty, tracked_globals.size());
+  global_gens = new GlobalVariable(
+      *Mod, global_gens_type, false, GlobalValue::InternalLinkage,
+      ConstantAggregateZero::get(global_gens_type), "__carv_global_gens");
+
+  for (auto &iter : tracked_globals) {
+    int global_id = global_epoch_ids[iter.first];
+    for (Instruction *write_instr : iter.second) {
+      IRB->SetInsertPoint(write_instr->getNextNode());
+      Value *gen_ptr = IRB->CreateConstInBoundsGEP2_32(
+          global_gens_type, global_gens, 0, global_id);
+      Value *gen = IRB->CreateLoad(Int32Ty, gen_ptr);
+      IRB->CreateStore(IRB->CreateAdd(gen, ConstantInt::get(Int32Ty, 1)),
+                       gen_ptr);
+    }
+  }
+
+  DEBUG0("# of epoch tracked globals : " << tracked_globals.size() << "\n");
+}
+
+BasicBlock *insert_global_epoch_begin(GlobalVariable *global) {
+  auto search = global_epoch_ids.find(global);
+  if (search == global_epoch_ids.end()) {
+    return NULL;
+  }
+
+  Value *gen_ptr = IRB->CreateConstInBoundsGEP2_32(global_gens_type,
+                                                   global_gens, 0,
+                                                   search->second);
+  Value *gen = IRB->CreateLoad(Int32Ty, gen_ptr);
+  Value *need_carve = IRB->CreateCall(
+      carv_global_begin, {ConstantInt::get(Int32Ty, search->second), gen});
+  Value *need_carve_cmp =
+      IRB->CreateICmpNE(need_carve, ConstantInt::get(Int32Ty, 0));
+
+  Instruction *carve_term = SplitBlockAndInsertIfThen(
+      need_carve_cmp, &(*IRB->GetInsertPoint()), false);
+  BasicBlock *tail_block = carve_term->getSuccessor(0);
+  IRB->SetInsertPoint(carve_term);
+  return tail_block;
+}
+
+void insert_global_epoch_end(GlobalVariable *global, BasicBlock *tail_block) {
+  IRB->CreateCall(carv_global_end,
+                  {ConstantInt::get(Int32Ty, global_epoch_ids[global])});
+  IRB->SetInsertPoint(&(*tail_block->getFirstInsertionPt()));
+}
+
 Type *VoidTy;
 IntegerType *Int1Ty;
 IntegerType *Int8Ty;
@@ -0,0 +1,49 @@
+#include "utils/ptr_bitset.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define WORD_BITS (sizeof(unsigned long) * 8)
+
+ptr_bitset::ptr_bitset() {}
+
+ptr_bitset::~ptr_bitset() { free(words_); }
+
+void ptr_bitset::clear(int size) {
+  int needed = (size + WORD_BITS - 1) / WORD_BITS;
+  if (needed > num_words_) {
+    free(words_);
+    words_ = (unsigned long *)calloc(needed, sizeof(unsigned long));
+    num_words_ = words_ == nullptr ? 0 : needed;
+    return;
+  }
+  memset(words_, 0, sizeof(unsigned long) * num_words_);
+}
+
+bool ptr_bitset::test_and_set(int idx) {
+  if (idx < 0) {
+    return false;
+  }
+
+  int word_idx = idx / WORD_BITS;
+  if (word_idx >= num_words_) {
+    int new_num_words = num_words_ == 0 ? 16 : num_words_ * 2;
+    while (new_num_words <= word_idx) {
+      new_num_words *= 2;
+    }
+    unsigned long *new_words = (unsigned long *)realloc(
+        words_, sizeof(unsigned long) * new_num_words);
+    if (new_words == nullptr) {
+      return false;
+    }
+    memset(new_words + num_words_, 0,
+           sizeof(unsigned long) * (new_num_words - num_words_));
+    words_ = new_words;
+    num_words_ = new_num_words;
+  }
+
+  unsigned long bit = 1UL << (idx % WORD_BITS);
+  bool was_set = (words_[word_idx] & bit) != 0;
+  words_[word_idx] |= bit;
+  return was_set;
+}
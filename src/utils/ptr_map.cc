@@ -1,6 +1,8 @@
 
 #include "utils/ptr_map.hpp"
 
+#include "utils/carv_sdt.hpp"
+
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -75,11 +77,14 @@ void ptr_map::insert(void *key, char *type_name, int alloc_size) {
     root = new_node;
     root->color_ = BLACK;
     roots[root_hash] = root;
+    num_nodes_++;
     return;
   }
 
+  unsigned int depth = 0;
   rbtree_node *n = root;
   while (1) {
+    depth++;
     if (key == n->key_) {
       delete new_node;
 
@@ -110,6 +115,11 @@ void ptr_map::insert(void *key, char *type_name, int alloc_size) {
 
   // assert(new_node->parent_ != nullptr);
 
+  num_nodes_++;
+  if (depth > max_depth_) {
+    max_depth_ = depth;
+  }
+
   insert_case2(new_node);
 
   unsigned int cache_hash = CACHE_HASH(key);
@@ -229,16 +239,22 @@ ptr_map::rbtree_node *ptr_map::find(void *key) {
   unsigned int cache_hash = CACHE_HASH(key);
   unsigned long key_v = (unsigned long)key;
 
+  num_finds_++;
+
   if (cache[cache_hash].availability_ == true) {
     unsigned long cache_key_v = (unsigned long)cache[cache_hash].node_->key_;
 
     // Include the end point
     if (cache_key_v <= key_v &&
         (cache_key_v + cache[cache_hash].node_->alloc_size_) >= key_v) {
+      num_cache_hits_++;
       return cache[cache_hash].node_;
     }
   }
 
+  // Carv_pointer and friends fall back to the tree walk
+  CARV_PROBE1(ptr_cache_miss, key);
+
   unsigned int root_hash = ROOT_HASH(key_v);
 
   rbtree_node *n = roots[root_hash];
@@ -246,9 +262,14 @@ ptr_map::rbtree_node *ptr_map::find(void *key) {
     return nullptr;
   }
 
+  unsigned int depth = 0;
   while (n != nullptr) {
     unsigned long n_key = (unsigned long)n->key_;
 
+    if (++depth > max_depth_) {
+      max_depth_ = depth;
+    }
+
     // Should we include the end point here?
     if ((n_key <= key_v) && ((n_key + n->alloc_size_) > key_v)) {
       cache_hash = CACHE_HASH(n_key);
@@ -361,6 +382,7 @@ void ptr_map::remove(void *key) {
   node_to_delete->left_ = nullptr;
   node_to_delete->right_ = nullptr;
   delete node_to_delete;
+  num_nodes_--;
   return;
 }
 
@@ -0,0 +1,85 @@
+#include "utils/replay_arena.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN 16UL
+
+#define CHUNK_SIZE (1UL << 20)
+
+// Largest gap after the previous object that is kept, farther objects
+// were not laid out together.
+#define MAX_LAYOUT_GAP 64UL
+
+// Header size rounded up so chunk bases stay aligned
+#define CHUNK_HEADER_SIZE \
+  ((sizeof(chunk) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+replay_arena::replay_arena() {}
+
+replay_arena::~replay_arena() {
+  chunk *cur = first_;
+  while (cur != nullptr) {
+    chunk *next = cur->next_;
+    free(cur);
+    cur = next;
+  }
+}
+
+char *replay_arena::chunk_base(chunk *cur) {
+  return (char *)cur + CHUNK_HEADER_SIZE;
+}
+
+void *replay_arena::alloc(size_t size, unsigned long orig_addr) {
+  unsigned long orig_misalign = orig_addr & (ARENA_ALIGN - 1);
+
+  // Worst case padding before the object
+  size_t needed = size + ARENA_ALIGN + MAX_LAYOUT_GAP;
+
+  while ((cur_ == nullptr) || (top_ + needed > cur_->size_)) {
+    chunk *next = cur_ == nullptr ? first_ : cur_->next_;
+    if ((next == nullptr) || (next->size_ < needed)) {
+      size_t chunk_size = needed > CHUNK_SIZE ? needed : CHUNK_SIZE;
+      chunk *new_chunk = (chunk *)malloc(CHUNK_HEADER_SIZE + chunk_size);
+      if (new_chunk == nullptr) {
+        return nullptr;
+      }
+      new_chunk->size_ = chunk_size;
+      new_chunk->next_ = next;
+      if (cur_ == nullptr) {
+        first_ = new_chunk;
+      } else {
+        cur_->next_ = new_chunk;
+      }
+      next = new_chunk;
+    }
+    cur_ = next;
+    top_ = 0;
+    last_orig_end_ = 0;
+  }
+
+  size_t offset;
+  if ((orig_addr != 0) && (last_orig_end_ != 0) &&
+      (orig_addr >= last_orig_end_) &&
+      (orig_addr - last_orig_end_ <= MAX_LAYOUT_GAP)) {
+    offset = top_ + (orig_addr - last_orig_end_);
+  } else {
+    offset = (top_ & ~(ARENA_ALIGN - 1)) + orig_misalign;
+    if (offset < top_) {
+      offset += ARENA_ALIGN;
+    }
+  }
+
+  char *obj = chunk_base(cur_) + offset;
+  memset(obj, 0, size);
+
+  top_ = offset + size;
+  last_orig_end_ = orig_addr == 0 ? 0 : orig_addr + size;
+  return obj;
+}
+
+void replay_arena::reset() {
+  cur_ = first_;
+  top_ = 0;
+  last_orig_end_ = 0;
+}
@@ -0,0 +1,109 @@
+#include "utils/soft_dirty.hpp"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define PM_SOFT_DIRTY_BIT 55
+
+// Entries read from the pagemap at once
+#define PAGEMAP_BATCH 512
+
+soft_dirty::soft_dirty() { page_size_ = sysconf(_SC_PAGESIZE); }
+
+soft_dirty::~soft_dirty() {
+  if (clear_refs_fd_ >= 0) {
+    close(clear_refs_fd_);
+  }
+  if (pagemap_fd_ >= 0) {
+    close(pagemap_fd_);
+  }
+}
+
+bool soft_dirty::init() {
+  if (enabled_) {
+    return true;
+  }
+
+  clear_refs_fd_ = open("/proc/self/clear_refs", O_WRONLY);
+  pagemap_fd_ = open("/proc/self/pagemap", O_RDONLY);
+  if ((clear_refs_fd_ < 0) || (pagemap_fd_ < 0)) {
+    return false;
+  }
+
+  // Check that a write is actually noticed.
+  char *probe = (char *)mmap(NULL, page_size_, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (probe == MAP_FAILED) {
+    return false;
+  }
+  probe[0] = 1;
+  bool works = clear() && !is_dirty((unsigned long)probe);
+  *(volatile char *)probe = 2;
+  works = works && is_dirty((unsigned long)probe);
+  munmap(probe, page_size_);
+
+  enabled_ = works;
+  return enabled_;
+}
+
+bool soft_dirty::clear() {
+  if (clear_refs_fd_ < 0) {
+    return false;
+  }
+  return pwrite(clear_refs_fd_, "4", 1, 0) == 1;
+}
+
+bool soft_dirty::is_dirty(unsigned long page) {
+  uint64_t entry = 0;
+  off_t offset = (page / page_size_) * sizeof(uint64_t);
+  if (pread(pagemap_fd_, &entry, sizeof(entry), offset) != sizeof(entry)) {
+    return true;
+  }
+  return (entry >> PM_SOFT_DIRTY_BIT) & 1;
+}
+
+int soft_dirty::num_pages(const void *addr, unsigned long size) const {
+  if (size == 0) {
+    return 0;
+  }
+  unsigned long first = (unsigned long)addr / page_size_;
+  unsigned long last = ((unsigned long)addr + size - 1) / page_size_;
+  return last - first + 1;
+}
+
+int soft_dirty::get_dirty(const void *addr, unsigned long size, char *dirty) {
+  int num = num_pages(addr, size);
+  if (!enabled_) {
+    memset(dirty, 1, num);
+    return num;
+  }
+
+  uint64_t entries[PAGEMAP_BATCH];
+  unsigned long first = (unsigned long)addr / page_size_;
+  int idx = 0;
+  while (idx < num) {
+    int batch = num - idx;
+    if (batch > PAGEMAP_BATCH) {
+      batch = PAGEMAP_BATCH;
+    }
+
+    off_t offset = (first + idx) * sizeof(uint64_t);
+    ssize_t read_size =
+        pread(pagemap_fd_, entries, batch * sizeof(uint64_t), offset);
+    int num_read = read_size < 0 ? 0 : read_size / sizeof(uint64_t);
+
+    int batch_idx;
+    for (batch_idx = 0; batch_idx < batch; batch_idx++) {
+      // Unreadable entries are reported dirty, to be compared anyway.
+      dirty[idx + batch_idx] =
+          (batch_idx >= num_read) ||
+          ((entries[batch_idx] >> PM_SOFT_DIRTY_BIT) & 1);
+    }
+    idx += batch;
+  }
+  return num;
+}
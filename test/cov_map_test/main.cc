@@ -0,0 +1,77 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "utils/cov_map.hpp"
+
+// Block ids : stray 0, foo.0 1, foo.1 2, bar.0 3, baz.0 4, pad.0 .. pad.11
+// 5 .. 16. The stray block comes before any function, as no pass writes
+// it, and still takes an id.
+#define NUM_BBS 17
+#define LAYOUT_PATH "cov.cov_layout"
+#define MAP_PATH "cov.covmap"
+
+static std::string make_layout() {
+  std::string layout = "B stray\n";
+  layout += "S src_a.c\nF foo\nB foo.0\nB foo.1\nF bar\nB bar.0\n";
+  layout += "S src_b.c\nF baz\nB baz.0\nF pad\n";
+  for (int idx = 0; idx < 12; idx++) {
+    layout += "B pad." + std::to_string(idx) + "\n";
+  }
+  return layout;
+}
+
+static void merge_block(unsigned long layout_hash, int bb_id) {
+  unsigned char bits[(NUM_BBS + 7) / 8] = {0};
+  bits[bb_id / 8] |= 1 << (bb_id % 8);
+  assert(cov_map_merge(MAP_PATH, layout_hash, bits, NUM_BBS));
+}
+
+static void read_bits(unsigned long layout_hash, unsigned char *bits) {
+  FILE *map = fopen(MAP_PATH, "rb");
+  assert(map != NULL);
+  cov_map_header header;
+  assert(fread(&header, sizeof(header), 1, map) == 1);
+  assert(header.magic == COV_MAP_MAGIC);
+  assert(header.layout_hash == layout_hash);
+  assert(header.num_bbs == NUM_BBS);
+  assert(fread(bits, 1, (NUM_BBS + 7) / 8, map) == (NUM_BBS + 7) / 8);
+  fclose(map);
+}
+
+int main() {
+  const std::string layout = make_layout();
+  std::ofstream layout_file(LAYOUT_PATH);
+  layout_file << layout;
+  layout_file.close();
+  const unsigned long layout_hash =
+      hash_cov_layout(layout.data(), layout.size());
+
+  // A map of another build is reset
+  merge_block(layout_hash + 1, 0);
+  merge_block(layout_hash, 1);
+  unsigned char bits[(NUM_BBS + 7) / 8];
+  read_bits(layout_hash, bits);
+  assert((bits[0] == 0x2) && (bits[1] == 0) && (bits[2] == 0));
+
+  // Replays merging in parallel keep each other's blocks
+  for (int bb_id = 3; bb_id < NUM_BBS; bb_id++) {
+    if (fork() == 0) {
+      merge_block(layout_hash, bb_id);
+      _exit(0);
+    }
+  }
+  while (wait(NULL) > 0) {
+  }
+  read_bits(layout_hash, bits);
+  assert((bits[0] == 0xfa) && (bits[1] == 0xff) && (bits[2] == 0x1));
+
+  std::cout << "PASS\n";
+  return 0;
+}
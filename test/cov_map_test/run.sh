@@ -0,0 +1,30 @@
+#!/usr/bin/bash
+
+# Merges replay coverage into a map, then checks the reports of cov-export.
+
+rm -rf cov.cov_layout cov.covmap src_a.c.cov src_b.c.cov main
+
+clang++ main.cc -I ../../include -g -O0 ../../src/utils/cov_map.o \
+     -o main -fsanitize=address
+./main || exit 1
+
+res=0
+../../bin/cov-export cov.cov_layout > export.txt || res=1
+if ! grep -q "^15 / 17 blocks covered$" export.txt; then
+  echo "FAIL : wrong number of covered blocks"
+  res=1
+fi
+if ! diff src_a.c.cov <(printf 'F bar 1\nB bar.0 1\nF foo 1\nB foo.0 1\nB foo.1 0\n'); then
+  echo "FAIL : src_a.c.cov"
+  res=1
+fi
+if ! grep -q "^B pad.11 1$" src_b.c.cov || ! grep -q "^F baz 1$" src_b.c.cov; then
+  echo "FAIL : src_b.c.cov"
+  res=1
+fi
+rm -f export.txt
+
+if [ $res -eq 0 ]; then
+  echo "PASS"
+fi
+exit $res
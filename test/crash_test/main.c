@@ -0,0 +1,25 @@
+#include <stdlib.h>
+
+// Set by main, sum then crashes after all its reads.
+int crash_in_sum = 0;
+
+int sum(int *arr, int len) {
+  int res = 0;
+  for (int idx = 0; idx < len; idx++) {
+    res += arr[idx];
+  }
+  if (crash_in_sum) {
+    abort();
+  }
+  return res;
+}
+
+int main() {
+  crash_in_sum = getenv("CRASH_IN_SUM") != NULL;
+
+  int *arr = (int *)malloc(sizeof(int) * 8);
+  for (int idx = 0; idx < 8; idx++) {
+    arr[idx] = idx;
+  }
+  return sum(arr, 4) == 6 ? 0 : 1;
+}
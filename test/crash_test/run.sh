@@ -0,0 +1,45 @@
+#!/usr/bin/bash
+
+# Carves the same run with -crash twice, once returning from sum and once
+# aborting in it after its reads. The crashed context ends with the read
+# journal; folded by carv-fold, it has to match the returned one.
+
+rm -rf out* main.bc carv_ret carv_crash
+
+clang -O0 -g -c -emit-llvm main.c -o main.bc
+
+opt -enable-new-pm=0 -load ../../lib/carve_model_pass.so --carve -crash \
+    --target=targets.txt < main.bc -o out.bc
+
+clang++ -O0 -g out.bc -o out.carv -L ../../lib -l:m_carver.a
+
+mkdir -p carv_ret carv_crash
+
+../../pin/pin -t ../../pintool/obj-intel64/MemoryTrackTool.so -- \
+    ./out.carv carv_ret
+CRASH_IN_SUM=1 ../../pin/pin -t ../../pintool/obj-intel64/MemoryTrackTool.so \
+    -- ./out.carv carv_crash
+
+res=0
+for carved in carv_ret/sum_*; do
+  name=$(basename $carved)
+  if ! grep -q "^+ p" carv_crash/$name; then
+    echo "FAIL : $name of the crashed run has no journal"
+    res=1
+  fi
+done
+
+../../bin/carv-fold carv_crash
+
+for carved in carv_ret/sum_*; do
+  name=$(basename $carved)
+  if ! diff $carved carv_crash/$name; then
+    echo "FAIL : $name differs after folding"
+    res=1
+  fi
+done
+
+if [ $res -eq 0 ]; then
+  echo "PASS"
+fi
+exit $res
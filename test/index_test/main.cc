@@ -0,0 +1,88 @@
+#include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "utils/dir_index.hpp"
+#include "utils/name_index.hpp"
+
+#define NUM_NAMES 10000
+#define NUM_DIRS 200
+#define OUT_DIR "index_out"
+
+static void test_name_index() {
+  std::vector<std::string> names;
+  for (int idx = 0; idx < NUM_NAMES; idx++) {
+    names.push_back("func_" + std::to_string(idx));
+  }
+
+  name_index index;
+  assert(index.find("func_0") == -1);
+
+  for (int idx = 0; idx < NUM_NAMES; idx++) {
+    assert(index.insert(names[idx].c_str(), idx));
+  }
+  // A name already in keeps its first index
+  assert(index.insert("func_7", 42));
+
+  for (int idx = 0; idx < NUM_NAMES; idx++) {
+    assert(index.find(names[idx].c_str()) == idx);
+  }
+  assert(index.find("func_") == -1);
+  assert(index.find("func_10000") == -1);
+  assert(index.find("") == -1);
+}
+
+static void touch(const std::string &name) {
+  FILE *file = fopen(name.c_str(), "w");
+  assert(file != NULL);
+  fclose(file);
+}
+
+static void test_dir_index() {
+  // dir_<idx> holds files f_<idx - 1> .. f_0 and the subdirectory sub
+  std::vector<std::string> dir_names;
+  for (int idx = 0; idx < NUM_DIRS; idx++) {
+    std::string dir_name = OUT_DIR "/dir_" + std::to_string(idx);
+    assert(mkdir(dir_name.c_str(), 0777) == 0);
+    assert(mkdir((dir_name + "/sub").c_str(), 0777) == 0);
+    for (int file_idx = idx - 1; file_idx >= 0; file_idx--) {
+      touch(dir_name + "/f_" + std::to_string(file_idx));
+    }
+    dir_names.push_back(dir_name);
+  }
+
+  dir_index index;
+  char **names;
+  for (int round = 0; round < 2; round++) {
+    for (int idx = 0; idx < NUM_DIRS; idx++) {
+      int num_names = index.get(dir_names[idx].c_str(), DT_REG, &names);
+      assert(num_names == idx);
+      for (int name_idx = 1; name_idx < num_names; name_idx++) {
+        assert(strcmp(names[name_idx - 1], names[name_idx]) < 0);
+      }
+
+      num_names = index.get(dir_names[idx].c_str(), DT_DIR, &names);
+      assert(num_names == 1);
+      assert(!strcmp(names[0], "sub"));
+    }
+
+    // Listings are read once, files added later are not seen
+    touch(dir_names[0] + "/late");
+  }
+
+  assert(index.get(OUT_DIR "/missing", DT_REG, &names) == -1);
+  assert(index.get(OUT_DIR "/missing", DT_REG, &names) == -1);
+}
+
+int main() {
+  test_name_index();
+  test_dir_index();
+  std::cout << "PASS\n";
+  return 0;
+}
@@ -0,0 +1,8 @@
+#!/usr/bin/bash
+
+rm -rf index_out main
+mkdir -p index_out
+
+clang++ main.cc -I ../../include -g -O0 ../../src/utils/dir_index.o \
+     ../../src/utils/name_index.o -o main -fsanitize=address
+./main
@@ -0,0 +1,58 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+
+#include "utils/obj_store.hpp"
+
+#define OUT_DIR "obj_out"
+
+static void write_file(const char *name, const char *data) {
+  FILE *file = fopen(name, "w");
+  assert(file != NULL);
+  fputs(data, file);
+  fclose(file);
+}
+
+int main() {
+  const char *obj_a = "INT:1\nINT:2\nINT:3\n";
+  const char *obj_b = "INT:4\nINT:5\nINT:6\n";
+
+  obj_store store;
+  assert(store.init(OUT_DIR));
+
+  unsigned long hash_a, hash_b, hash;
+  assert(store.save(obj_a, strlen(obj_a), &hash_a));
+  assert(store.save(obj_b, strlen(obj_b), &hash_b));
+  assert(hash_a != hash_b);
+  assert(store.num_saved() == 2);
+
+  // The same bytes are reused, by this store or by another process
+  assert(store.save(obj_a, strlen(obj_a), &hash));
+  assert(hash == hash_a);
+  assert(store.num_reused() == 1);
+
+  obj_store other;
+  assert(other.init(OUT_DIR));
+  assert(other.save(obj_b, strlen(obj_b), &hash));
+  assert(hash == hash_b);
+  assert(other.num_reused() == 1);
+
+  // An object stored under the hash of other bytes, as if they collided
+  char obj_name[512];
+  snprintf(obj_name, 512, OUT_DIR "/objects/%016lx", hash_a);
+  write_file(obj_name, obj_b);
+  assert(!store.save(obj_a, strlen(obj_a), &hash));
+  assert(!other.save(obj_a, strlen(obj_a), &hash));
+  assert(store.num_collisions() == 1);
+  assert(other.num_collisions() == 1);
+
+  // Same size, different bytes
+  write_file(obj_name, "INT:1\nINT:2\nINT:4\n");
+  assert(!other.save(obj_a, strlen(obj_a), &hash));
+
+  std::cout << "PASS\n";
+  return 0;
+}
@@ -0,0 +1,8 @@
+#!/usr/bin/bash
+
+rm -rf obj_out main
+mkdir -p obj_out
+
+clang++ main.cc -I ../../include -g -O0 ../../src/utils/obj_store.o \
+     -o main -fsanitize=address
+./main
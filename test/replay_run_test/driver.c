@@ -0,0 +1,42 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Stand-in replay driver, acts as its context file says.
+int main(int argc, char **argv) {
+  char action[64] = {0};
+  FILE *context = fopen(argv[argc - 1], "r");
+  if ((context == NULL) || (fscanf(context, "%63s", action) != 1)) {
+    return 2;
+  }
+  fclose(context);
+
+  if (!strcmp(action, "pass")) {
+    return 0;
+  } else if (!strcmp(action, "fail")) {
+    return 3;
+  } else if (!strcmp(action, "crash")) {
+    abort();
+  } else if (!strcmp(action, "spin")) {
+    while (1) {
+    }
+  } else if (!strcmp(action, "ignore_alarm")) {
+    // Replaces the timer of replay-run, then sleeps in a syscall
+    signal(SIGALRM, SIG_IGN);
+    alarm(0);
+    while (1) {
+      pause();
+    }
+  } else if (!strcmp(action, "block_alarm")) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGALRM);
+    sigprocmask(SIG_BLOCK, &set, NULL);
+    while (1) {
+      sleep(1);
+    }
+  }
+  return 2;
+}
@@ -0,0 +1,39 @@
+#!/usr/bin/bash
+
+# Replays one context per outcome and checks the class replay-run gives it,
+# including runs that disable the timer of replay-run.
+
+rm -rf corpus driver results.txt
+
+clang -O0 driver.c -o driver
+
+mkdir -p corpus
+for action in pass fail crash spin ignore_alarm block_alarm; do
+  echo $action > corpus/$action
+done
+
+../../bin/replay-run -j 3 -t 300 -o results.txt corpus ./driver
+
+res=0
+check() {
+  if ! grep -q "^$2 .* corpus/$1$" results.txt; then
+    echo "FAIL : $1 is not classified as $2"
+    res=1
+  fi
+}
+check pass P
+check fail F
+check crash C
+check spin T
+check ignore_alarm T
+check block_alarm T
+
+if [ $(wc -l < results.txt) -ne 6 ]; then
+  echo "FAIL : not every context has a result"
+  res=1
+fi
+
+if [ $res -eq 0 ]; then
+  echo "PASS"
+fi
+exit $res
@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NUM_VALS 64
+
+// Only written by set_scale, so scaled() contexts carved at the same
+// generation share one snapshot of it.
+typedef struct _config {
+  int scale;
+  long bias;
+} config;
+
+static config cfg = {2, 5};
+
+// Reads every element, skipped elements read as 0 when replayed.
+int sum(int *vals, int num_vals) {
+  long res = 0;
+  for (int idx = 0; idx < num_vals; idx++) {
+    res += vals[idx];
+  }
+  printf("sum %ld\n", res);
+  return res > 0;
+}
+
+int scaled(int val) {
+  long res = val * cfg.scale + cfg.bias;
+  printf("scaled %ld\n", res);
+  return res > 0;
+}
+
+void set_scale(int scale) { cfg.scale = scale; }
+
+int *make_vals() {
+  int *vals = (int *)malloc(sizeof(int) * NUM_VALS);
+  for (int idx = 0; idx < NUM_VALS; idx++) {
+    vals[idx] = idx + 1;
+  }
+  return vals;
+}
+
+int main(int argc, char **argv) {
+  // Two buffers with the same bytes, stored once in the object store
+  int *vals1 = make_vals();
+  int *vals2 = make_vals();
+  sum(vals1, NUM_VALS);
+  sum(vals2, NUM_VALS);
+
+  scaled(1);
+  scaled(2);
+  set_scale(3);
+  scaled(3);
+  return 0;
+}
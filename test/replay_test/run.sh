@@ -0,0 +1,82 @@
+#!/usr/bin/bash
+
+# Carves with sampling, global epochs and the object store, and checks the
+# new records replay to the values the carved run saw.
+
+rm -rf carv_* main.bc out.bc out.carv main.*.driver main.bc.cov* \
+    func_types.txt target_funcs.txt
+
+clang -O0 -g -c -emit-llvm main.c -o main.bc
+
+opt -enable-new-pm=0 -load ../../lib/carve_func_args_pass.so --carve < main.bc -o out.bc
+
+clang++ -O0 -g out.bc -o out.carv -L ../../lib -l:fa_carver.a
+
+for func in sum scaled; do
+  ../../bin/simple_unit_driver_pass.py main.bc $func > /dev/null
+done
+
+mkdir -p carv_plain carv_sample carv_epoch carv_store
+
+./out.carv carv_plain > /dev/null
+CARV_SAMPLE_HEAD=4 CARV_SAMPLE_TAIL=4 ./out.carv carv_sample > /dev/null
+CARV_GLOBAL_EPOCHS=1 ./out.carv carv_epoch > /dev/null
+CARV_OBJ_STORE=1 CARV_OBJ_STORE_MIN_RECORDS=16 ./out.carv carv_store \
+    > /dev/null
+
+res=0
+
+# <carved file> <expected output of its replay>
+check_replay() {
+  local func=$(basename $1 | sed 's/_[0-9]*$//')
+  local out=$(./main.$func.driver $1 2>/dev/null | grep "^$func ")
+  if [ "$out" != "$2" ]; then
+    echo "FAIL : $1 replays as '$out', expected '$2'"
+    res=1
+  fi
+}
+
+# <carved dir> <record> <number of carved files holding it>
+check_records() {
+  local num=$(grep -l "^$2" $1/sum_* $1/scaled_* | wc -l)
+  if [ $num -ne $3 ]; then
+    echo "FAIL : $num files of $1 hold $2 records, expected $3"
+    res=1
+  fi
+}
+
+for dir in carv_plain carv_sample carv_epoch carv_store; do
+  check_replay $dir/scaled_1 "scaled 7"
+  check_replay $dir/scaled_2 "scaled 9"
+  check_replay $dir/scaled_3 "scaled 14"
+done
+
+# 1 + ... + 64, or only the first and last 4 elements once sampled
+for dir in carv_plain carv_epoch carv_store; do
+  check_replay $dir/sum_1 "sum 2080"
+  check_replay $dir/sum_2 "sum 2080"
+done
+check_replay carv_sample/sum_1 "sum 260"
+check_replay carv_sample/sum_2 "sum 260"
+
+check_records carv_plain "SKIPPED" 0
+check_records carv_sample "SKIPPED" 2
+check_records carv_plain "GLOBAL_REF" 0
+check_records carv_epoch "GLOBAL_REF" 1
+check_records carv_plain "OBJ_REF" 0
+check_records carv_store "OBJ_REF" 2
+
+# cfg is unchanged between scaled_1 and scaled_2 only
+if ! grep -q "^GLOBAL_REF" carv_epoch/scaled_2; then
+  echo "FAIL : carv_epoch/scaled_2 carved cfg again"
+  res=1
+fi
+if [ $(ls carv_store/objects | wc -l) -ne 1 ]; then
+  echo "FAIL : expected both sum buffers in one stored object"
+  res=1
+fi
+
+if [ $res -eq 0 ]; then
+  echo "PASS"
+fi
+exit $res
@@ -0,0 +1,170 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <iostream>
+
+#include "utils/carved_reader.hpp"
+#include "utils/ptr_bitset.hpp"
+#include "utils/replay_arena.hpp"
+
+#define OUT_DIR "replay_out"
+
+static void test_ptr_bitset() {
+  ptr_bitset set;
+  // Grows on demand, before any clear as well
+  assert(!set.test_and_set(3));
+  assert(set.test_and_set(3));
+  assert(!set.test_and_set(5000));
+  assert(set.test_and_set(5000));
+  assert(!set.test_and_set(64));
+  assert(!set.test_and_set(-1));
+
+  set.clear(10);
+  assert(!set.test_and_set(3));
+  assert(!set.test_and_set(5000));
+  assert(!set.test_and_set(64));
+
+  set.clear(100000);
+  for (int idx = 0; idx < 100000; idx += 7) {
+    assert(!set.test_and_set(idx));
+  }
+  for (int idx = 0; idx < 100000; idx++) {
+    assert(set.test_and_set(idx) == (idx % 7 == 0));
+  }
+}
+
+static void test_replay_arena() {
+  replay_arena arena;
+
+  // Keeps the offset from a 16 byte boundary
+  char *obj1 = (char *)arena.alloc(24, 0x1008);
+  assert(((unsigned long)obj1 & 15) == 8);
+
+  // Close in the carved process, at the same distance
+  char *obj2 = (char *)arena.alloc(8, 0x1020);
+  assert(obj2 == obj1 + 0x18);
+  char *obj3 = (char *)arena.alloc(4, 0x1030);
+  assert(obj3 == obj2 + 0x10);
+
+  // Far away, only the alignment is kept
+  char *obj4 = (char *)arena.alloc(16, 0x9004);
+  assert(((unsigned long)obj4 & 15) == 4);
+  assert(obj4 >= obj3 + 4);
+
+  // Unknown address, 16 byte aligned, zeroed
+  memset(obj4, 0xff, 16);
+  char *obj5 = (char *)arena.alloc(32, 0);
+  assert(((unsigned long)obj5 & 15) == 0);
+  for (int idx = 0; idx < 32; idx++) {
+    assert(obj5[idx] == 0);
+  }
+
+  // Larger than a chunk
+  char *big = (char *)arena.alloc(3 << 20, 0x20000);
+  assert(big != NULL);
+  big[(3 << 20) - 1] = 1;
+
+  // Reset reuses the chunks from the start, objects are zeroed again
+  arena.reset();
+  char *again = (char *)arena.alloc(24, 0x1008);
+  assert(again == obj1);
+  memset(again, 0x5a, 24);
+  arena.reset();
+  again = (char *)arena.alloc(24, 0x1008);
+  for (int idx = 0; idx < 24; idx++) {
+    assert(again[idx] == 0);
+  }
+}
+
+static void write_file(const char *name, const char *data) {
+  FILE *file = fopen(name, "w");
+  assert(file != NULL);
+  fputs(data, file);
+  fclose(file);
+}
+
+static void expect(carved_reader &reader, RECORD_TYPE type, long long value) {
+  const carved_record *record = reader.next();
+  assert(record != NULL);
+  assert(record->type == type);
+  assert(record->value == value);
+}
+
+static void test_carved_reader() {
+  assert(mkdir(OUT_DIR "/globals", 0777) == 0);
+  assert(mkdir(OUT_DIR "/objects", 0777) == 0);
+
+  write_file(OUT_DIR "/globals/9830_0_0", "INT:11\nLONG:12\n");
+  write_file(OUT_DIR "/objects/00000000000000ab", "INT:21\nINT:22\n");
+  // The last line of a file may have no line break
+  write_file(OUT_DIR "/f_1",
+             "0:0x1008:24:struct.s\n"
+             "1:(nil):4:i8\n"
+             "####\n"
+             "OBJ_INFO:Arg0:%struct.s*\n"
+             "PTR:0:0\n"
+             "INT:1\n"
+             "SKIPPED:2\n"
+             "INT:4\n"
+             "OBJ_INFO:cfg:struct.cfg\n"
+             "GLOBAL_REF:globals/9830_0_0\n"
+             "OBJ_REF:00000000000000ab\n"
+             "PTR:1:3\n"
+             "NULLPTR:0\n"
+             "FUNCPTR:foo\n"
+             "DOUBLE:2.5");
+
+  carved_reader reader;
+  assert(!reader.open(OUT_DIR "/missing", 0));
+  assert(reader.open(OUT_DIR "/f_1", 0));
+
+  int alloc_size;
+  const char *type_name;
+  unsigned long addr;
+  assert(reader.next_ptr(&alloc_size, &type_name, &addr));
+  assert((alloc_size == 24) && !strcmp(type_name, "struct.s") &&
+         (addr == 0x1008));
+  assert(reader.next_ptr(&alloc_size, &type_name, &addr));
+  assert((alloc_size == 4) && !strcmp(type_name, "i8") && (addr == 0));
+  assert(!reader.next_ptr(&alloc_size, &type_name, &addr));
+
+  const carved_record *record = reader.next();
+  assert((record->type == RECORD_TYPE::PTR) && (record->value == 0) &&
+         (record->offset == 0));
+  expect(reader, RECORD_TYPE::INT, 1);
+  record = reader.peek();
+  assert((record->type == RECORD_TYPE::SKIPPED) && (record->value == 2));
+  expect(reader, RECORD_TYPE::SKIPPED, 2);
+  expect(reader, RECORD_TYPE::INT, 4);
+  // References are followed in place
+  expect(reader, RECORD_TYPE::INT, 11);
+  expect(reader, RECORD_TYPE::LONG, 12);
+  expect(reader, RECORD_TYPE::INT, 21);
+  expect(reader, RECORD_TYPE::INT, 22);
+  record = reader.next();
+  assert((record->type == RECORD_TYPE::PTR) && (record->value == 1) &&
+         (record->offset == 3));
+  assert(reader.next()->type == RECORD_TYPE::NULLPTR);
+  record = reader.next();
+  assert((record->type == RECORD_TYPE::FUNCPTR) && !strcmp(record->name, "foo"));
+  record = reader.next();
+  assert((record->type == RECORD_TYPE::DOUBLE) && (record->fvalue == 2.5));
+  assert(reader.next() == NULL);
+  assert(reader.peek() == NULL);
+
+  // Records are read without going through the pointer table
+  assert(reader.open(OUT_DIR "/f_1", 0));
+  expect(reader, RECORD_TYPE::PTR, 0);
+  reader.close();
+  assert(reader.next() == NULL);
+}
+
+int main() {
+  test_ptr_bitset();
+  test_replay_arena();
+  test_carved_reader();
+  std::cout << "PASS\n";
+  return 0;
+}
@@ -0,0 +1,9 @@
+#!/usr/bin/bash
+
+rm -rf replay_out main
+mkdir -p replay_out
+
+clang++ main.cc -I ../../include -g -O0 ../../src/utils/ptr_bitset.o \
+     ../../src/utils/replay_arena.o ../../src/utils/carved_reader.o \
+     -o main -fsanitize=address
+./main
@@ -0,0 +1,19 @@
+#include <stdlib.h>
+
+// `end` points one past `begin`'s buffer and is carved before it, so the
+// spilled record can only be resolved once the whole context is walked.
+typedef struct _range {
+  char *end;
+  char *begin;
+} range;
+
+int use(range *r) { return r->begin[0]; }
+
+int main() {
+  range *r = (range *)malloc(sizeof(range));
+  char *buf = (char *)malloc(4);
+  buf[0] = 7;
+  r->end = buf + 4;
+  r->begin = buf;
+  return use(r) == 7 ? 0 : 1;
+}
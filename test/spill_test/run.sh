@@ -0,0 +1,36 @@
+#!/usr/bin/bash
+
+# Carves the same run in memory and with every record spilled, the carved
+# files have to be the same apart from the addresses of the pointer table.
+
+rm -rf out* main.bc carv_mem carv_spill
+
+clang -O0 -g -c -emit-llvm main.c -o main.bc
+
+opt -enable-new-pm=0 -load ../../lib/carve_func_args_pass.so --carve < main.bc -o out.bc
+
+clang++ -O0 -g out.bc -o out.carv -L ../../lib -l:fa_carver.a
+
+mkdir -p carv_mem carv_spill
+
+./out.carv carv_mem
+CARV_SPILL_RECORDS=1 ./out.carv carv_spill
+
+res=0
+for carved in carv_mem/use_*; do
+  name=$(basename $carved)
+  if ! diff <(sed '1,/^####$/d' $carved) \
+      <(sed '1,/^####$/d' carv_spill/$name); then
+    echo "FAIL : $name differs when spilled"
+    res=1
+  fi
+  if grep -q "^UNKNOWN_PTR" $carved; then
+    echo "FAIL : $name has an unresolved end pointer"
+    res=1
+  fi
+done
+
+if [ $res -eq 0 ]; then
+  echo "PASS"
+fi
+exit $res